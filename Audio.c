@@ -0,0 +1,114 @@
+#ifndef AUDIO_C_INCLUDE
+#define AUDIO_C_INCLUDE
+
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "Audio.h"
+
+void initAudioRing(audioRing *ring) {
+    memset(ring->edges, 0, sizeof(ring->edges));
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->dropped, 0);
+    atomic_init(&ring->clock, 0);
+    atomic_init(&ring->rewindHead, 0);
+}
+
+void pushAudioEdge(audioRing *ring, const audioEdge *edge) {
+    unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if(head - tail >= AUDIO_RING_SIZE) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return;
+    }
+    ring->edges[head & (AUDIO_RING_SIZE - 1)] = *edge;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+void publishAudioClock(audioRing *ring, uint64_t cycle) {
+    atomic_store_explicit(&ring->clock, cycle, memory_order_release);
+}
+
+void rewindAudioRing(audioRing *ring) {
+    unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    atomic_store_explicit(&ring->rewindHead, head, memory_order_release);
+}
+
+static bool popAudioEdge(audioRing *ring, audioEdge *edge) {
+    unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned int head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if(tail == head) {
+        return false;
+    }
+    *edge = ring->edges[tail & (AUDIO_RING_SIZE - 1)];
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+void initAudioPlayer(audioPlayer *p, audioRing *ring, uint32_t sampleRate, uint32_t cyclesPerSecond, uint32_t latencySamples) {
+    memset(p, 0, sizeof(audioPlayer));
+    p->ring            = ring;
+    p->sampleRate      = sampleRate;
+    p->cyclesPerSecond = cyclesPerSecond;
+    p->maxLag          = (uint64_t) latencySamples * cyclesPerSecond;
+    p->volume          = 3000;
+}
+
+size_t readyAudioSamples(const audioPlayer *p) {
+    uint64_t clock = atomic_load_explicit(&p->ring->clock, memory_order_acquire) * p->sampleRate;
+    if(clock <= p->position) {
+        return 0;
+    }
+    return (clock - p->position + p->cyclesPerSecond - 1) / p->cyclesPerSecond;
+}
+
+void renderAudio(audioPlayer *p, int16_t *out, size_t samples) {
+    uint64_t clock = atomic_load_explicit(&p->ring->clock, memory_order_acquire) * p->sampleRate;
+
+    if(clock + p->cyclesPerSecond < p->position) {
+        // Emulation went back in time. Tones queued before the jump belong to the abandoned timeline, the ones the core
+        // has pushed since are already on the new one
+        unsigned int rewindHead = atomic_load_explicit(&p->ring->rewindHead, memory_order_acquire);
+        unsigned int tail = atomic_load_explicit(&p->ring->tail, memory_order_relaxed);
+        audioEdge edge;
+        while(tail != rewindHead && popAudioEdge(p->ring, &edge)) {
+            tail++;
+        }
+        p->position = clock;
+        p->toneEnd  = 0;
+        p->hasNext  = false;
+    } else if(p->maxLag > 0 && clock > p->position + p->maxLag) {
+        // Too far behind, drop the oldest audio so latency stays bounded. Tones are still applied in order
+        p->position = clock - p->maxLag / 2;
+    }
+
+    const uint32_t period = p->sampleRate / AUDIO_TONE_HZ;
+    for(size_t i = 0; i < samples; i++) {
+        uint64_t cycle = p->position / p->sampleRate;
+        if(p->position < clock) {
+            // Every tone that started by this sample takes effect on it, which is what makes the edges sample-accurate
+            while(p->hasNext || popAudioEdge(p->ring, &p->next)) {
+                if(p->next.cycle > cycle) {
+                    p->hasNext = true;
+                    break;
+                }
+                p->toneEnd = p->next.endCycle;
+                p->hasNext = false;
+            }
+            p->position += p->cyclesPerSecond;
+        }
+
+        if(cycle < p->toneEnd) {
+            out[i] = p->phase < period / 2 ? p->volume : -p->volume;
+            p->phase = p->phase + 1 < period ? p->phase + 1 : 0;
+        } else {
+            out[i] = 0;
+            p->phase = 0;
+        }
+    }
+}
+
+#endif // AUDIO_C_INCLUDE
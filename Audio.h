@@ -0,0 +1,75 @@
+#ifndef AUDIO_H_INCLUDE
+#define AUDIO_H_INCLUDE
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+// Must be a power of two. FX18 is the only producer, so this is more tones than any frame can start
+#define AUDIO_RING_SIZE 256
+
+// The beeper is a square wave at this pitch
+#define AUDIO_TONE_HZ 440
+
+#define AUDIO_DEFAULT_SAMPLE_RATE 48000
+#define AUDIO_DEFAULT_BUFFER      512 // Samples per callback, about 11 ms at 48 kHz
+
+// An FX18. The tone sounds from cycle until endCycle, replacing whatever was playing. endCycle is where the sound
+// timer will reach zero, so a tone never needs a second message to stop. FX18 with 0 gives endCycle == cycle
+typedef struct {
+    uint64_t cycle;
+    uint64_t endCycle;
+} audioEdge;
+
+// Single producer, single consumer, like chip8EventRing. The machine pushes tones and the frontend publishes how far
+// emulation has got, the audio thread reads both. Neither side blocks or allocates
+typedef struct {
+    audioEdge edges[AUDIO_RING_SIZE];
+    atomic_uint head;
+    atomic_uint tail;
+    atomic_uint dropped;
+    _Atomic uint64_t clock; // Cycles emulated so far, the player never renders past this
+    atomic_uint rewindHead; // head when emulation last went back in time, tones before it are never played
+} audioRing;
+
+void initAudioRing(audioRing *ring);
+
+// Called by the core on FX18. When the ring is full the tone is counted in dropped and lost
+void pushAudioEdge(audioRing *ring, const audioEdge *edge);
+
+// Called by the frontend after running cycles, with the machine's cycleCount
+void publishAudioClock(audioRing *ring, uint64_t cycle);
+
+// Called by the frontend when the machine goes back in time (a state load or rewind), before running on from there
+// Tones pushed up to now belong to the abandoned timeline, the ones pushed after are kept
+void rewindAudioRing(audioRing *ring);
+
+// Consumer side. Turns tones into samples at sampleRate, treating one emulated second as cyclesPerSecond cycles
+typedef struct {
+    audioRing *ring;
+    uint32_t sampleRate;
+    uint32_t cyclesPerSecond;
+    uint64_t position; // Emulated time of the next sample, in cycles * sampleRate so it stays exact
+    uint64_t maxLag;   // Same units. Falling further behind the clock than this skips ahead, 0 never skips
+    uint64_t toneEnd;  // Cycle the current tone stops at
+    audioEdge next;    // Taken off the ring but not reached yet
+    bool hasNext;
+    uint32_t phase;    // Samples into the current square wave period
+    int16_t volume;
+} audioPlayer;
+
+// latencySamples is how far behind the emulator the player may fall before it skips ahead, keep it a few buffers
+// Pass 0 when rendering offline, the player then only ever waits for the clock
+void initAudioPlayer(audioPlayer *p, audioRing *ring, uint32_t sampleRate, uint32_t cyclesPerSecond, uint32_t latencySamples);
+
+// Samples that can be rendered before the player catches up with the clock
+size_t readyAudioSamples(const audioPlayer *p);
+
+// Fills out with mono signed 16-bit samples. Safe to call from the audio callback
+// Once the player catches up with the clock it holds the current level until emulation moves on
+// A clock that went backwards (a state load or rewind) restarts the player from there in silence, playing only the
+// tones pushed since rewindAudioRing
+void renderAudio(audioPlayer *p, int16_t *out, size_t samples);
+
+#endif // AUDIO_H_INCLUDE
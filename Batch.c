@@ -0,0 +1,712 @@
+// Headless batch runner
+// Runs many ROM instances on a worker pool with no window and no pacing, then writes one result line per instance
+// Build with: gcc -O2 -pthread Batch.c -o batch
+// Add -DCHIP8_PROFILE for --profile and -DCHIP8_TRACE for --trace
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "Chip8.c"
+#include "Threaded.c"
+#include "Jit.c"
+#include "Lockstep.c"
+#include "RomCache.c"
+#include "Capture.c"
+#ifdef CHIP8_PROFILE
+#include "Profile.c"
+#endif
+#ifdef CHIP8_TRACE
+#include "Trace.c"
+#endif
+
+typedef enum {
+    EXIT_BUDGET,          // Ran the full cycle budget
+    EXIT_KEY_WAIT,        // Hit FX0A, nothing will ever press a key
+    EXIT_PC_BOUNDS,       // Program counter left memory
+    EXIT_STACK_OVERFLOW,  // 2NNN with a full stack
+    EXIT_STACK_UNDERFLOW, // 00EE with an empty stack
+    EXIT_I_BOUNDS,        // FX33, FX55 or FX65 ran past the end of memory
+    EXIT_INIT_FAILED      // ROM could not be loaded
+} exitReason;
+
+const char *exitReasonNames[] = {
+    "budget", "keywait", "pc_out_of_bounds", "stack_overflow", "stack_underflow", "i_out_of_bounds", "init_failed"
+};
+
+// The exit reason for a status an engine stopped with
+exitReason faultReason(chip8Status status) {
+    switch(status) {
+        case CHIP8_PC_OUT_OF_BOUNDS: return EXIT_PC_BOUNDS;
+        case CHIP8_STACK_OVERFLOW:   return EXIT_STACK_OVERFLOW;
+        case CHIP8_STACK_UNDERFLOW:  return EXIT_STACK_UNDERFLOW;
+        case CHIP8_I_OUT_OF_BOUNDS:  return EXIT_I_BOUNDS;
+        default:                     return EXIT_BUDGET;
+    }
+}
+
+typedef enum {
+    ENGINE_INTERP,
+    ENGINE_THREADED,
+    ENGINE_JIT,
+    ENGINE_LOCKSTEP
+} engineType;
+
+typedef struct {
+    // Input
+    const char *rom;
+    unsigned int seed;
+
+    // Output
+    uint64_t cycles;
+    uint64_t screenHash;
+    exitReason reason;
+} job;
+
+typedef struct {
+    job *jobs;
+    size_t jobCount;
+    atomic_size_t nextJob;
+    uint64_t cycleBudget;
+    uint32_t cyclesPerFrame;
+    quirkProfile quirks;
+    bool idleSkip;
+    int engine;
+    bool profiling;
+    const char *wavBase;   // Write each job's audio to <wavBase>-<index>.wav, NULL for none
+    atomic_uint wavErrors; // WAV files that couldn't be written
+    const char *captureBase;        // Capture each job's screen to <captureBase>-<index>.c8v, NULL for none
+    captureWriter *capture;         // Shared by every worker so disk writes never hold up emulation
+    atomic_ullong capturedFrames;   // Frames stored across every capture
+    atomic_ullong droppedFrames;    // Frames lost because the writer was too far behind
+    const char *traceBase;          // Dump each faulting job's trace to <traceBase>-<index>.c8t, NULL for none
+    bool traceAll;                  // Dump every job's trace, not only the ones that faulted
+} jobQueue;
+
+// Per-worker engine state, reused from job to job
+typedef struct {
+    int engine; // The queue's, unless this worker couldn't set it up and fell back to the interpreter
+    decodeCache *cache;
+    jitCache *jit;
+    lockstepGroup *group;
+#ifdef CHIP8_PROFILE
+    chip8Profile *profile; // Every job this worker ran, merged into one by main
+#endif
+#ifdef CHIP8_TRACE
+    chip8Trace *trace;     // Reset for each job
+#endif
+} workerState;
+
+// Every seed of a ROM starts from the same cached image, so the file is only read once per run
+int startJob(jobQueue *queue, job *j, chip8 *c8) {
+    const romImage *rom = loadRom(j->rom);
+    if(!rom || initializeFromRom(c8, rom, queue->quirks, j->seed) != 0) {
+        j->reason = EXIT_INIT_FAILED;
+        return -1;
+    }
+    c8->cyclesPerFrame = queue->cyclesPerFrame;
+    c8->idleSkip = queue->idleSkip;
+    return 0;
+}
+
+// WAV DUMP ====================================================================
+// 16-bit mono PCM. Written with zero sizes first, finishWav fills them in once the length is known
+void writeWavHeader(FILE *file, uint32_t sampleRate, uint32_t samples) {
+    uint8_t header[44];
+    uint32_t fields[] = {36 + samples * 2, 16, 1 | (1 << 16), sampleRate, sampleRate * 2, 2 | (16 << 16), samples * 2};
+    memcpy(header, "RIFF", 4);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    memcpy(header + 36, "data", 4);
+    const int offsets[] = {4, 16, 20, 24, 28, 32, 40};
+    for(int f = 0; f < 7; f++) {
+        for(int i = 0; i < 4; i++) {
+            header[offsets[f] + i] = (fields[f] >> (i * 8)) & 0xFF;
+        }
+    }
+    fwrite(header, 1, sizeof(header), file);
+}
+
+void finishWav(FILE *file, uint32_t sampleRate, uint32_t samples) {
+    fseek(file, 0, SEEK_SET);
+    writeWavHeader(file, sampleRate, samples);
+    fclose(file);
+}
+
+// Renders everything the machine has run so far. Samples are little-endian on disk, like the header
+uint32_t drainAudio(audioPlayer *player, FILE *file) {
+    int16_t samples[1024];
+    uint32_t written = 0;
+    size_t ready;
+    while((ready = readyAudioSamples(player)) > 0) {
+        size_t count = ready < 1024 ? ready : 1024;
+        renderAudio(player, samples, count);
+        for(size_t i = 0; i < count; i++) {
+            fputc(samples[i] & 0xFF, file);
+            fputc((samples[i] >> 8) & 0xFF, file);
+        }
+        written += count;
+    }
+    return written;
+}
+
+// RUNNING JOBS ================================================================
+// Runs up to `cycles` cycles with the worker's engine, stopping early on a key wait or a fault
+chip8Status runCycles(workerState *state, chip8 *c8, uint64_t cycles) {
+    if(state->engine == ENGINE_JIT) {
+        return emulateCyclesJit(c8, state->jit, cycles);
+    }
+    if(state->engine == ENGINE_THREADED) {
+        return emulateCyclesThreaded(c8, state->cache, cycles);
+    }
+
+    return emulateCycles(c8, cycles);
+}
+
+void runJob(jobQueue *queue, job *j, workerState *state) {
+    chip8 c8;
+    if(startJob(queue, j, &c8) != 0) {
+        return;
+    }
+    if(state->engine == ENGINE_JIT) {
+        resetJit(state->jit);
+    } else if(state->engine == ENGINE_THREADED) {
+        resetDecodeCache(state->cache);
+    }
+#ifdef CHIP8_PROFILE
+    c8.profile = state->profile;
+#endif
+#ifdef CHIP8_TRACE
+    if(state->trace) {
+        resetTrace(state->trace);
+        c8.trace = state->trace;
+    }
+#endif
+
+    // Audio is rendered between chunks short enough that FX18 can't overfill the ring, even once per cycle
+    audioRing audio;
+    audioPlayer player;
+    FILE *wav = NULL;
+    uint32_t wavSamples = 0;
+    uint64_t chunk = queue->cycleBudget;
+    if(queue->wavBase) {
+        char name[4096];
+        snprintf(name, sizeof(name), "%s-%zu.wav", queue->wavBase, (size_t) (j - queue->jobs));
+        wav = fopen(name, "wb");
+        if(wav) {
+            initAudioRing(&audio);
+            initAudioPlayer(&player, &audio, AUDIO_DEFAULT_SAMPLE_RATE, queue->cyclesPerFrame * 60, 0);
+            c8.audio = &audio;
+            writeWavHeader(wav, AUDIO_DEFAULT_SAMPLE_RATE, 0);
+            chunk = AUDIO_RING_SIZE;
+        } else {
+            atomic_fetch_add(&queue->wavErrors, 1);
+        }
+    }
+
+    // Captures run a frame at a time so each screen is taken right as the frame ends
+    capture screen;
+    bool capturing = false;
+    if(queue->captureBase) {
+        char name[4096];
+        snprintf(name, sizeof(name), "%s-%zu.c8v", queue->captureBase, (size_t) (j - queue->jobs));
+        capturing = startCapture(&screen, queue->capture, name, &c8) == 0;
+    }
+
+    j->reason = EXIT_BUDGET;
+    chip8Status stopped = CHIP8_OK;
+    while(c8.cycleCount < queue->cycleBudget) {
+        uint64_t left = queue->cycleBudget - c8.cycleCount;
+        if(left > chunk) {
+            left = chunk;
+        }
+        if(capturing) {
+            uint64_t frameLeft = c8.cyclesPerFrame - c8.cycleCount % c8.cyclesPerFrame;
+            left = left < frameLeft ? left : frameLeft;
+        }
+        chip8Status result = runCycles(state, &c8, left);
+        if(capturing && c8.cycleCount % c8.cyclesPerFrame == 0) {
+            captureFrame(&screen, &c8);
+        }
+        if(wav) {
+            publishAudioClock(&audio, c8.cycleCount);
+            wavSamples += drainAudio(&player, wav);
+        }
+        if(result != CHIP8_OK) {
+            j->reason = faultReason(result);
+            stopped = result;
+            break;
+        }
+        if(c8.keyWait) {
+            j->reason = EXIT_KEY_WAIT;
+            break;
+        }
+    }
+#ifdef CHIP8_TRACE
+    if(state->trace && (stopped != CHIP8_OK || queue->traceAll)) {
+        char name[4096];
+        snprintf(name, sizeof(name), "%s-%zu.c8t", queue->traceBase, (size_t) (j - queue->jobs));
+        writeTraceFile(state->trace, &c8, stopped, name);
+    }
+#else
+    (void) stopped;
+#endif
+    if(wav) {
+        finishWav(wav, AUDIO_DEFAULT_SAMPLE_RATE, wavSamples);
+    }
+    if(capturing) {
+        stopCapture(&screen, &c8);
+        atomic_fetch_add(&queue->capturedFrames, screen.stored);
+        atomic_fetch_add(&queue->droppedFrames, screen.dropped);
+    }
+
+    j->cycles = c8.cycleCount;
+    j->screenHash = hashScreen(&c8);
+}
+
+// Runs up to LOCKSTEP_LANES jobs side by side in one lockstep group
+void runLockstepJobs(jobQueue *queue, job *jobs, size_t count, workerState *state) {
+    chip8 c8;
+    initLockstep(state->group);
+    for(size_t lane = 0; lane < count; lane++) {
+        if(startJob(queue, &jobs[lane], &c8) == 0) {
+            loadLane(state->group, lane, &c8);
+        }
+    }
+
+    emulateCyclesLockstep(state->group, queue->cycleBudget);
+
+    for(size_t lane = 0; lane < count; lane++) {
+        job *j = &jobs[lane];
+        laneStatus status = state->group->status[lane];
+        if(status == LANE_EMPTY) {
+            continue;
+        }
+        storeLane(state->group, lane, &c8);
+        j->reason = status == LANE_KEY_WAIT ? EXIT_KEY_WAIT : status == LANE_FAULT ? faultReason(state->group->fault[lane]) : EXIT_BUDGET;
+        j->cycles = c8.cycleCount;
+        j->screenHash = hashScreen(&c8);
+    }
+}
+
+void *worker(void *arg) {
+    jobQueue *queue = arg;
+    size_t index;
+    workerState state = {0};
+    state.engine = queue->engine;
+    if(queue->engine == ENGINE_THREADED) {
+        state.cache = malloc(sizeof(decodeCache));
+    } else if(queue->engine == ENGINE_JIT) {
+        // main has already checked there's a JIT, but each worker maps its own buffer and that can still fail
+        state.jit = malloc(sizeof(jitCache));
+        if(initJit(state.jit) != 0) {
+            printf("Could not set up the JIT in a worker, it runs the interp engine instead\n");
+            free(state.jit);
+            state.jit = NULL;
+            state.engine = ENGINE_INTERP;
+        }
+    } else if(queue->engine == ENGINE_LOCKSTEP) {
+        state.group = malloc(sizeof(lockstepGroup));
+    }
+#ifdef CHIP8_PROFILE
+    if(queue->profiling) {
+        state.profile = calloc(1, sizeof(chip8Profile));
+    }
+#endif
+#ifdef CHIP8_TRACE
+    if(queue->traceBase) {
+        state.trace = malloc(sizeof(chip8Trace));
+    }
+#endif
+
+    if(queue->engine == ENGINE_LOCKSTEP) {
+        // Claimed a group's worth at a time. Seeds of the same ROM are next to each other in the list,
+        // so a group is usually one ROM and its lanes only part ways where the seeds make them
+        while((index = atomic_fetch_add(&queue->nextJob, LOCKSTEP_LANES)) < queue->jobCount) {
+            size_t count = queue->jobCount - index < LOCKSTEP_LANES ? queue->jobCount - index : LOCKSTEP_LANES;
+            runLockstepJobs(queue, &queue->jobs[index], count, &state);
+        }
+    } else {
+        // Jobs are claimed one at a time so long and short ROMs still balance across workers
+        while((index = atomic_fetch_add(&queue->nextJob, 1)) < queue->jobCount) {
+            runJob(queue, &queue->jobs[index], &state);
+        }
+    }
+
+    if(state.jit) {
+        freeJit(state.jit);
+    }
+    free(state.jit);
+    free(state.cache);
+    free(state.group);
+#ifdef CHIP8_TRACE
+    free(state.trace);
+#endif
+#ifdef CHIP8_PROFILE
+    return state.profile;
+#else
+    return NULL;
+#endif
+}
+
+// Reads one ROM path per line, blank lines are ignored
+int readRomList(const char *filename, char ***paths, size_t *pathCount) {
+    FILE *file = fopen(filename, "r");
+    if(!file) {
+        printf("Could not open ROM list %s\n", filename);
+        return -1;
+    }
+
+    char line[4096];
+    size_t capacity = 0;
+    while(fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if(line[0] == '\0') {
+            continue;
+        }
+        if(*pathCount == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            char **grown = realloc(*paths, capacity * sizeof(char *));
+            if(!grown) {
+                printf("Out of memory reading ROM list %s\n", filename);
+                fclose(file);
+                return -1;
+            }
+            *paths = grown;
+        }
+        char *path = strdup(line);
+        if(!path) {
+            printf("Out of memory reading ROM list %s\n", filename);
+            fclose(file);
+            return -1;
+        }
+        (*paths)[(*pathCount)++] = path;
+    }
+
+    fclose(file);
+    return 0;
+}
+
+// Adds a job for every seed 1..seeds of every ROM, the jobs point at the paths rather than copying them
+int addJobs(jobQueue *queue, const char *const *paths, size_t pathCount, unsigned int seeds) {
+    if(pathCount == 0 || seeds == 0) {
+        return 0;
+    }
+    if(seeds > (SIZE_MAX / sizeof(job) - queue->jobCount) / pathCount) {
+        printf("Too many jobs, %zu ROMs with %u seeds each\n", pathCount, seeds);
+        return -1;
+    }
+    job *jobs = realloc(queue->jobs, (queue->jobCount + pathCount * seeds) * sizeof(job));
+    if(!jobs) {
+        printf("Out of memory for %zu ROMs with %u seeds each\n", pathCount, seeds);
+        return -1;
+    }
+    queue->jobs = jobs;
+    for(size_t r = 0; r < pathCount; r++) {
+        for(unsigned int s = 1; s <= seeds; s++) {
+            job *j = &queue->jobs[queue->jobCount++];
+            memset(j, 0, sizeof(job));
+            j->rom = paths[r];
+            j->seed = s;
+        }
+    }
+    return 0;
+}
+
+void printUsage() {
+    printf("Usage: batch [options] <rom>...\n");
+    printf("  --list <file>     Read ROM paths from a file, one per line\n");
+    printf("  --seeds <n>       Run each ROM n times with seeds 1..n (default 1)\n");
+    printf("  --cycles <n>      Cycle budget per instance (default 1000000)\n");
+    printf("  --frames <n>      Frame budget per instance, overrides --cycles\n");
+    printf("  --cpf <n>         Cycles per 60 Hz timer frame (default %d)\n", DEFAULT_CYCLES_PER_FRAME);
+    printf("  --threads <n>     Worker count (default: one per online core)\n");
+    printf("  --engine <name>   interp, threaded, jit or lockstep (default threaded)\n");
+    printf("  --quirks <name>   vip, chip48, schip or modern (default modern)\n");
+    printf("  --legacy          Same as --quirks vip\n");
+    printf("  --no-idle-skip    Execute idle loops cycle by cycle instead of fast-forwarding them\n");
+    printf("  --out <file>      Write results here instead of stdout\n");
+    printf("  --wav <base>      Write each instance's beeper to <base>-<index>.wav, 48 kHz mono\n");
+    printf("  --capture <base>  Write each instance's screen to <base>-<index>.c8v, see capturetool\n");
+    printf("  --profile <base>  Profile with the interp engine, writing <base>.json and <base>.lst\n");
+    printf("                    Needs a build with -DCHIP8_PROFILE\n");
+    printf("  --profile-format <name>  json or csv (default json)\n");
+    printf("  --trace <base>    Trace with the interp engine, dumping each instance that faults to <base>-<index>.c8t\n");
+    printf("                    Needs a build with -DCHIP8_TRACE, see tracetool\n");
+    printf("  --trace-all       Dump every instance's trace, not only the ones that fault\n");
+}
+
+int main(int argc, char *argv[]) {
+    jobQueue queue;
+    queue.jobs = NULL;
+    queue.jobCount = 0;
+    queue.cycleBudget = 1000000;
+    queue.cyclesPerFrame = DEFAULT_CYCLES_PER_FRAME;
+    queue.quirks = QUIRKS_MODERN;
+    queue.idleSkip = true;
+    queue.engine = ENGINE_THREADED;
+    queue.profiling = false;
+    queue.wavBase = NULL;
+    atomic_init(&queue.wavErrors, 0);
+    queue.captureBase = NULL;
+    queue.capture = NULL;
+    atomic_init(&queue.capturedFrames, 0);
+    atomic_init(&queue.droppedFrames, 0);
+    queue.traceBase = NULL;
+    queue.traceAll = false;
+    atomic_init(&queue.nextJob, 0);
+
+    long threadCount = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned int seeds = 1;
+    uint64_t frameBudget = 0;
+    const char *outName = NULL;
+    const char *listName = NULL;
+    const char *profileBase = NULL;
+    bool profileCsv = false;
+
+    const char **roms = malloc(argc * sizeof(char *));
+    int romCount = 0;
+
+    for(int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if(strcmp(argv[i], "--list") == 0 && hasValue) {
+            listName = argv[++i];
+        } else if(strcmp(argv[i], "--seeds") == 0 && hasValue) {
+            seeds = strtoul(argv[++i], NULL, 0);
+        } else if(strcmp(argv[i], "--cycles") == 0 && hasValue) {
+            queue.cycleBudget = strtoull(argv[++i], NULL, 0);
+        } else if(strcmp(argv[i], "--frames") == 0 && hasValue) {
+            frameBudget = strtoull(argv[++i], NULL, 0);
+        } else if(strcmp(argv[i], "--cpf") == 0 && hasValue) {
+            queue.cyclesPerFrame = strtoul(argv[++i], NULL, 0);
+        } else if(strcmp(argv[i], "--threads") == 0 && hasValue) {
+            threadCount = strtol(argv[++i], NULL, 0);
+        } else if(strcmp(argv[i], "--engine") == 0 && hasValue) {
+            i++;
+            if(strcmp(argv[i], "interp") == 0) {
+                queue.engine = ENGINE_INTERP;
+            } else if(strcmp(argv[i], "threaded") == 0) {
+                queue.engine = ENGINE_THREADED;
+            } else if(strcmp(argv[i], "jit") == 0) {
+                queue.engine = ENGINE_JIT;
+            } else if(strcmp(argv[i], "lockstep") == 0) {
+                queue.engine = ENGINE_LOCKSTEP;
+            } else {
+                printUsage();
+                return -1;
+            }
+        } else if(strcmp(argv[i], "--quirks") == 0 && hasValue) {
+            int quirks = findQuirkProfile(argv[++i]);
+            if(quirks < 0) {
+                printUsage();
+                return -1;
+            }
+            queue.quirks = quirks;
+        } else if(strcmp(argv[i], "--legacy") == 0) {
+            queue.quirks = QUIRKS_VIP;
+        } else if(strcmp(argv[i], "--no-idle-skip") == 0) {
+            queue.idleSkip = false;
+        } else if(strcmp(argv[i], "--out") == 0 && hasValue) {
+            outName = argv[++i];
+        } else if(strcmp(argv[i], "--wav") == 0 && hasValue) {
+            queue.wavBase = argv[++i];
+        } else if(strcmp(argv[i], "--capture") == 0 && hasValue) {
+            queue.captureBase = argv[++i];
+        } else if(strcmp(argv[i], "--trace") == 0 && hasValue) {
+            queue.traceBase = argv[++i];
+        } else if(strcmp(argv[i], "--trace-all") == 0) {
+            queue.traceAll = true;
+        } else if(strcmp(argv[i], "--profile") == 0 && hasValue) {
+            profileBase = argv[++i];
+        } else if(strcmp(argv[i], "--profile-format") == 0 && hasValue) {
+            i++;
+            if(strcmp(argv[i], "csv") == 0) {
+                profileCsv = true;
+            } else if(strcmp(argv[i], "json") != 0) {
+                printUsage();
+                return -1;
+            }
+        } else if(argv[i][0] == '-') {
+            printUsage();
+            return -1;
+        } else {
+            roms[romCount++] = argv[i];
+        }
+    }
+
+    // BUILD THE JOB LIST ======================================================
+    // Jobs from the list come first, both lists run every ROM with seeds 1..n
+    char **listed = NULL;
+    size_t listedCount = 0;
+    if(listName && readRomList(listName, &listed, &listedCount) != 0) {
+        return -1;
+    }
+    if(addJobs(&queue, (const char *const *) listed, listedCount, seeds) != 0) {
+        return -1;
+    }
+    if(addJobs(&queue, roms, romCount, seeds) != 0) {
+        return -1;
+    }
+    if(queue.jobCount == 0 || seeds == 0 || queue.cyclesPerFrame == 0) {
+        printUsage();
+        return -1;
+    }
+
+    // RUN =====================================================================
+    if(queue.wavBase && queue.engine == ENGINE_LOCKSTEP) {
+        // FX18 in a lane only sets the timer
+        printf("Lockstep lanes have no audio, --wav uses the threaded engine\n");
+        queue.engine = ENGINE_THREADED;
+    }
+    if(queue.captureBase && queue.engine == ENGINE_LOCKSTEP) {
+        // Lanes only come out of the group once the whole budget has run
+        printf("Lockstep lanes can't be captured frame by frame, --capture uses the threaded engine\n");
+        queue.engine = ENGINE_THREADED;
+    }
+    if(profileBase) {
+#ifdef CHIP8_PROFILE
+        // Only emulateCycle records anything
+        if(queue.engine != ENGINE_INTERP) {
+            printf("Profiling uses the interp engine\n");
+            queue.engine = ENGINE_INTERP;
+        }
+        queue.profiling = true;
+#else
+        printf("--profile needs a build with -DCHIP8_PROFILE\n");
+        return -1;
+#endif
+    }
+    if(queue.traceBase) {
+#ifdef CHIP8_TRACE
+        // Same as profiling, the other engines would only record the odd instruction they hand to emulateCycle
+        if(queue.engine != ENGINE_INTERP) {
+            printf("Tracing uses the interp engine\n");
+            queue.engine = ENGINE_INTERP;
+        }
+#else
+        printf("--trace needs a build with -DCHIP8_TRACE\n");
+        return -1;
+#endif
+    }
+    if(queue.engine == ENGINE_JIT) {
+        // Check once up front so every worker doesn't have to report it
+        jitCache *probe = malloc(sizeof(jitCache));
+        if(initJit(probe) != 0) {
+            printf("JIT not available on this host, falling back to the threaded engine\n");
+            queue.engine = ENGINE_THREADED;
+        }
+        freeJit(probe);
+        free(probe);
+    }
+    if(frameBudget > 0) {
+        queue.cycleBudget = frameBudget * queue.cyclesPerFrame;
+    }
+    if(threadCount < 1) {
+        threadCount = 1;
+    }
+    if((size_t) threadCount > queue.jobCount) {
+        threadCount = queue.jobCount;
+    }
+
+    captureWriter writer;
+    if(queue.captureBase) {
+        if(startCaptureWriter(&writer) != 0) {
+            return -1;
+        }
+        queue.capture = &writer;
+    }
+
+    pthread_t *threads = malloc(threadCount * sizeof(pthread_t));
+    for(long i = 0; i < threadCount; i++) {
+        if(pthread_create(&threads[i], NULL, worker, &queue) != 0) {
+            printf("Could not start worker thread\n");
+            return -1;
+        }
+    }
+#ifdef CHIP8_PROFILE
+    chip8Profile *profile = calloc(1, sizeof(chip8Profile));
+#endif
+    for(long i = 0; i < threadCount; i++) {
+        void *result;
+        pthread_join(threads[i], &result);
+#ifdef CHIP8_PROFILE
+        if(result) {
+            mergeProfile(profile, result);
+            free(result);
+        }
+#else
+        (void) result;
+#endif
+    }
+    if(queue.capture) {
+        stopCaptureWriter(&writer);
+    }
+
+    // REPORT ==================================================================
+    // Results are only written once every worker is done so nothing prints while emulating
+    FILE *out = stdout;
+    if(outName) {
+        out = fopen(outName, "w");
+        if(!out) {
+            printf("Could not open %s for writing\n", outName);
+            return -1;
+        }
+    }
+
+    fprintf(out, "index\trom\tseed\tcycles\tscreen_hash\texit_reason\n");
+    for(size_t i = 0; i < queue.jobCount; i++) {
+        job *j = &queue.jobs[i];
+        fprintf(out, "%zu\t%s\t%u\t%llu\t%016llx\t%s\n", i, j->rom, j->seed,
+                (unsigned long long) j->cycles, (unsigned long long) j->screenHash,
+                exitReasonNames[j->reason]);
+    }
+
+    if(out != stdout) {
+        fclose(out);
+    }
+    if(atomic_load(&queue.wavErrors) > 0) {
+        printf("Could not write %u WAV files\n", atomic_load(&queue.wavErrors));
+    }
+    if(queue.capture) {
+        if(writer.errors > 0) {
+            printf("Could not write %u captures\n", writer.errors);
+        }
+        if(atomic_load(&queue.droppedFrames) > 0) {
+            printf("Captured %llu frames, dropped %llu with the writer too far behind\n",
+                   (unsigned long long) atomic_load(&queue.capturedFrames),
+                   (unsigned long long) atomic_load(&queue.droppedFrames));
+        }
+    }
+
+#ifdef CHIP8_PROFILE
+    if(queue.profiling) {
+        // The listing disassembles the first ROM as loaded. Addresses only line up with the counts when every job
+        // ran that ROM, otherwise the opcode and frame counts still hold but the listing is a mix
+        chip8 c8;
+        if(startJob(&queue, &queue.jobs[0], &c8) == 0) {
+            for(size_t i = 1; i < queue.jobCount; i++) {
+                if(strcmp(queue.jobs[i].rom, queue.jobs[0].rom) != 0) {
+                    printf("Profile covers more than one ROM, the listing shows %s\n", queue.jobs[0].rom);
+                    break;
+                }
+            }
+            writeProfileFiles(profile, &c8, profileBase, profileCsv);
+        }
+    }
+    free(profile);
+#else
+    (void) profileCsv;
+#endif
+    freeRomCache();
+    for(size_t i = 0; i < listedCount; i++) {
+        free(listed[i]);
+    }
+    free(listed);
+    free(queue.jobs);
+    free(threads);
+    free(roms);
+    return 0;
+}
@@ -0,0 +1,536 @@
+// Benchmark suite
+// Times each engine on synthetic ROMs that hammer one opcode family, then end to end on every ROM in roms/
+// Build with: gcc -O2 -pthread Bench.c -o bench
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <dirent.h>
+
+#include "Chip8.c"
+#include "Threaded.c"
+#include "Jit.c"
+#include "Lockstep.c"
+#include "RomCache.c"
+
+typedef enum {
+    ENGINE_INTERP,
+    ENGINE_THREADED,
+    ENGINE_JIT,
+    ENGINE_LOCKSTEP,
+    ENGINE_COUNT
+} engineType;
+
+const char *engineNames[] = {"interp", "threaded", "jit", "lockstep"};
+
+typedef enum {
+    FORMAT_TEXT,
+    FORMAT_JSON,
+    FORMAT_CSV
+} outputFormat;
+
+typedef struct {
+    const char *name;
+    const char *kind;    // "synthetic" or "corpus"
+    char path[4096];     // ROM file for corpus ROMs, empty for synthetic ones
+    const uint8_t *rom;  // Image every trial starts from
+    size_t romSize;
+    bool owned;          // rom was built here rather than cached, free it when done
+} benchmark;
+
+typedef struct {
+    const char *benchmark;
+    const char *kind;
+    const char *engine;
+    bool failed;
+    double medianSeconds, p99Seconds;
+} result;
+
+typedef struct {
+    uint64_t cycles;
+    int trials, warmup;
+    bool idleSkip;
+} settings;
+
+// SYNTHETIC ROMS ==============================================================
+// Each one is a short setup followed by a loop that's almost entirely one family of instructions,
+// so instructions per second for the whole ROM is close to instructions per second for that family
+
+typedef struct {
+    uint8_t code[1024];
+    int size;
+} romBuilder;
+
+void emit(romBuilder *rom, uint16_t opcode) {
+    rom->code[rom->size++] = opcode >> 8;
+    rom->code[rom->size++] = opcode & 0xFF;
+}
+
+uint16_t here(romBuilder *rom) {
+    return 0x200 + rom->size;
+}
+
+// 8XYn arithmetic and logic, including the shifts and the carry/borrow forms
+void buildAlu(romBuilder *rom) {
+    emit(rom, 0x6001);
+    emit(rom, 0x6103);
+    emit(rom, 0x6207);
+    uint16_t loop = here(rom);
+    for(int i = 0; i < 16; i++) {
+        emit(rom, 0x8014);
+        emit(rom, 0x8125);
+        emit(rom, 0x8237);
+        emit(rom, 0x8306);
+        emit(rom, 0x840E);
+        emit(rom, 0x8501);
+        emit(rom, 0x8612);
+        emit(rom, 0x8703);
+    }
+    emit(rom, 0x1000 | loop);
+}
+
+// 3XNN, 4XNN, 5XY0 and 9XY0, half taken and half not
+void buildSkip(romBuilder *rom) {
+    emit(rom, 0x6000);
+    emit(rom, 0x6100);
+    uint16_t loop = here(rom);
+    for(int i = 0; i < 16; i++) {
+        emit(rom, 0x3000); // Taken
+        emit(rom, 0x6200);
+        emit(rom, 0x3001); // Not taken
+        emit(rom, 0x4001); // Taken
+        emit(rom, 0x6200);
+        emit(rom, 0x5010); // Taken
+        emit(rom, 0x6200);
+        emit(rom, 0x9010); // Not taken
+    }
+    emit(rom, 0x1000 | loop);
+}
+
+// DXYN with font sprites at a few positions, some straddling the screen edges
+void buildDraw(romBuilder *rom) {
+    emit(rom, 0x6000);
+    emit(rom, 0x6100);
+    emit(rom, 0x623C); // x = 60, clipped on the right
+    emit(rom, 0x631D); // y = 29, clipped at the bottom
+    emit(rom, 0xA000);
+    uint16_t loop = here(rom);
+    for(int i = 0; i < 16; i++) {
+        emit(rom, 0xD015);
+        emit(rom, 0xD235);
+        emit(rom, 0xD035);
+        emit(rom, 0xD215);
+    }
+    emit(rom, 0x1000 | loop);
+}
+
+// SUPER-CHIP 128x64 mode: 16x16 sprites across the middle of the screen and over the right edge, and scrolls
+void buildHires(romBuilder *rom) {
+    emit(rom, 0x00FF);
+    emit(rom, 0x6000);
+    emit(rom, 0x6120);
+    emit(rom, 0x6278); // x = 120, clipped on the right
+    emit(rom, 0x633A); // y = 58, clipped at the bottom
+    emit(rom, 0xA000);
+    uint16_t loop = here(rom);
+    for(int i = 0; i < 8; i++) {
+        emit(rom, 0xD010);
+        emit(rom, 0xD230);
+        emit(rom, 0x00C1);
+        emit(rom, 0x00FB);
+        emit(rom, 0xD010);
+        emit(rom, 0x00FC);
+    }
+    emit(rom, 0x1000 | loop);
+}
+
+// FX55 and FX65 moving all sixteen registers, with ANNN to keep I in place
+void buildMemory(romBuilder *rom) {
+    uint16_t loop = here(rom);
+    for(int i = 0; i < 16; i++) {
+        emit(rom, 0xA400);
+        emit(rom, 0xFF55);
+        emit(rom, 0xFF65);
+    }
+    emit(rom, 0x1000 | loop);
+}
+
+// 2NNN and 00EE pairs
+void buildCall(romBuilder *rom) {
+    uint16_t loop = here(rom);
+    uint16_t subroutine = loop + 16 * 2 + 2;
+    for(int i = 0; i < 16; i++) {
+        emit(rom, 0x2000 | subroutine);
+    }
+    emit(rom, 0x1000 | loop);
+    emit(rom, 0x00EE);
+}
+
+// A key-polling wait, where most ROMs sit at a title screen. Nothing in it reads the timers,
+// so with idle skipping a trial is a few laps of detection and then one jump to the end of the budget
+void buildIdle(romBuilder *rom) {
+    emit(rom, 0x6005);
+    uint16_t wait = here(rom);
+    emit(rom, 0xE09E);
+    emit(rom, 0x1000 | wait);
+    emit(rom, 0x1200);
+}
+
+typedef struct {
+    const char *name;
+    void (*build)(romBuilder *rom);
+} syntheticRom;
+
+const syntheticRom syntheticRoms[] = {
+    {"alu",    buildAlu},
+    {"skip",   buildSkip},
+    {"draw",   buildDraw},
+    {"hires",  buildHires},
+    {"memory", buildMemory},
+    {"call",   buildCall},
+    {"idle",   buildIdle},
+};
+
+void buildSynthetic(benchmark *b, const syntheticRom *synthetic) {
+    romBuilder rom;
+    rom.size = 0;
+    synthetic->build(&rom);
+
+    uint8_t *code = malloc(rom.size);
+    memcpy(code, rom.code, rom.size);
+    b->path[0] = '\0';
+    b->rom = code;
+    b->romSize = rom.size;
+    b->name = synthetic->name;
+    b->kind = "synthetic";
+    b->owned = true;
+}
+
+// TIMING ======================================================================
+double now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1E9;
+}
+
+// Runs LOCKSTEP_LANES fresh instances with seeds 1 and up in one group, the way batch runs a ROM's seeds
+// The time is scaled to one instance's budget, so MIPS counts every lane's instructions. A lane stopped by FX0A can't
+// rejoin the group, so it only counts the cycles it ran
+double runLockstepTrial(const benchmark *b, const settings *s, lockstepGroup *group) {
+    chip8 c8;
+    initLockstep(group);
+    for(int lane = 0; lane < LOCKSTEP_LANES; lane++) {
+        if(initializeFromMemory(&c8, b->rom, b->romSize, QUIRKS_MODERN, lane + 1) != 0) {
+            return -1;
+        }
+        loadLane(group, lane, &c8);
+    }
+
+    double start = now();
+    emulateCyclesLockstep(group, s->cycles);
+    double time = now() - start;
+
+    uint64_t cycles = 0;
+    for(int lane = 0; lane < LOCKSTEP_LANES; lane++) {
+        if(group->status[lane] == LANE_FAULT) {
+            return -1;
+        }
+        cycles += group->status[lane] == LANE_KEY_WAIT ? group->stopCycle[lane] : group->cycleCount;
+    }
+    return cycles > 0 ? time * s->cycles / cycles : -1;
+}
+
+// Runs one fresh instance for the cycle budget and returns the time taken, or -1 if the ROM failed or faulted
+// Key waits are answered straight away so corpus ROMs that ask for input still run the whole budget
+double runTrial(const benchmark *b, engineType engine, const settings *s, decodeCache *cache, jitCache *jit,
+                lockstepGroup *group) {
+    if(engine == ENGINE_LOCKSTEP) {
+        return runLockstepTrial(b, s, group);
+    }
+
+    const uint64_t cycles = s->cycles;
+    chip8 c8;
+    if(initializeFromMemory(&c8, b->rom, b->romSize, QUIRKS_MODERN, 1) != 0) {
+        return -1;
+    }
+    c8.idleSkip = s->idleSkip;
+    if(engine == ENGINE_THREADED) {
+        resetDecodeCache(cache);
+    } else if(engine == ENGINE_JIT) {
+        resetJit(jit);
+    }
+
+    double start = now();
+    while(c8.cycleCount < cycles) {
+        chip8Status status;
+        if(engine == ENGINE_JIT) {
+            status = emulateCyclesJit(&c8, jit, cycles - c8.cycleCount);
+        } else if(engine == ENGINE_THREADED) {
+            status = emulateCyclesThreaded(&c8, cache, cycles - c8.cycleCount);
+        } else {
+            status = emulateCycles(&c8, cycles - c8.cycleCount);
+        }
+        if(status != CHIP8_OK) {
+            return -1;
+        }
+        if(c8.keyWait) {
+            setKey(&c8, 0, true);
+            setKey(&c8, 0, false);
+        }
+    }
+    return now() - start;
+}
+
+int compareDoubles(const void *a, const void *b) {
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+result runBenchmark(const benchmark *b, engineType engine, const settings *s, decodeCache *cache, jitCache *jit,
+                    lockstepGroup *group) {
+    result r = {b->name, b->kind, engineNames[engine], false, 0, 0};
+    double *times = malloc(s->trials * sizeof(double));
+
+    for(int i = 0; i < s->warmup + s->trials; i++) {
+        double t = runTrial(b, engine, s, cache, jit, group);
+        if(t < 0) {
+            r.failed = true;
+            break;
+        }
+        if(i >= s->warmup) {
+            times[i - s->warmup] = t;
+        }
+    }
+
+    if(!r.failed) {
+        // Nearest rank percentiles. With few trials p99 is simply the slowest one
+        qsort(times, s->trials, sizeof(double), compareDoubles);
+        r.medianSeconds = s->trials % 2 ? times[s->trials / 2] : (times[s->trials / 2 - 1] + times[s->trials / 2]) / 2;
+        int p99 = (s->trials * 99 + 99) / 100 - 1;
+        r.p99Seconds = times[p99];
+    }
+    free(times);
+    return r;
+}
+
+// CORPUS ======================================================================
+int compareBenchmarks(const void *a, const void *b) {
+    return strcmp(((const benchmark *) a)->path, ((const benchmark *) b)->path);
+}
+
+// Adds every .ch8 file in dir, sorted by name so runs line up
+int findCorpus(const char *dir, benchmark **benchmarks, int *count) {
+    DIR *d = opendir(dir);
+    if(!d) {
+        printf("Could not open ROM directory %s, skipping the corpus\n", dir);
+        return -1;
+    }
+
+    int first = *count;
+    struct dirent *entry;
+    while((entry = readdir(d))) {
+        size_t length = strlen(entry->d_name);
+        if(length < 4 || strcmp(entry->d_name + length - 4, ".ch8") != 0) {
+            continue;
+        }
+        *benchmarks = realloc(*benchmarks, (*count + 1) * sizeof(benchmark));
+        benchmark *b = &(*benchmarks)[*count];
+        snprintf(b->path, sizeof(b->path), "%s/%s", dir, entry->d_name);
+        const romImage *image = loadRom(b->path);
+        if(!image) {
+            continue;
+        }
+        b->rom = image->data;
+        b->romSize = image->size;
+        b->name = strdup(entry->d_name);
+        b->kind = "corpus";
+        b->owned = false;
+        (*count)++;
+    }
+    closedir(d);
+
+    qsort(*benchmarks + first, *count - first, sizeof(benchmark), compareBenchmarks);
+    return 0;
+}
+
+// REPORTING ===================================================================
+void printResults(FILE *out, outputFormat format, const settings *s, const result *results, int count) {
+    if(format == FORMAT_JSON) {
+        fprintf(out, "{\n  \"cycles\": %llu,\n  \"trials\": %d,\n  \"warmup\": %d,\n  \"results\": [\n",
+                (unsigned long long) s->cycles, s->trials, s->warmup);
+        for(int i = 0; i < count; i++) {
+            const result *r = &results[i];
+            fprintf(out, "    {\"benchmark\": \"%s\", \"kind\": \"%s\", \"engine\": \"%s\", ", r->benchmark, r->kind, r->engine);
+            if(r->failed) {
+                fprintf(out, "\"failed\": true}");
+            } else {
+                fprintf(out, "\"median_seconds\": %.9f, \"p99_seconds\": %.9f, \"median_ips\": %.0f, \"p99_ips\": %.0f}",
+                        r->medianSeconds, r->p99Seconds, s->cycles / r->medianSeconds, s->cycles / r->p99Seconds);
+            }
+            fprintf(out, "%s\n", i + 1 < count ? "," : "");
+        }
+        fprintf(out, "  ]\n}\n");
+    } else if(format == FORMAT_CSV) {
+        fprintf(out, "benchmark,kind,engine,cycles,median_seconds,p99_seconds,median_ips,p99_ips\n");
+        for(int i = 0; i < count; i++) {
+            const result *r = &results[i];
+            if(r->failed) {
+                fprintf(out, "%s,%s,%s,%llu,,,,\n", r->benchmark, r->kind, r->engine, (unsigned long long) s->cycles);
+            } else {
+                fprintf(out, "%s,%s,%s,%llu,%.9f,%.9f,%.0f,%.0f\n", r->benchmark, r->kind, r->engine,
+                        (unsigned long long) s->cycles, r->medianSeconds, r->p99Seconds,
+                        s->cycles / r->medianSeconds, s->cycles / r->p99Seconds);
+            }
+        }
+    } else {
+        fprintf(out, "%llu cycles per trial, %d trials after %d warmup\n",
+                (unsigned long long) s->cycles, s->trials, s->warmup);
+        fprintf(out, "%-20s %-10s %-9s %14s %14s\n", "benchmark", "kind", "engine", "median MIPS", "p99 MIPS");
+        for(int i = 0; i < count; i++) {
+            const result *r = &results[i];
+            if(r->failed) {
+                fprintf(out, "%-20s %-10s %-9s %14s %14s\n", r->benchmark, r->kind, r->engine, "failed", "failed");
+            } else {
+                fprintf(out, "%-20s %-10s %-9s %14.2f %14.2f\n", r->benchmark, r->kind, r->engine,
+                        s->cycles / r->medianSeconds / 1E6, s->cycles / r->p99Seconds / 1E6);
+            }
+        }
+    }
+}
+
+void printUsage() {
+    printf("Usage: bench [options]\n");
+    printf("  --engine <name>   interp, threaded, jit, lockstep or all (default all)\n");
+    printf("  --cycles <n>      Cycles per trial (default 2000000)\n");
+    printf("  --trials <n>      Timed trials per benchmark (default 15)\n");
+    printf("  --warmup <n>      Untimed trials first (default 3)\n");
+    printf("  --corpus <dir>    Directory of .ch8 ROMs to run end to end (default roms)\n");
+    printf("  --only <text>     Only run benchmarks whose name contains text\n");
+    printf("  --no-idle-skip    Execute idle loops cycle by cycle, so MIPS counts only work actually done\n");
+    printf("  --format <name>   text, json or csv (default text)\n");
+    printf("  --out <file>      Write results here instead of stdout\n");
+}
+
+int main(int argc, char *argv[]) {
+    settings s = {2000000, 15, 3, true};
+    bool engines[ENGINE_COUNT] = {true, true, true, true};
+    outputFormat format = FORMAT_TEXT;
+    const char *corpus = "roms";
+    const char *only = NULL;
+    const char *outName = NULL;
+
+    for(int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if(strcmp(argv[i], "--engine") == 0 && hasValue) {
+            i++;
+            bool all = strcmp(argv[i], "all") == 0;
+            bool found = all;
+            for(int e = 0; e < ENGINE_COUNT; e++) {
+                engines[e] = all || strcmp(argv[i], engineNames[e]) == 0;
+                found |= engines[e];
+            }
+            if(!found) {
+                printUsage();
+                return -1;
+            }
+        } else if(strcmp(argv[i], "--cycles") == 0 && hasValue) {
+            s.cycles = strtoull(argv[++i], NULL, 0);
+        } else if(strcmp(argv[i], "--trials") == 0 && hasValue) {
+            s.trials = strtol(argv[++i], NULL, 0);
+        } else if(strcmp(argv[i], "--warmup") == 0 && hasValue) {
+            s.warmup = strtol(argv[++i], NULL, 0);
+        } else if(strcmp(argv[i], "--corpus") == 0 && hasValue) {
+            corpus = argv[++i];
+        } else if(strcmp(argv[i], "--only") == 0 && hasValue) {
+            only = argv[++i];
+        } else if(strcmp(argv[i], "--no-idle-skip") == 0) {
+            s.idleSkip = false;
+        } else if(strcmp(argv[i], "--format") == 0 && hasValue) {
+            i++;
+            if(strcmp(argv[i], "text") == 0) {
+                format = FORMAT_TEXT;
+            } else if(strcmp(argv[i], "json") == 0) {
+                format = FORMAT_JSON;
+            } else if(strcmp(argv[i], "csv") == 0) {
+                format = FORMAT_CSV;
+            } else {
+                printUsage();
+                return -1;
+            }
+        } else if(strcmp(argv[i], "--out") == 0 && hasValue) {
+            outName = argv[++i];
+        } else {
+            printUsage();
+            return -1;
+        }
+    }
+    if(s.cycles == 0 || s.trials < 1 || s.warmup < 0) {
+        printUsage();
+        return -1;
+    }
+
+    // Engine state is shared by every trial, each trial resets it
+    decodeCache *cache = malloc(sizeof(decodeCache));
+    jitCache *jit = malloc(sizeof(jitCache));
+    lockstepGroup *group = malloc(sizeof(lockstepGroup));
+    if(engines[ENGINE_JIT] && initJit(jit) != 0) {
+        fprintf(stderr, "JIT not available on this host, skipping it\n");
+        engines[ENGINE_JIT] = false;
+    }
+
+    // BUILD THE BENCHMARK LIST ================================================
+    int syntheticCount = sizeof(syntheticRoms) / sizeof(syntheticRoms[0]);
+    benchmark *benchmarks = malloc(syntheticCount * sizeof(benchmark));
+    int benchmarkCount = 0;
+    for(int i = 0; i < syntheticCount; i++) {
+        buildSynthetic(&benchmarks[benchmarkCount++], &syntheticRoms[i]);
+    }
+    findCorpus(corpus, &benchmarks, &benchmarkCount);
+
+    // RUN =====================================================================
+    result *results = malloc(benchmarkCount * ENGINE_COUNT * sizeof(result));
+    int resultCount = 0;
+    for(int i = 0; i < benchmarkCount; i++) {
+        if(only && !strstr(benchmarks[i].name, only)) {
+            continue;
+        }
+        for(int e = 0; e < ENGINE_COUNT; e++) {
+            if(engines[e]) {
+                results[resultCount++] = runBenchmark(&benchmarks[i], e, &s, cache, jit, group);
+            }
+        }
+    }
+
+    // REPORT ==================================================================
+    FILE *out = stdout;
+    if(outName) {
+        out = fopen(outName, "w");
+        if(!out) {
+            printf("Could not open %s for writing\n", outName);
+            return -1;
+        }
+    }
+    printResults(out, format, &s, results, resultCount);
+    if(out != stdout) {
+        fclose(out);
+    }
+
+    for(int i = 0; i < benchmarkCount; i++) {
+        if(benchmarks[i].owned) {
+            free((void *) benchmarks[i].rom);
+        }
+    }
+    freeRomCache();
+    if(engines[ENGINE_JIT]) {
+        freeJit(jit);
+    }
+    free(jit);
+    free(cache);
+    free(group);
+    free(results);
+    free(benchmarks);
+    return 0;
+}
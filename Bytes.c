@@ -0,0 +1,84 @@
+#ifndef BYTES_C_INCLUDE
+#define BYTES_C_INCLUDE
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Bytes.h"
+
+// LITTLE-ENDIAN ===============================================================
+uint8_t *putLittleEndian(uint8_t *p, uint64_t value, int bytes) {
+    for(int i = 0; i < bytes; i++) {
+        *p++ = (value >> (i * 8)) & 0xFF;
+    }
+    return p;
+}
+
+uint64_t getLittleEndian(const uint8_t **p, int bytes) {
+    uint64_t value = 0;
+    for(int i = 0; i < bytes; i++) {
+        value |= (uint64_t) *(*p)++ << (i * 8);
+    }
+    return value;
+}
+
+void writeLittleEndian(FILE *file, uint64_t value, int bytes) {
+    uint8_t buffer[8];
+    fwrite(buffer, 1, putLittleEndian(buffer, value, bytes) - buffer, file);
+}
+
+bool readLittleEndian(FILE *file, uint64_t *value, int bytes) {
+    *value = 0;
+    for(int i = 0; i < bytes; i++) {
+        int c = fgetc(file);
+        if(c == EOF) {
+            return false;
+        }
+        *value |= (uint64_t) c << (i * 8);
+    }
+    return true;
+}
+
+// VARINTS =====================================================================
+uint8_t *putVarint(uint8_t *p, uint64_t value) {
+    while(value >= 0x80) {
+        *p++ = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    *p++ = value;
+    return p;
+}
+
+uint64_t getVarint(const uint8_t **p) {
+    uint64_t value = 0;
+    int shift = 0;
+    while(**p & 0x80) {
+        value |= (uint64_t) (*(*p)++ & 0x7F) << shift;
+        shift += 7;
+    }
+    value |= (uint64_t) *(*p)++ << shift;
+    return value;
+}
+
+void writeVarint(FILE *file, uint64_t value) {
+    uint8_t buffer[VARINT_MAX_BYTES];
+    fwrite(buffer, 1, putVarint(buffer, value) - buffer, file);
+}
+
+bool readVarint(FILE *file, uint64_t *value) {
+    *value = 0;
+    for(int shift = 0; shift <= 63; shift += 7) {
+        int c = fgetc(file);
+        if(c == EOF) {
+            return false;
+        }
+        *value |= (uint64_t) (c & 0x7F) << shift;
+        if(!(c & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#endif // BYTES_C_INCLUDE
@@ -0,0 +1,28 @@
+#ifndef BYTES_H_INCLUDE
+#define BYTES_H_INCLUDE
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Every file and buffer format here stores fixed-size fields little-endian, and counts as LEB128 varints:
+// seven bits a byte, low bits first, with the top bit set on every byte but the last
+// put and get work on memory, write and read on a file
+
+// A varint of up to 64 bits takes at most this many bytes
+#define VARINT_MAX_BYTES 10
+
+uint8_t *putLittleEndian(uint8_t *p, uint64_t value, int bytes);
+uint64_t getLittleEndian(const uint8_t **p, int bytes);
+void writeLittleEndian(FILE *file, uint64_t value, int bytes);
+// Returns false when the file ends first
+bool readLittleEndian(FILE *file, uint64_t *value, int bytes);
+
+uint8_t *putVarint(uint8_t *p, uint64_t value);
+// Unchecked, only for buffers the emulator wrote itself
+uint64_t getVarint(const uint8_t **p);
+void writeVarint(FILE *file, uint64_t value);
+// Returns false when the file ends first or the varint runs past 64 bits
+bool readVarint(FILE *file, uint64_t *value);
+
+#endif // BYTES_H_INCLUDE
@@ -0,0 +1,364 @@
+#ifndef CAPTURE_C_INCLUDE
+#define CAPTURE_C_INCLUDE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "Chip8.c"
+#include "Bytes.c"
+#include "Capture.h"
+
+static const uint8_t captureMagic[4] = {'C', '8', 'C', 'V'};
+
+// Bytes a screen takes in a frame record
+#define CAPTURE_LORES_BYTES (32 * 8)
+#define CAPTURE_HIRES_BYTES (64 * 16)
+
+// WRITER THREAD ===============================================================
+static void *runCaptureWriter(void *arg) {
+    captureWriter *w = arg;
+    pthread_mutex_lock(&w->lock);
+    for(;;) {
+        while(!w->head && !w->stopping) {
+            pthread_cond_wait(&w->ready, &w->lock);
+        }
+        captureBlock *block = w->head;
+        if(!block) {
+            break;
+        }
+        w->head = block->next;
+        if(!w->head) {
+            w->tail = NULL;
+        }
+        pthread_mutex_unlock(&w->lock);
+
+        // The only place a capture touches the disk
+        fwrite(block->data, 1, block->used, block->file);
+        bool failed = false;
+        if(block->last) {
+            failed = ferror(block->file) != 0;
+            failed |= fclose(block->file) != 0;
+        }
+
+        pthread_mutex_lock(&w->lock);
+        w->queued -= block->used;
+        w->errors += failed;
+        free(block);
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+int startCaptureWriter(captureWriter *w) {
+    w->head = NULL;
+    w->tail = NULL;
+    w->queued = 0;
+    w->stopping = false;
+    w->errors = 0;
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->ready, NULL);
+    if(pthread_create(&w->thread, NULL, runCaptureWriter, w) != 0) {
+        printf("Could not start the capture writer\n");
+        return -1;
+    }
+    return 0;
+}
+
+void stopCaptureWriter(captureWriter *w) {
+    pthread_mutex_lock(&w->lock);
+    w->stopping = true;
+    pthread_cond_signal(&w->ready);
+    pthread_mutex_unlock(&w->lock);
+    pthread_join(w->thread, NULL);
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->ready);
+}
+
+// Queues a block for writing. Unless forced, a full queue turns it away and the capture keeps it
+static bool submitBlock(captureWriter *w, captureBlock *block, bool force) {
+    pthread_mutex_lock(&w->lock);
+    if(!force && w->queued + block->used > CAPTURE_QUEUE_LIMIT) {
+        pthread_mutex_unlock(&w->lock);
+        return false;
+    }
+    block->next = NULL;
+    if(w->tail) {
+        w->tail->next = block;
+    } else {
+        w->head = block;
+    }
+    w->tail = block;
+    w->queued += block->used;
+    pthread_cond_signal(&w->ready);
+    pthread_mutex_unlock(&w->lock);
+    return true;
+}
+
+static captureBlock *newBlock(FILE *file) {
+    captureBlock *block = malloc(sizeof(captureBlock));
+    if(block) {
+        block->file = file;
+        block->last = false;
+        block->used = 0;
+    }
+    return block;
+}
+
+// Makes room for bytes more in the current block, handing the full one to the writer first if it has to
+static bool reserveBlock(capture *c, size_t bytes, bool force) {
+    if(c->block->used + bytes <= CAPTURE_BLOCK_SIZE) {
+        return true;
+    }
+    captureBlock *next = newBlock(c->file);
+    if(!next) {
+        return false;
+    }
+    if(!submitBlock(c->writer, c->block, force)) {
+        free(next);
+        return false;
+    }
+    c->block = next;
+    return true;
+}
+
+// ENCODING ====================================================================
+// Splits a row word into bytes, leftmost pixels first
+static uint8_t *putRow(uint8_t *p, uint64_t row) {
+    for(int shift = 56; shift >= 0; shift -= 8) {
+        *p++ = (row >> shift) & 0xFF;
+    }
+    return p;
+}
+
+// Zero runs shorter than this are cheaper inside a literal run than as a pair of their own
+#define CAPTURE_MIN_ZERO_RUN 3
+
+static size_t encodeFrame(capture *c, const chip8 *c8, uint64_t frame, bool key, uint8_t *out) {
+    uint8_t delta[CAPTURE_HIRES_BYTES];
+    uint8_t *p = delta;
+    if(c8->hiresMode) {
+        for(int y = 0; y < 64; y++) {
+            for(int half = 0; half < 2; half++) {
+                p = putRow(p, c8->hiresScreen[half][y] ^ (key ? 0 : c->hiresScreen[half][y]));
+            }
+        }
+    } else {
+        for(int y = 0; y < 32; y++) {
+            p = putRow(p, c8->screen[y] ^ (key ? 0 : c->screen[y]));
+        }
+    }
+    const size_t size = p - delta;
+
+    uint8_t *q = out;
+    *q++ = (key ? 0x02 : 0x00) | (c8->hiresMode ? 0x01 : 0x00);
+    q = putVarint(q, frame - c->lastFrame);
+    size_t i = 0;
+    while(i < size) {
+        size_t zeros = 0;
+        while(i + zeros < size && delta[i + zeros] == 0) {
+            zeros++;
+        }
+        i += zeros;
+        size_t start = i;
+        while(i < size) {
+            size_t run = 0;
+            while(i + run < size && run < CAPTURE_MIN_ZERO_RUN && delta[i + run] == 0) {
+                run++;
+            }
+            // A long enough zero run, or zeros reaching the end, start the next pair
+            if(run == CAPTURE_MIN_ZERO_RUN || (run > 0 && i + run == size)) {
+                break;
+            }
+            i += run > 0 ? run : 1;
+        }
+        q = putVarint(q, zeros);
+        q = putVarint(q, i - start);
+        memcpy(q, &delta[start], i - start);
+        q += i - start;
+    }
+    return q - out;
+}
+
+// Encodes the frame unless it's the same as the last one, and keeps it as what the decoder will have
+static void storeFrame(capture *c, const chip8 *c8, bool force) {
+    uint64_t frame = c8->cycleCount / c8->cyclesPerFrame;
+    bool key = c->keyNext || c8->hiresMode != c->hiresMode;
+    if(!key) {
+        bool changed = false;
+        if(c8->hiresMode) {
+            changed = memcmp(c8->hiresScreen, c->hiresScreen, sizeof(c->hiresScreen)) != 0;
+        } else {
+            changed = memcmp(c8->screen, c->screen, sizeof(c->screen)) != 0;
+        }
+        if(!changed) {
+            return;
+        }
+    }
+
+    uint8_t record[CAPTURE_MAX_RECORD];
+    size_t size = encodeFrame(c, c8, frame, key, record);
+    if(!reserveBlock(c, size, force)) {
+        // The decoder won't have this frame, so the next one can't be a delta against it
+        c->dropped++;
+        c->keyNext = true;
+        return;
+    }
+    memcpy(&c->block->data[c->block->used], record, size);
+    c->block->used += size;
+    c->lastFrame = frame;
+    c->keyNext = false;
+    c->hiresMode = c8->hiresMode;
+    memcpy(c->screen, c8->screen, sizeof(c->screen));
+    memcpy(c->hiresScreen, c8->hiresScreen, sizeof(c->hiresScreen));
+    c->stored++;
+}
+
+int startCapture(capture *c, captureWriter *w, const char *filename, const chip8 *c8) {
+    c->file = fopen(filename, "wb");
+    if(!c->file) {
+        printf("Could not open %s for writing\n", filename);
+        return -1;
+    }
+    c->block = newBlock(c->file);
+    if(!c->block) {
+        fclose(c->file);
+        return -1;
+    }
+    c->writer = w;
+    c->lastFrame = c8->cycleCount / c8->cyclesPerFrame;
+    c->keyNext = true;
+    c->hiresMode = false;
+    memset(c->screen, 0, sizeof(c->screen));
+    memset(c->hiresScreen, 0, sizeof(c->hiresScreen));
+    c->stored = 0;
+    c->dropped = 0;
+
+    uint8_t *p = c->block->data;
+    memcpy(p, captureMagic, 4);
+    p += 4;
+    p = putLittleEndian(p, CAPTURE_VERSION, 4);
+    p = putLittleEndian(p, c8->randomSeed, 8);
+    p = putLittleEndian(p, c8->cyclesPerFrame, 4);
+    c->block->used = p - c->block->data;
+    return 0;
+}
+
+void captureFrame(capture *c, const chip8 *c8) {
+    storeFrame(c, c8, false);
+}
+
+void stopCapture(capture *c, const chip8 *c8) {
+    // Nothing after this can be dropped, the writer takes whatever is left however far behind it is
+    storeFrame(c, c8, true);
+    uint8_t record[1 + VARINT_MAX_BYTES];
+    uint8_t *p = record;
+    *p++ = 0x10;
+    p = putVarint(p, c8->cycleCount / c8->cyclesPerFrame - c->lastFrame);
+    if(reserveBlock(c, p - record, true)) {
+        memcpy(&c->block->data[c->block->used], record, p - record);
+        c->block->used += p - record;
+    } else {
+        // Out of memory for a new block, the file still has to close, it just ends without its end record
+        c->dropped++;
+        pthread_mutex_lock(&c->writer->lock);
+        c->writer->errors++;
+        pthread_mutex_unlock(&c->writer->lock);
+    }
+    c->block->last = true;
+    submitBlock(c->writer, c->block, true);
+    c->block = NULL;
+    c->file = NULL;
+}
+
+// DECODING ====================================================================
+int openCapture(captureReader *r, const char *filename) {
+    r->file = fopen(filename, "rb");
+    if(!r->file) {
+        printf("Could not open %s\n", filename);
+        return -1;
+    }
+
+    uint8_t magic[4];
+    uint64_t version, seed, cyclesPerFrame;
+    if(fread(magic, 1, 4, r->file) != 4 || memcmp(magic, captureMagic, 4) != 0 ||
+       !readLittleEndian(r->file, &version, 4) || version != CAPTURE_VERSION ||
+       !readLittleEndian(r->file, &seed, 8) ||
+       !readLittleEndian(r->file, &cyclesPerFrame, 4) || cyclesPerFrame == 0) {
+        printf("%s is not a capture of version %d\n", filename, CAPTURE_VERSION);
+        fclose(r->file);
+        r->file = NULL;
+        return -1;
+    }
+
+    r->seed = seed;
+    r->cyclesPerFrame = cyclesPerFrame;
+    r->frame = 0;
+    r->hiresMode = false;
+    memset(r->screen, 0, sizeof(r->screen));
+    memset(r->hiresScreen, 0, sizeof(r->hiresScreen));
+    return 0;
+}
+
+int readCaptureFrame(captureReader *r) {
+    int type = fgetc(r->file);
+    uint64_t frames;
+    if(type == EOF || !readVarint(r->file, &frames)) {
+        return -1;
+    }
+    r->frame += frames;
+    if(type == 0x10) {
+        return 0;
+    }
+    if(type > 0x03) {
+        return -1;
+    }
+
+    bool hires = type & 0x01;
+    bool key = type & 0x02;
+    if(hires != r->hiresMode && !key) {
+        return -1;
+    }
+    if(key) {
+        memset(r->screen, 0, sizeof(r->screen));
+        memset(r->hiresScreen, 0, sizeof(r->hiresScreen));
+    }
+    r->hiresMode = hires;
+
+    // Byte i of the delta is row i / bytesPerRow, and within the row, byte i % bytesPerRow from the left
+    const size_t size = hires ? CAPTURE_HIRES_BYTES : CAPTURE_LORES_BYTES;
+    size_t i = 0;
+    while(i < size) {
+        uint64_t zeros, literals;
+        if(!readVarint(r->file, &zeros) || !readVarint(r->file, &literals) ||
+           zeros > size - i || literals > size - i - zeros) {
+            return -1;
+        }
+        i += zeros;
+        for(uint64_t n = 0; n < literals; n++, i++) {
+            int byte = fgetc(r->file);
+            if(byte == EOF) {
+                return -1;
+            }
+            uint64_t bits = (uint64_t) byte << (56 - (i % 8) * 8);
+            if(hires) {
+                r->hiresScreen[(i / 8) % 2][i / 16] ^= bits;
+            } else {
+                r->screen[i / 8] ^= bits;
+            }
+        }
+    }
+    return 1;
+}
+
+void closeCapture(captureReader *r) {
+    if(r->file) {
+        fclose(r->file);
+        r->file = NULL;
+    }
+}
+
+#endif // CAPTURE_C_INCLUDE
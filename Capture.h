@@ -0,0 +1,102 @@
+#ifndef CAPTURE_H_INCLUDE
+#define CAPTURE_H_INCLUDE
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "Chip8.h"
+
+// Bump whenever the layout below changes. Older captures are rejected rather than guessed at
+#define CAPTURE_VERSION 1
+
+// Encoded frames are handed to the writer in blocks of this many bytes
+#define CAPTURE_BLOCK_SIZE (64 * 1024)
+
+// Bytes the writer may have queued across every capture. Past this, captures hold on to their block and then start
+// dropping frames, so emulation never waits for the disk
+#define CAPTURE_QUEUE_LIMIT (16 * 1024 * 1024)
+
+// The largest frame record: type, a frame count, and a 128x64 delta at its worst, every other byte changed
+#define CAPTURE_MAX_RECORD (1 + 10 + 1024 * 2 + 20)
+
+// A capture is a screen per emulated frame, stored as the XOR against the screen before it so a frame where a few
+// sprites moved costs a few bytes, and an unchanged frame costs nothing. Everything is little-endian
+// Header: magic "C8CV", version (4), seed (8), cyclesPerFrame (4)
+// Then records, each a type byte and the frames since the previous record as a LEB128 varint:
+//   0x0M frame, M bit 0 set for 128x64. M bit 1 set for a key frame, XORed against a blank screen instead of the
+//        previous frame. Rows are top to bottom, left to right, 8 pixels a byte, most significant bit leftmost
+//        The delta follows as pairs of varints, a count of zero bytes then a count of literal bytes and the bytes
+//        themselves, until the screen is covered
+//   0x10 end, no payload. Always the last record, its frame is the last one captured
+// A mode switch or a dropped frame is always followed by a key frame, so a decoder never has to guess
+typedef struct captureBlock {
+    struct captureBlock *next;
+    FILE *file;
+    bool last; // Closes the file once written
+    size_t used;
+    uint8_t data[CAPTURE_BLOCK_SIZE];
+} captureBlock;
+
+// One background thread writing blocks for any number of captures, in the order they were queued
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    captureBlock *head, *tail;
+    size_t queued;     // Bytes in the queue
+    bool stopping;
+    unsigned int errors; // Files that couldn't be written whole or closed
+} captureWriter;
+
+typedef struct {
+    captureWriter *writer;
+    FILE *file;
+    captureBlock *block;   // Being filled. Only ever touched by the thread running the machine
+    uint64_t lastFrame;    // Frame of the latest record
+    bool keyNext;          // The next frame can't be XORed against what the decoder has
+    bool hiresMode;        // Previous frame, as the decoder will have it
+    uint64_t screen[32];
+    uint64_t hiresScreen[2][64];
+    uint64_t stored, dropped; // Frames written and frames lost, a lost end record counts as one too
+} capture;
+
+// Returns -1 when the thread can't be started
+int startCaptureWriter(captureWriter *w);
+
+// Writes everything still queued, then joins the thread. Captures must be stopped first
+void stopCaptureWriter(captureWriter *w);
+
+// Call with a freshly initialized machine. Returns -1 when the file can't be opened
+int startCapture(capture *c, captureWriter *w, const char *filename, const chip8 *c8);
+
+// Call once the machine has finished a frame. A frame that's the same as the one before costs nothing
+// When the writer is too far behind, the frame is counted in dropped instead
+void captureFrame(capture *c, const chip8 *c8);
+
+// Captures the final screen, ends the stream and hands the rest to the writer, which closes the file
+void stopCapture(capture *c, const chip8 *c8);
+
+// DECODING ====================================================================
+typedef struct {
+    FILE *file;
+    uint64_t seed;
+    uint32_t cyclesPerFrame;
+    uint64_t frame;        // Frame of the latest record
+    bool hiresMode;        // The screen as of frame
+    uint64_t screen[32];
+    uint64_t hiresScreen[2][64];
+} captureReader;
+
+// Returns -1 when the file can't be read or isn't a capture of this version
+int openCapture(captureReader *r, const char *filename);
+
+// Returns 1 with the screen of the next stored frame, 0 at the end record, -1 when the file is cut short or malformed
+// Frames between records are the same as the one before them
+int readCaptureFrame(captureReader *r);
+
+void closeCapture(captureReader *r);
+
+#endif // CAPTURE_H_INCLUDE
@@ -0,0 +1,258 @@
+// Capture decoder
+// Turns a capture written by `batch --capture` into a PNG per stored frame or a y4m video at 60 frames a second
+// Build with: gcc -O2 -pthread CaptureTool.c -o capturetool
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Capture.c"
+
+// Every frame is scaled to the 128x64 grid so a ROM switching modes keeps one size, lores pixels are doubled
+#define FRAME_WIDTH 128
+#define FRAME_HEIGHT 64
+
+// Grayscale image of the reader's screen, one byte a pixel
+void renderFrame(const captureReader *r, int scale, uint8_t *image) {
+    const int width = FRAME_WIDTH * scale;
+    for(int y = 0; y < FRAME_HEIGHT * scale; y++) {
+        for(int x = 0; x < width; x++) {
+            int px = x / scale, py = y / scale;
+            bool on;
+            if(r->hiresMode) {
+                on = (r->hiresScreen[px / 64][py] >> (63 - px % 64)) & 1;
+            } else {
+                on = (r->screen[py / 2] >> (63 - px / 2)) & 1;
+            }
+            image[y * width + x] = on ? 0xFF : 0x00;
+        }
+    }
+}
+
+// PNG =========================================================================
+// Written with stored deflate blocks, so no zlib. The frames are small and a converter can always recompress them
+static uint32_t crcTable[256];
+
+void initCrcTable() {
+    for(uint32_t n = 0; n < 256; n++) {
+        uint32_t c = n;
+        for(int k = 0; k < 8; k++) {
+            c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+        }
+        crcTable[n] = c;
+    }
+}
+
+uint32_t updateCrc(uint32_t crc, const uint8_t *data, size_t size) {
+    for(size_t i = 0; i < size; i++) {
+        crc = crcTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+void putBigEndian(uint8_t *p, uint32_t value) {
+    p[0] = value >> 24;
+    p[1] = value >> 16;
+    p[2] = value >> 8;
+    p[3] = value;
+}
+
+void writeChunk(FILE *file, const char *type, const uint8_t *data, uint32_t size) {
+    uint8_t word[4];
+    putBigEndian(word, size);
+    fwrite(word, 1, 4, file);
+    fwrite(type, 1, 4, file);
+    fwrite(data, 1, size, file);
+    uint32_t crc = updateCrc(0xFFFFFFFF, (const uint8_t *) type, 4);
+    crc = updateCrc(crc, data, size) ^ 0xFFFFFFFF;
+    putBigEndian(word, crc);
+    fwrite(word, 1, 4, file);
+}
+
+int writePng(const char *filename, const uint8_t *image, int width, int height) {
+    FILE *file = fopen(filename, "wb");
+    if(!file) {
+        printf("Could not open %s for writing\n", filename);
+        return -1;
+    }
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    fwrite(signature, 1, 8, file);
+
+    // 8-bit grayscale, no interlacing
+    uint8_t header[13] = {0};
+    putBigEndian(header, width);
+    putBigEndian(header + 4, height);
+    header[8] = 8;
+    writeChunk(file, "IHDR", header, sizeof(header));
+
+    // Each row is a filter byte of 0 and the pixels. Stored blocks hold up to 65535 bytes each
+    size_t raw = (size_t) (width + 1) * height;
+    size_t blocks = raw / 65535 + 1;
+    uint8_t *data = malloc(2 + raw + blocks * 5 + 4);
+    uint8_t *p = data;
+    *p++ = 0x78;
+    *p++ = 0x01;
+    uint32_t a = 1, b = 0;
+    size_t row = 0, column = 0;
+    size_t left = raw;
+    do {
+        size_t size = left < 65535 ? left : 65535;
+        *p++ = size == left ? 1 : 0;
+        *p++ = size & 0xFF;
+        *p++ = size >> 8;
+        *p++ = ~size & 0xFF;
+        *p++ = (~size >> 8) & 0xFF;
+        for(size_t i = 0; i < size; i++) {
+            uint8_t byte = column == 0 ? 0 : image[row * width + column - 1];
+            if(++column > (size_t) width) {
+                column = 0;
+                row++;
+            }
+            *p++ = byte;
+            a = (a + byte) % 65521;
+            b = (b + a) % 65521;
+        }
+        left -= size;
+    } while(left > 0);
+    putBigEndian(p, (b << 16) | a);
+    p += 4;
+    writeChunk(file, "IDAT", data, p - data);
+    writeChunk(file, "IEND", NULL, 0);
+    free(data);
+
+    bool failed = ferror(file);
+    if(fclose(file) != 0 || failed) {
+        printf("Could not write %s\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+// Y4M =========================================================================
+// 4:2:0 with neutral chroma, which every player and encoder takes
+void writeY4mHeader(FILE *file, int width, int height) {
+    fprintf(file, "YUV4MPEG2 W%d H%d F60:1 Ip A1:1 C420jpeg\n", width, height);
+}
+
+void writeY4mFrame(FILE *file, const uint8_t *image, int width, int height) {
+    fputs("FRAME\n", file);
+    for(int i = 0; i < width * height; i++) {
+        // Studio range luma, black 16 and white 235
+        fputc(image[i] ? 235 : 16, file);
+    }
+    for(int i = 0; i < 2 * ((width + 1) / 2) * ((height + 1) / 2); i++) {
+        fputc(128, file);
+    }
+}
+
+void printUsage() {
+    printf("Usage: capturetool [options] <capture>\n");
+    printf("  --png <dir>       Write each stored frame to <dir>/frame-<number>.png\n");
+    printf("  --y4m <file>      Write every frame to a 60 fps y4m video, - for stdout\n");
+    printf("  --scale <n>       Output pixels per 128x64 pixel (default 4)\n");
+    printf("With neither, prints the header and frame counts\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *pngDir = NULL;
+    const char *y4mName = NULL;
+    const char *captureName = NULL;
+    int scale = 4;
+
+    for(int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if(strcmp(argv[i], "--png") == 0 && hasValue) {
+            pngDir = argv[++i];
+        } else if(strcmp(argv[i], "--y4m") == 0 && hasValue) {
+            y4mName = argv[++i];
+        } else if(strcmp(argv[i], "--scale") == 0 && hasValue) {
+            scale = strtol(argv[++i], NULL, 0);
+        } else if(!captureName && argv[i][0] != '-') {
+            captureName = argv[i];
+        } else {
+            printUsage();
+            return -1;
+        }
+    }
+    if(!captureName || scale < 1 || scale > 16) {
+        printUsage();
+        return -1;
+    }
+
+    captureReader r;
+    if(openCapture(&r, captureName) != 0) {
+        return -1;
+    }
+    FILE *y4m = NULL;
+    if(y4mName) {
+        y4m = strcmp(y4mName, "-") == 0 ? stdout : fopen(y4mName, "wb");
+        if(!y4m) {
+            printf("Could not open %s for writing\n", y4mName);
+            closeCapture(&r);
+            return -1;
+        }
+    }
+    initCrcTable();
+
+    // DECODE ==================================================================
+    // The y4m gets a frame for every emulated frame, repeating the screen between records, so it plays in real time
+    const int width = FRAME_WIDTH * scale, height = FRAME_HEIGHT * scale;
+    uint8_t *image = malloc((size_t) width * height);
+    uint64_t stored = 0, written = 0, videoFrames = 0, shown = 0;
+    bool started = false, failed = false;
+    int result;
+    while((result = readCaptureFrame(&r)) != -1) {
+        if(started && y4m) {
+            // Everything up to the new record still shows the previous screen
+            for(; shown < r.frame; shown++, videoFrames++) {
+                writeY4mFrame(y4m, image, width, height);
+            }
+        }
+        if(result == 0) {
+            break;
+        }
+        if(!started && y4m) {
+            writeY4mHeader(y4m, width, height);
+            shown = r.frame;
+        }
+        started = true;
+        stored++;
+        renderFrame(&r, scale, image);
+
+        if(pngDir) {
+            char name[4096];
+            snprintf(name, sizeof(name), "%s/frame-%06llu.png", pngDir, (unsigned long long) r.frame);
+            if(writePng(name, image, width, height) != 0) {
+                failed = true;
+                break;
+            }
+            written++;
+        }
+    }
+    if(started && y4m) {
+        // The end record's frame was shown too
+        writeY4mFrame(y4m, image, width, height);
+        videoFrames++;
+    }
+    if(result == -1) {
+        printf("%s is cut short or malformed, stopped at frame %llu\n", captureName, (unsigned long long) r.frame);
+    }
+    closeCapture(&r);
+    free(image);
+    if(y4m && y4m != stdout && fclose(y4m) != 0) {
+        printf("Could not write %s\n", y4mName);
+        failed = true;
+    }
+
+    FILE *report = y4m == stdout ? stderr : stdout;
+    fprintf(report, "Seed %llu, %u cycles per frame, %llu frames with %llu stored\n", (unsigned long long) r.seed,
+            r.cyclesPerFrame, (unsigned long long) r.frame, (unsigned long long) stored);
+    if(pngDir) {
+        fprintf(report, "Wrote %llu PNGs to %s\n", (unsigned long long) written, pngDir);
+    }
+    if(y4m) {
+        fprintf(report, "Wrote %llu frames to %s\n", (unsigned long long) videoFrames, y4mName);
+    }
+    return result == -1 || failed ? -1 : 0;
+}
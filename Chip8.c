@@ -3,11 +3,17 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <time.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "Chip8.h"
+#include "Audio.c"
+#include "Events.c"
+#include "Profile.h"
+#include "Trace.h"
+#include "Debugger.h"
+#include "Disasm.c"
 
 // Characters are 4 pixels wide and 5 tall
 // The top nibble of the byte is used to set the pixels displayed for the character
@@ -39,7 +45,56 @@ const uint8_t font[16 * 5] =
     0xF0, 0x80, 0xF0, 0x80, 0x80  // F
 };
 
-int initialize(chip8 *c8, char *filename, bool modernCompat) {
+// SUPER-CHIP's large digits, 8 pixels wide and 10 tall, for the score displays of 128x64 games
+// SUPER-CHIP itself only had 0-9, A-F are the ones later interpreters added
+const uint8_t bigFont[16 * 10] =
+{
+    0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, // 0
+    0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, // 1
+    0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // 2
+    0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 3
+    0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, // 4
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 5
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 6
+    0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, // 7
+    0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 8
+    0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 9
+    0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+    0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+    0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+    0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  // F
+};
+
+// QUIRKS ======================================================================
+#define QUIRK_PROFILE_NAME(profile, name, ...) [profile] = name,
+const char *quirkProfileNames[QUIRK_PROFILE_COUNT] = {
+    QUIRK_PROFILES(QUIRK_PROFILE_NAME)
+};
+#undef QUIRK_PROFILE_NAME
+
+#define QUIRK_PROFILE_QUIRKS(profile, name, ...) [profile] = {__VA_ARGS__},
+const chip8Quirks quirkProfiles[QUIRK_PROFILE_COUNT] = {
+    QUIRK_PROFILES(QUIRK_PROFILE_QUIRKS)
+};
+#undef QUIRK_PROFILE_QUIRKS
+
+int findQuirkProfile(const char *name) {
+    for(int i = 0; i < QUIRK_PROFILE_COUNT; i++) {
+        if(strcmp(name, quirkProfileNames[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int initializeFromMemory(chip8 *c8, const uint8_t *rom, size_t size, quirkProfile quirks, uint64_t seed) {
+    if(size > MAX_ROM_SIZE) {
+        printf("ROM too large or invalid file type\n");
+        return -1;
+    }
+
     // The program starts at location 512 aka 0x200, anything before that is reserved
     c8->programCounter = 0x200;
     c8->I              = 0;
@@ -49,57 +104,152 @@ int initialize(chip8 *c8, char *filename, bool modernCompat) {
     c8->delayTimer     = 0;
     c8->soundTimer     = 0;
     c8->keyWait        = false;
+    c8->displayWait    = false;
     c8->awaitingRedraw = false;
-    c8->modernCompat   = modernCompat;
-    clock_gettime(CLOCK_REALTIME, &(c8->previousDelayTimerTick));
-    clock_gettime(CLOCK_REALTIME, &(c8->previousSoundTimerTick));
+    c8->hiresMode      = false;
+    c8->quirks         = quirks;
+    c8->events         = NULL;
+    c8->audio          = NULL;
+    c8->debugger       = NULL;
+    c8->cycleCount     = 0;
+    c8->cyclesPerFrame = DEFAULT_CYCLES_PER_FRAME;
+    c8->frameCycle     = 0;
+    c8->idleSkip       = true;
+    c8->idleCheckAt    = 0;
+    c8->idleInterval   = IDLE_MIN_INTERVAL;
+#ifdef CHIP8_PROFILE
+    c8->profile        = NULL;
+#endif
+#ifdef CHIP8_TRACE
+    c8->trace          = NULL;
+#endif
+    seedRandom(c8, seed);
 
     // Clear things
-    for(int i = 0; i < 64 * 32; i++) {
-        c8->screen[i] = 0;
-    }
-    for(int i = 0; i < 16; i++) {
-        c8->V[i] = 0;
-        c8->stack[i] = 0;
-        c8->keys[i] = 0;
-    }
-    for(int i = 0; i < 4096; i++) {
-        c8->memory[i]  = 0;
-    }
+    memset(c8->screen, 0, sizeof(c8->screen));
+    memset(c8->hiresScreen, 0, sizeof(c8->hiresScreen));
+    memset(c8->rplFlags, 0, sizeof(c8->rplFlags));
+    memset(c8->V, 0, sizeof(c8->V));
+    memset(c8->stack, 0, sizeof(c8->stack));
+    memset(c8->keys, 0, sizeof(c8->keys));
+    memset(c8->memory, 0, sizeof(c8->memory));
 
-    // Load the font from the font array into reserved memory
-    for(int i = 0; i < 16 * 5; i++) {
-        c8->memory[i] = font[i];
+    // Load the fonts into reserved memory and the program after them
+    memcpy(c8->memory, font, sizeof(font));
+    memcpy(&c8->memory[BIG_FONT_ADDRESS], bigFont, sizeof(bigFont));
+    if(size > 0) {
+        memcpy(&c8->memory[0x200], rom, size);
     }
+    return 0;
+}
 
-    // Read the program from the file into memory
+int initialize(chip8 *c8, char *filename, quirkProfile quirks, uint64_t seed) {
     FILE *file = fopen(filename, "rb");
     if(!file) {
         printf("Could not find ROM\n");
         return -1;
     }
 
-    // 0x0200 == 512 This is the memory location where the program starts
-    int counter = 0x0200;
-    while(!feof(file)) {
-        if(counter >= 4096) {
-            printf("ROM too large or invalid file type\n");
-            return -1;
-        }
-        fread(&c8->memory[counter], 1, 1, file);
-        counter++;
+    // One byte more than fits, so a ROM that's too large can be told apart from one that exactly fills memory
+    uint8_t rom[MAX_ROM_SIZE + 1];
+    size_t size = fread(rom, 1, sizeof(rom), file);
+    fclose(file);
+    return initializeFromMemory(c8, rom, size, quirks, seed);
+}
+
+// RANDOM NUMBERS ==============================================================
+// Each machine has its own xorshift64* generator, so threads never share one and a seed always replays the same way
+void seedRandom(chip8 *c8, uint64_t seed) {
+    // One round of splitmix64 so neighbouring seeds (1, 2, 3...) start far apart, and no seed gives the stuck zero state
+    uint64_t z = seed + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    c8->randomSeed = seed;
+    c8->randomState = z ? z : 1;
+}
+
+uint8_t nextRandom(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    // The top bits of the multiplied state are the best mixed
+    return (x * 0x2545F4914F6CDD1DULL) >> 56;
+}
+
+// Timers tick once every cyclesPerFrame cycles, which keeps runs deterministic and lets headless runs fast-forward
+static void endCycle(chip8 *c8) {
+    c8->cycleCount++;
+    c8->frameCycle++;
+    if(c8->frameCycle >= c8->cyclesPerFrame) {
+        c8->frameCycle = 0;
+        tickTimers(c8);
+        PROFILE(c8, profileFrame);
     }
+}
 
-    fclose(file);
-    return 0;
+// Hands an event to whoever is listening on c8->events
+static void report(chip8 *c8, chip8Status status) {
+    if(c8->events) {
+        chip8Event event = {status, c8->programCounter, c8->opcode, c8->I, c8->stackPointer, c8->cycleCount};
+        pushEvent(c8->events, &event);
+    }
 }
 
-int emulateCycle(chip8 *c8) {
-    if(c8->programCounter >= 4096) {
-        return -1;
+// Tells the player how long the tone just set by FX18 lasts. The timer ticks once the cycle that fills the frame is
+// done, so it reaches zero soundTimer ticks from now, the first of them cyclesPerFrame - frameCycle cycles away
+static void queueTone(chip8 *c8) {
+    audioEdge edge = {c8->cycleCount, c8->cycleCount};
+    if(c8->soundTimer > 0) {
+        edge.endCycle += (c8->cyclesPerFrame - c8->frameCycle) + (uint64_t) (c8->soundTimer - 1) * c8->cyclesPerFrame;
+    }
+    pushAudioEdge(c8->audio, &edge);
+}
+
+// Where FX55 and FX65 leave I
+static inline __attribute__((always_inline)) void advanceI(chip8 *c8, const chip8Quirks q) {
+    switch(q.memory) {
+        case MEMORY_I_PLUS_X_PLUS_1:
+            c8->I += ((c8->opcode & 0x0F00) >> 8) + 1;
+            break;
+        case MEMORY_I_PLUS_X:
+            c8->I += (c8->opcode & 0x0F00) >> 8;
+            break;
+        case MEMORY_I_UNCHANGED:
+            break;
+    }
+}
+
+// Reports a fault and stops before the instruction changes anything
+static chip8Status fault(chip8 *c8, chip8Status status) {
+    report(c8, status);
+    return status;
+}
+
+// The interpreter proper. Always inlined into the per-profile functions below with q a constant, so every quirk test
+// is decided at compile time and none of them is left in the loops
+static inline __attribute__((always_inline)) chip8Status executeCycle(chip8 *c8, const chip8Quirks q) {
+    if(c8->keyWait) {
+        // Halted on FX0A, the cycle passes without running anything
+        PROFILE(c8, profileKeyWait);
+        endCycle(c8);
+        return CHIP8_OK;
+    }
+    if(q.displayWait && c8->displayWait) {
+        // Halted after DXYN until the tick at the end of this frame, which clears the wait
+        endCycle(c8);
+        return CHIP8_OK;
+    }
+    if(c8->programCounter >= 4095) {
+        // At 4095 the second half of the opcode would be past the end of memory
+        return fault(c8, CHIP8_PC_OUT_OF_BOUNDS);
     }
     // CHIP-8 is big-endian so memory[pc] is the "left" half of the opcode
     c8->opcode = (c8->memory[c8->programCounter] << 8) | c8->memory[c8->programCounter + 1];
+    PROFILE_INSTRUCTION(c8);
+    TRACE_FETCH(c8);
 
     // Switch on the leftmost nibble of the opcode
     switch(c8->opcode & 0xF000) {
@@ -107,20 +257,62 @@ int emulateCycle(chip8 *c8) {
             switch(c8->opcode & 0x00FF) {
                 case 0x00E0:
                     // 00E0: Clear the screen
-                    for(int i = 0; i < 64 * 32; i++) {
-                        c8->screen[i] = 0;
+                    if(c8->hiresMode) {
+                        memset(c8->hiresScreen, 0, sizeof(c8->hiresScreen));
+                    } else {
+                        memset(c8->screen, 0, sizeof(c8->screen));
                     }
                     c8->awaitingRedraw = true;
                     break;
 
                 case 0x00EE:
                     // 00EE: Return from a subroutine
+                    if(c8->stackPointer == 0) {
+                        return fault(c8, CHIP8_STACK_UNDERFLOW);
+                    }
+                    if(c8->stackPointer > 24) {
+                        return fault(c8, CHIP8_STACK_OVERFLOW);
+                    }
                     c8->stackPointer--;
                     c8->programCounter = c8->stack[c8->stackPointer];
                     break;
 
+                // SUPER-CHIP. Scrolls are by pixels of the current mode, like later interpreters rather than
+                // the original, which always scrolled by 128x64 pixels
+                case 0x00FB:
+                    // 00FB: Scroll the display right 4 pixels
+                    scrollRight(c8->screen, c8->hiresScreen, c8->hiresMode);
+                    c8->awaitingRedraw = true;
+                    break;
+
+                case 0x00FC:
+                    // 00FC: Scroll the display left 4 pixels
+                    scrollLeft(c8->screen, c8->hiresScreen, c8->hiresMode);
+                    c8->awaitingRedraw = true;
+                    break;
+
+                case 0x00FD:
+                    // 00FD: Exit the interpreter. There's nothing to exit to, so the program stays on this instruction
+                    c8->programCounter -= 2;
+                    break;
+
+                case 0x00FE:
+                case 0x00FF:
+                    // 00FE: Switch to 64x32, 00FF: Switch to 128x64. Either way the display is cleared
+                    c8->hiresMode = c8->opcode == 0x00FF;
+                    memset(c8->screen, 0, sizeof(c8->screen));
+                    memset(c8->hiresScreen, 0, sizeof(c8->hiresScreen));
+                    c8->awaitingRedraw = true;
+                    break;
+
                 default:
-                    printf("Unknown c8->opcode: 0x%04x\n", c8->opcode);
+                    if((c8->opcode & 0x00F0) == 0x00C0) {
+                        // 00CN: Scroll the display down N pixels
+                        scrollDown(c8->screen, c8->hiresScreen, c8->hiresMode, c8->opcode & 0x000F);
+                        c8->awaitingRedraw = true;
+                    } else {
+                        report(c8, CHIP8_UNKNOWN_OPCODE);
+                    }
                     break;
             }
 
@@ -134,6 +326,9 @@ int emulateCycle(chip8 *c8) {
 
         case 0x2000:
             // 2NNN: Execute subroutine starting at address NNN
+            if(c8->stackPointer >= 24) {
+                return fault(c8, CHIP8_STACK_OVERFLOW);
+            }
             c8->stack[c8->stackPointer] = c8->programCounter;
             c8->stackPointer++;
             c8->programCounter = (c8->opcode & 0x0FFF);
@@ -185,16 +380,25 @@ int emulateCycle(chip8 *c8) {
                 case 0x0001:
                     // 8XY1: Set VX to VX OR VY
                     c8->V[(c8->opcode & 0x0F00) >> 8] |= c8->V[(c8->opcode & 0x00F0) >> 4];
+                    if(q.vfReset) {
+                        c8->V[0xF] = 0;
+                    }
                     break;
 
                 case 0x0002:
                     // 8XY2: Set VX to VX AND VY
                     c8->V[(c8->opcode & 0x0F00) >> 8] &= c8->V[(c8->opcode & 0x00F0) >> 4];
+                    if(q.vfReset) {
+                        c8->V[0xF] = 0;
+                    }
                     break;
 
                 case 0x0003:
                     // 8XY3: Set VX to VX XOR VY
                     c8->V[(c8->opcode & 0x0F00) >> 8] ^= c8->V[(c8->opcode & 0x00F0) >> 4];
+                    if(q.vfReset) {
+                        c8->V[0xF] = 0;
+                    }
                     break;
 
                 case 0x0004:
@@ -221,8 +425,8 @@ int emulateCycle(chip8 *c8) {
                 case 0x0006:
                     // 8XY6: Store the value of register VY shifted right one bit in register VX. Set register VF to the least significant bit prior to the shift
                     // Historically VY was shifted and the value was copied to VX
-                    // Modern programs (incorrectly) assume VX is shifted
-                    if (c8->modernCompat) {
+                    // CHIP-48 onwards shifted VX in place, which is what most programs now assume
+                    if (!q.shiftVy) {
                         c8->V[0xF] = (c8->V[(c8->opcode & 0x0F00) >> 8] & 1);
                         c8->V[(c8->opcode & 0x0F00) >> 8] = (c8->V[(c8->opcode & 0x0F00) >> 8]) >> 1;
                     } else {
@@ -245,8 +449,8 @@ int emulateCycle(chip8 *c8) {
                 case 0x000E:
                     // 8XYE: Store the value of register VY shifted left one bit in register VX. Set register VF to the most significant bit prior to the shift
                     // Historically VY was shifted and the value was copied to VX
-                    // Modern programs (incorrectly) assume VX is shifted
-                    if (c8->modernCompat) {
+                    // CHIP-48 onwards shifted VX in place, which is what most programs now assume
+                    if (!q.shiftVy) {
                         c8->V[0xF] = (c8->V[(c8->opcode & 0x0F00) >> 8] >> 7) & 1;
                         c8->V[(c8->opcode & 0x0F00) >> 8] = (c8->V[(c8->opcode & 0x0F00) >> 8]) << 1;
                     } else {
@@ -257,7 +461,7 @@ int emulateCycle(chip8 *c8) {
                     break;
 
                 default:
-                    printf("Unknown c8->opcode: 0x%04x\n", c8->opcode);
+                    report(c8, CHIP8_UNKNOWN_OPCODE);
                     break;
             }
 
@@ -280,40 +484,59 @@ int emulateCycle(chip8 *c8) {
 
         case 0xB000:
             // BNNN: Jump to address NNN + V0
-            c8->programCounter = c8->V[0] + (c8->opcode & 0x0FFF);
+            // CHIP-48 misread it as BXNN, a jump to XNN + VX
+            if(q.jumpVx) {
+                c8->programCounter = c8->V[(c8->opcode & 0x0F00) >> 8] + (c8->opcode & 0x0FFF);
+            } else {
+                c8->programCounter = c8->V[0] + (c8->opcode & 0x0FFF);
+            }
             break;
 
             // TODO: EXPLAIN THIS MORE
         case 0xC000:
             // CXNN: Set VX to a random number with a mask of NN
-            ;
-            int n = (rand() % (0xFF + 1));
-            c8->V[(c8->opcode & 0x0F00) >> 8] = (n & (c8->opcode & 0x00FF));
+            c8->V[(c8->opcode & 0x0F00) >> 8] = nextRandom(&c8->randomState) & (c8->opcode & 0x00FF);
             c8->programCounter += 2;
             break;
 
-            // TODO: Explain this
             // DXYN: Draw a sprite at position VX, VY with N bytes of sprite data starting at the address stored in I
             // Set VF to 01 if any set pixels are changed to unset, and 00 otherwise
+            // Each sprite byte is one row. It's moved to the top of a word then shifted right to column VX, so the whole
+            // row is tested for collisions with one AND and drawn with one XOR
+            // The start position wraps around the screen, but anything hanging off the right or bottom edge is clipped
+            // In 128x64 mode drawHires does the same with two words per row, and N = 0 draws a 16x16 sprite
         case 0xD000:
-            ;
-            uint16_t startX = c8->V[(c8->opcode & 0x0F00) >> 8];
-            uint16_t startY = c8->V[(c8->opcode & 0x00F0) >> 4];
+            if(c8->hiresMode) {
+                c8->V[0xF] = drawHires(c8->hiresScreen, c8->memory, c8->I, c8->V[(c8->opcode & 0x0F00) >> 8],
+                                       c8->V[(c8->opcode & 0x00F0) >> 4], c8->opcode & 0x000F);
+                PROFILE(c8, profileDraw);
+                c8->awaitingRedraw = true;
+                c8->displayWait = q.displayWait;
+                c8->programCounter += 2;
+                break;
+            }
+            uint8_t startX = c8->V[(c8->opcode & 0x0F00) >> 8] % 64;
+            uint8_t startY = c8->V[(c8->opcode & 0x00F0) >> 4] % 32;
+            int height = c8->opcode & 0x000F;
+            if(startY + height > 32) {
+                height = 32 - startY;
+            }
 
             c8->V[0xF] = 0;
 
-            for (int ypos = 0; ypos < (c8->opcode & 0x000F); ypos++) {
-                for(int xpos = 0; xpos < 8; xpos++) {
-                    if((c8->memory[c8->I + ypos] & (0x80 >> xpos)) != 0) {
-                        if(c8->screen[(startX + xpos + ((startY + ypos) * 64))] == 1) {
-                            c8->V[0xF] = 1;
-                        }
-                        c8->screen[startX + xpos + ((startY + ypos) * 64)] ^= 1;
-                    }
+            for(int ypos = 0; ypos < height; ypos++) {
+                // Shifting right drops the pixels past the right edge
+                uint64_t row = ((uint64_t) c8->memory[(c8->I + ypos) & 0xFFF] << 56) >> startX;
+                if(c8->screen[startY + ypos] & row) {
+                    c8->V[0xF] = 1;
                 }
+                c8->screen[startY + ypos] ^= row;
             }
+            PROFILE(c8, profileDraw);
 
+            // The VIP drew during the vertical blank, so nothing else runs until the next timer tick
             c8->awaitingRedraw = true;
+            c8->displayWait = q.displayWait;
             c8->programCounter += 2;
             break;
 
@@ -321,20 +544,20 @@ int emulateCycle(chip8 *c8) {
             switch(c8->opcode & 0x00FF) {
                 case 0x009E:
                     // EX9E: Skip the following instruction if the key corresponding to the hex value currently stored in register VX is pressed
-                    if(c8->keys[c8->V[(c8->opcode & 0x0F00) >> 8]] != 0) {
+                    if(c8->keys[c8->V[(c8->opcode & 0x0F00) >> 8] & 0xF] != 0) {
                         c8->programCounter += 2;
                     }
                     break;
 
                 case 0x00A1:
                     // EXA1: Skip the following instruction if the key corresponding to the hex value currently stored in register VX is not pressed
-                    if(c8->keys[c8->V[(c8->opcode & 0x0F00) >> 8]] == 0) {
+                    if(c8->keys[c8->V[(c8->opcode & 0x0F00) >> 8] & 0xF] == 0) {
                         c8->programCounter += 2;
                     }
                     break;
 
                 default:
-                    printf("Unknown c8->opcode: 0x%04x\n", c8->opcode);
+                    report(c8, CHIP8_UNKNOWN_OPCODE);
                     break;
 
             }
@@ -362,6 +585,9 @@ int emulateCycle(chip8 *c8) {
                 case 0x0018:
                     // FX18: Set the sound timer to the value of register VX
                     c8->soundTimer = c8->V[(c8->opcode & 0x0F00) >> 8];
+                    if(c8->audio) {
+                        queueTone(c8);
+                    }
                     break;
 
                 case 0x001E:
@@ -379,35 +605,60 @@ int emulateCycle(chip8 *c8) {
                     c8->I = c8->V[(c8->opcode & 0x0F00) >> 8] * 0x5;
                     break;
 
+                case 0x0030:
+                    // FX30: Set I to the large digit for the low nibble of register VX (SUPER-CHIP)
+                    c8->I = BIG_FONT_ADDRESS + (c8->V[(c8->opcode & 0x0F00) >> 8] & 0xF) * 10;
+                    break;
+
                 case 0x0033:
                     // FX33: Store the binary-coded decimal equivalent of the value stored in register VX at addresses I, I+1, and I+2
                     // I     = Hundreds digit of decimal equivalent
                     // I + 1 = Tens digit of decimal equivalent
                     // I + 2 = Ones digit of decimal equivalent
+                    if(c8->I + 2 > 0xFFF) {
+                        return fault(c8, CHIP8_I_OUT_OF_BOUNDS);
+                    }
                     c8->memory[c8->I]     =  c8->V[(c8->opcode & 0x0F00) >> 8] / 100;
                     c8->memory[c8->I + 1] = (c8->V[(c8->opcode & 0x0F00) >> 8] / 10) % 10;
                     c8->memory[c8->I + 2] = (c8->V[(c8->opcode & 0x0F00) >> 8] % 100) % 10;
                     break;
 
                 case 0x0055:
-                    // FX55: Store the values of registers V0 to VX inclusive in memory starting at address I. I is set to I + X + 1 after operation
+                    // FX55: Store the values of registers V0 to VX inclusive in memory starting at address I
+                    // I is set to I + X + 1 after operation, or as the memory quirk says
+                    if(c8->I + ((c8->opcode & 0x0F00) >> 8) > 0xFFF) {
+                        return fault(c8, CHIP8_I_OUT_OF_BOUNDS);
+                    }
                     for (int i = 0; i <= ((c8->opcode & 0x0F00) >> 8); i++) {
                         c8->memory[c8->I + i] = c8->V[i];
                     }
-
-                    c8->I += ((c8->opcode & 0x0F00) >> 8) + 1;
+                    advanceI(c8, q);
                     break;
 
                 case 0x0065:
-                    // FX65: Fill registers V0 to VX inclusive with the values stored in memory starting at address I. I is set to I + X + 1 after operation
+                    // FX65: Fill registers V0 to VX inclusive with the values stored in memory starting at address I
+                    // I moves on the same way as for FX55
+                    if(c8->I + ((c8->opcode & 0x0F00) >> 8) > 0xFFF) {
+                        return fault(c8, CHIP8_I_OUT_OF_BOUNDS);
+                    }
                     for (int i = 0; i <= ((c8->opcode & 0x0F00) >> 8); i++) {
                         c8->V[i] = c8->memory[c8->I + i];
                     }
-                    c8->I += ((c8->opcode & 0x0F00) >> 8) + 1;
+                    advanceI(c8, q);
+                    break;
+
+                case 0x0075:
+                    // FX75: Save registers V0 to VX inclusive in the user flags (SUPER-CHIP)
+                    memcpy(c8->rplFlags, c8->V, ((c8->opcode & 0x0F00) >> 8) + 1);
+                    break;
+
+                case 0x0085:
+                    // FX85: Load registers V0 to VX inclusive from the user flags (SUPER-CHIP)
+                    memcpy(c8->V, c8->rplFlags, ((c8->opcode & 0x0F00) >> 8) + 1);
                     break;
 
                 default:
-                    printf("Unknown c8->opcode: 0x%04x\n", c8->opcode);
+                    report(c8, CHIP8_UNKNOWN_OPCODE);
                     break;
             }
 
@@ -415,28 +666,448 @@ int emulateCycle(chip8 *c8) {
             break;
 
         default:
-            printf("Unknown c8->opcode: 0x%04x\n", c8->opcode);
+            report(c8, CHIP8_UNKNOWN_OPCODE);
             c8->programCounter += 2;
             break;
     }
 
-    clock_gettime(CLOCK_REALTIME, &(c8->currentTime));
+    TRACE_RETIRE(c8);
+    endCycle(c8);
+    return CHIP8_OK;
+}
+
+static inline __attribute__((always_inline)) chip8Status interpretCycles(chip8 *c8, uint64_t end, const chip8Quirks q) {
+    while(c8->cycleCount < end) {
+        if(q.displayWait && c8->displayWait) {
+            waitForDisplay(c8, end);
+            continue;
+        }
+        if(c8->cycleCount >= c8->idleCheckAt) {
+            skipIdle(c8, end - c8->cycleCount);
+            continue;
+        }
+        chip8Status result = executeCycle(c8, q);
+        if(result != CHIP8_OK || c8->keyWait) {
+            return result;
+        }
+    }
+    return CHIP8_OK;
+}
+
+// One emulateCycle and one emulateCycles loop for each row of QUIRK_PROFILES, with that row's quirks compiled in
+#define QUIRK_PROFILE_INTERPRETER(profile, name, ...) \
+    static chip8Status emulateCycle_##profile(chip8 *c8) { \
+        return executeCycle(c8, (chip8Quirks) {__VA_ARGS__}); \
+    } \
+    static chip8Status interpretCycles_##profile(chip8 *c8, uint64_t end) { \
+        return interpretCycles(c8, end, (chip8Quirks) {__VA_ARGS__}); \
+    }
+QUIRK_PROFILES(QUIRK_PROFILE_INTERPRETER)
+#undef QUIRK_PROFILE_INTERPRETER
+
+#define QUIRK_PROFILE_CYCLE(profile, ...) [profile] = emulateCycle_##profile,
+static chip8Status (*const cycleInterpreters[QUIRK_PROFILE_COUNT])(chip8 *) = {
+    QUIRK_PROFILES(QUIRK_PROFILE_CYCLE)
+};
+#undef QUIRK_PROFILE_CYCLE
+
+#define QUIRK_PROFILE_LOOP(profile, ...) [profile] = interpretCycles_##profile,
+static chip8Status (*const loopInterpreters[QUIRK_PROFILE_COUNT])(chip8 *, uint64_t) = {
+    QUIRK_PROFILES(QUIRK_PROFILE_LOOP)
+};
+#undef QUIRK_PROFILE_LOOP
+
+// The profile is picked here, once per call, never inside the loops
+chip8Status emulateCycle(chip8 *c8) {
+    return cycleInterpreters[c8->quirks](c8);
+}
+
+static chip8Status debugCycles(chip8 *c8, uint64_t end);
 
-    double delayDiff = (c8->currentTime).tv_sec - (c8->previousDelayTimerTick).tv_sec + ((c8->currentTime).tv_nsec - (c8->previousDelayTimerTick).tv_nsec) / 1E9;
-    if(delayDiff >= 1.0/60 && c8->delayTimer > 0) {
-        clock_gettime(CLOCK_REALTIME, &(c8->previousDelayTimerTick));
+chip8Status emulateCycles(chip8 *c8, uint64_t cycles) {
+    const uint64_t end = c8->cycleCount + cycles;
+    if(c8->keyWait) {
+        return CHIP8_OK;
+    }
+    if(c8->debugger && debuggerArmed(c8->debugger)) {
+        return debugCycles(c8, end);
+    }
+    return loopInterpreters[c8->quirks](c8, end);
+}
+
+void waitForDisplay(chip8 *c8, uint64_t end) {
+    if(!c8->displayWait || c8->cycleCount >= end) {
+        return;
+    }
+    // The same as running endCycle once for each of the cycles, which is all a waiting emulateCycle does
+    uint64_t untilTick = c8->frameCycle < c8->cyclesPerFrame ? c8->cyclesPerFrame - c8->frameCycle : 1;
+    uint64_t cycles = end - c8->cycleCount < untilTick ? end - c8->cycleCount : untilTick;
+    c8->cycleCount += cycles;
+    c8->frameCycle += cycles;
+    if(c8->frameCycle >= c8->cyclesPerFrame) {
+        c8->frameCycle = 0;
+        tickTimers(c8);
+        PROFILE(c8, profileFrame);
+    }
+}
+
+// Called once per emulated frame (60 Hz)
+void tickTimers(chip8 *c8) {
+    if(c8->delayTimer > 0) {
         c8->delayTimer--;
     }
+    // The tick stands in for the vertical blank a DXYN under the displayWait quirk is waiting on
+    c8->displayWait = false;
+    // The tone was queued with its end cycle when FX18 set the timer, so there is nothing to tell the player here
+    if(c8->soundTimer > 0) {
+        c8->soundTimer--;
+    }
+}
 
-    double soundDiff = (c8->currentTime).tv_sec - (c8->previousSoundTimerTick).tv_sec + ((c8->currentTime).tv_nsec - (c8->previousSoundTimerTick).tv_nsec) / 1E9;
-    if(soundDiff >= 1.0/60 && c8->soundTimer > 0) {
-        if(c8->soundTimer == 1) {
-            // TODO: Make sound
+void setKey(chip8 *c8, uint8_t key, bool pressed) {
+    c8->keys[key & 0xF] = pressed;
+    if(pressed && c8->keyWait) {
+        c8->V[c8->keySpot] = key & 0xF;
+        c8->keyWait = false;
+    }
+}
+
+void unpackScreen(const chip8 *c8, uint8_t *pixels) {
+    for(int y = 0; y < 32; y++) {
+        for(int x = 0; x < 64; x++) {
+            pixels[y * 64 + x] = (c8->screen[y] >> (63 - x)) & 1;
         }
-        clock_gettime(CLOCK_REALTIME, &(c8->previousSoundTimerTick));
-        c8->soundTimer--;
     }
-    return 0;
+}
+
+uint64_t hashScreen(const chip8 *c8) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    if(c8->hiresMode) {
+        for(int y = 0; y < 64; y++) {
+            for(int half = 0; half < 2; half++) {
+                for(int shift = 56; shift >= 0; shift -= 8) {
+                    hash ^= (c8->hiresScreen[half][y] >> shift) & 0xFF;
+                    hash *= 0x100000001B3ULL;
+                }
+            }
+        }
+        return hash;
+    }
+    for(int y = 0; y < 32; y++) {
+        for(int shift = 56; shift >= 0; shift -= 8) {
+            hash ^= (c8->screen[y] >> shift) & 0xFF;
+            hash *= 0x100000001B3ULL;
+        }
+    }
+    return hash;
+}
+
+// IDLE LOOPS ==================================================================
+// What an idle loop may be made of. These never write memory, the screen, the stack or the generator, never report
+// anything and can't fault as checked here, so a loop of them is decided by pc, V, I, the keys and the delay timer
+static bool idleInstruction(const chip8 *c8, uint16_t opcode, bool *readsTimer) {
+    const int x = (opcode & 0x0F00) >> 8;
+    switch(classifyOpcode(opcode)) {
+        case CLASS_1NNN:
+        case CLASS_3XNN:
+        case CLASS_4XNN:
+        case CLASS_5XY0:
+        case CLASS_6XNN:
+        case CLASS_7XNN:
+        case CLASS_8XY0:
+        case CLASS_8XY1:
+        case CLASS_8XY2:
+        case CLASS_8XY3:
+        case CLASS_8XY4:
+        case CLASS_8XY5:
+        case CLASS_8XY6:
+        case CLASS_8XY7:
+        case CLASS_8XYE:
+        case CLASS_9XY0:
+        case CLASS_ANNN:
+        case CLASS_BNNN:
+        case CLASS_FX1E:
+        case CLASS_FX29:
+        case CLASS_EX9E:
+        case CLASS_EXA1:
+        case CLASS_FX30:
+            return true;
+        case CLASS_FX65:
+            return c8->I + x <= 0xFFF;
+        case CLASS_FX07:
+            *readsTimer = true;
+            return true;
+        default:
+            return false;
+    }
+}
+
+uint64_t skipIdle(chip8 *c8, uint64_t budget) {
+    if(!c8->idleSkip) {
+        c8->idleCheckAt = UINT64_MAX;
+        return 0;
+    }
+
+    const uint64_t start = c8->cycleCount;
+    uint64_t skipped = 0;
+    bool look = !c8->keyWait && !c8->displayWait && c8->frameCycle < c8->cyclesPerFrame;
+#ifdef CHIP8_PROFILE
+    look &= c8->profile == NULL;
+#endif
+
+    // Run until the machine comes back to the state it started from. The delay timer is only compared for loops
+    // that read it, and a tick that changes it starts the search over from wherever the loop has got to
+    uint16_t loopPc = c8->programCounter;
+    uint16_t loopI = c8->I;
+    uint8_t loopV[16];
+    memcpy(loopV, c8->V, 16);
+    uint8_t loopDelay = c8->delayTimer;
+    bool readsTimer = false;
+    bool found = false;
+    int period = 0;
+    while(look && c8->cycleCount - start < budget && c8->cycleCount - start < 2 * IDLE_MAX_PERIOD) {
+        uint16_t pc = c8->programCounter;
+        if(pc >= 4095) {
+            break;
+        }
+        if(!idleInstruction(c8, (c8->memory[pc] << 8) | c8->memory[pc + 1], &readsTimer)) {
+            break;
+        }
+        emulateCycle(c8);
+        period++;
+
+        if(readsTimer && c8->delayTimer != loopDelay) {
+            loopPc = c8->programCounter;
+            loopI = c8->I;
+            memcpy(loopV, c8->V, 16);
+            loopDelay = c8->delayTimer;
+            readsTimer = false;
+            period = 0;
+        } else if(c8->programCounter == loopPc && c8->I == loopI && memcmp(c8->V, loopV, 16) == 0) {
+            found = true;
+            break;
+        } else if(period >= IDLE_MAX_PERIOD) {
+            break;
+        }
+    }
+
+    if(found) {
+        // Whole laps only, so the machine ends up exactly where it is now, opcode included
+        uint64_t room = budget - (c8->cycleCount - start);
+        if(readsTimer && c8->delayTimer != 0) {
+            uint64_t untilTick = c8->cyclesPerFrame - 1 - c8->frameCycle;
+            room = room < untilTick ? room : untilTick;
+        }
+        skipped = room / period * period;
+
+        uint64_t ticks = (c8->frameCycle + skipped) / c8->cyclesPerFrame;
+        c8->cycleCount += skipped;
+        c8->frameCycle = (c8->frameCycle + skipped) % c8->cyclesPerFrame;
+        c8->delayTimer -= ticks < c8->delayTimer ? ticks : c8->delayTimer;
+        c8->soundTimer -= ticks < c8->soundTimer ? ticks : c8->soundTimer;
+        if(skipped > 0) {
+            TRACE_SKIP_CYCLES(c8, skipped);
+        }
+    }
+
+    if(skipped >= IDLE_MIN_SKIP) {
+        c8->idleInterval = IDLE_MIN_INTERVAL;
+        c8->idleCheckAt = c8->cycleCount;
+    } else {
+        c8->idleCheckAt = c8->cycleCount + c8->idleInterval;
+        c8->idleInterval = c8->idleInterval < IDLE_MAX_INTERVAL ? c8->idleInterval * 2 : IDLE_MAX_INTERVAL;
+    }
+    return c8->cycleCount - start;
+}
+
+// DEBUGGING ===================================================================
+// The memory the instruction at pc is about to touch through I, for the watchpoints. Only FX33, FX55, FX65 and DXYN
+// reach memory that way, everything else returns false
+static bool watchedAccess(const chip8 *c8, uint16_t opcode, uint16_t *start, uint16_t *end, uint8_t *access) {
+    const int x = (opcode & 0x0F00) >> 8;
+    int length;
+    switch(classifyOpcode(opcode)) {
+        case CLASS_FX33:
+            length = 3;
+            *access = WATCH_WRITE;
+            break;
+        case CLASS_FX55:
+            length = x + 1;
+            *access = WATCH_WRITE;
+            break;
+        case CLASS_FX65:
+            length = x + 1;
+            *access = WATCH_READ;
+            break;
+        case CLASS_DXYN:
+            // 16x16 sprites are two bytes a row
+            length = opcode & 0x000F;
+            if(length == 0 && c8->hiresMode) {
+                length = 32;
+            }
+            *access = WATCH_READ;
+            break;
+        default:
+            return false;
+    }
+    if(length == 0 || c8->I > 0xFFF) {
+        return false;
+    }
+    *start = c8->I;
+    *end = c8->I + length - 1 > 0xFFF ? 0xFFF : c8->I + length - 1;
+    return true;
+}
+
+static chip8Status debugStop(chip8Debugger *d, stopReason reason, uint16_t address) {
+    d->stop = reason;
+    d->stopAddress = address;
+    return CHIP8_OK;
+}
+
+static chip8Status debugCycles(chip8 *c8, uint64_t end) {
+    chip8Debugger *d = c8->debugger;
+    d->stop = STOP_NONE;
+    while(c8->cycleCount < end) {
+        // A breakpoint stops before its instruction, and resuming from that stop runs it
+        const bool fetching = !c8->keyWait && !c8->displayWait && c8->programCounter < 4095;
+        if(fetching && hasBreakpoint(d, c8->programCounter) && d->breakCycle != c8->cycleCount) {
+            d->breakCycle = c8->cycleCount;
+            return debugStop(d, STOP_BREAKPOINT, c8->programCounter);
+        }
+
+        // Watchpoints stop after the instruction so a write shows its new value
+        int hit = -1;
+        uint16_t start, last;
+        uint8_t access;
+        if(fetching && d->watchpointCount > 0 &&
+           watchedAccess(c8, (c8->memory[c8->programCounter] << 8) | c8->memory[c8->programCounter + 1], &start, &last, &access)) {
+            for(int i = 0; i < d->watchpointCount && hit < 0; i++) {
+                const watchpoint *w = &d->watchpoints[i];
+                if((w->access & access) && start <= w->end && last >= w->start) {
+                    hit = i;
+                    d->stopAccess = access;
+                    d->stopWatchpoint = i;
+                    start = start > w->start ? start : w->start;
+                }
+            }
+        }
+        const uint16_t I = c8->I;
+
+        chip8Status status = emulateCycle(c8);
+        if(status != CHIP8_OK) {
+            return status;
+        }
+        if(hit >= 0) {
+            return debugStop(d, STOP_WATCHPOINT, start);
+        }
+        if(d->watchI && c8->I != I) {
+            return debugStop(d, STOP_WATCH_I, I);
+        }
+        if(d->steps > 0 && --d->steps == 0) {
+            return debugStop(d, STOP_STEP, c8->programCounter);
+        }
+        if(c8->keyWait) {
+            return CHIP8_OK;
+        }
+    }
+    return CHIP8_OK;
+}
+
+// SUPER-CHIP DISPLAY ==========================================================
+// Sideways scrolls go four rows at a time in a vector of words. GCC makes that two SSE2 registers by default and one
+// AVX2 register with -mavx2. Loads and stores go through memcpy, so the planes need no more than word alignment
+typedef uint64_t screenWords __attribute__((vector_size(32)));
+#define SCREEN_WORDS 4
+
+void scrollDown(uint64_t *screen, uint64_t (*hiresScreen)[64], bool hiresMode, int rows) {
+    // Row by row this is one move of whole words, the rows scrolled in at the top are blank
+    if(hiresMode) {
+        for(int half = 0; half < 2; half++) {
+            memmove(&hiresScreen[half][rows], hiresScreen[half], (64 - rows) * sizeof(uint64_t));
+            memset(hiresScreen[half], 0, rows * sizeof(uint64_t));
+        }
+    } else {
+        memmove(&screen[rows], screen, (32 - rows) * sizeof(uint64_t));
+        memset(screen, 0, rows * sizeof(uint64_t));
+    }
+}
+
+void scrollRight(uint64_t *screen, uint64_t (*hiresScreen)[64], bool hiresMode) {
+    if(!hiresMode) {
+        for(int y = 0; y < 32; y += SCREEN_WORDS) {
+            screenWords rows;
+            memcpy(&rows, &screen[y], sizeof(rows));
+            rows >>= 4;
+            memcpy(&screen[y], &rows, sizeof(rows));
+        }
+        return;
+    }
+    // The 4 pixels leaving the right of the left half become the first 4 of the right half
+    for(int y = 0; y < 64; y += SCREEN_WORDS) {
+        screenWords left, right;
+        memcpy(&left, &hiresScreen[0][y], sizeof(left));
+        memcpy(&right, &hiresScreen[1][y], sizeof(right));
+        right = (right >> 4) | (left << 60);
+        left >>= 4;
+        memcpy(&hiresScreen[0][y], &left, sizeof(left));
+        memcpy(&hiresScreen[1][y], &right, sizeof(right));
+    }
+}
+
+void scrollLeft(uint64_t *screen, uint64_t (*hiresScreen)[64], bool hiresMode) {
+    if(!hiresMode) {
+        for(int y = 0; y < 32; y += SCREEN_WORDS) {
+            screenWords rows;
+            memcpy(&rows, &screen[y], sizeof(rows));
+            rows <<= 4;
+            memcpy(&screen[y], &rows, sizeof(rows));
+        }
+        return;
+    }
+    for(int y = 0; y < 64; y += SCREEN_WORDS) {
+        screenWords left, right;
+        memcpy(&left, &hiresScreen[0][y], sizeof(left));
+        memcpy(&right, &hiresScreen[1][y], sizeof(right));
+        left = (left << 4) | (right >> 60);
+        right <<= 4;
+        memcpy(&hiresScreen[0][y], &left, sizeof(left));
+        memcpy(&hiresScreen[1][y], &right, sizeof(right));
+    }
+}
+
+bool drawHires(uint64_t (*hiresScreen)[64], const uint8_t *memory, uint16_t I, uint8_t x, uint8_t y, int n) {
+    uint8_t startX = x % 128;
+    uint8_t startY = y % 64;
+    bool wide = n == 0;
+    int height = wide ? 16 : n;
+    if(startY + height > 64) {
+        height = 64 - startY;
+    }
+
+    bool collision = false;
+    for(int ypos = 0; ypos < height; ypos++) {
+        // The sprite row at the top of a word, then split across the two halves like the low resolution draw
+        uint64_t sprite;
+        if(wide) {
+            sprite = (uint64_t) ((memory[(I + ypos * 2) & 0xFFF] << 8) | memory[(I + ypos * 2 + 1) & 0xFFF]) << 48;
+        } else {
+            sprite = (uint64_t) memory[(I + ypos) & 0xFFF] << 56;
+        }
+        uint64_t left = 0, right;
+        if(startX < 64) {
+            left  = sprite >> startX;
+            right = startX ? sprite << (64 - startX) : 0;
+        } else {
+            right = sprite >> (startX - 64);
+        }
+
+        if((hiresScreen[0][startY + ypos] & left) | (hiresScreen[1][startY + ypos] & right)) {
+            collision = true;
+        }
+        hiresScreen[0][startY + ypos] ^= left;
+        hiresScreen[1][startY + ypos] ^= right;
+    }
+    return collision;
 }
 
 #endif // CHIP8_C_INCLUDE
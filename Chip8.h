@@ -2,10 +2,67 @@
 #define CHIP8_H_INCLUDE
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
-#include <time.h>
+
+#include "Audio.h"
+#include "Events.h"
+
 #define I_MAX(A, B) (A > B ? A : B)
 
+// The delay and sound timers tick at 60 Hz of emulated time, so a frame is this many cycles (~500 instructions/s)
+#define DEFAULT_CYCLES_PER_FRAME 8
+
+// Programs are loaded at 0x200 and may run to the end of memory
+#define MAX_ROM_SIZE (4096 - 0x200)
+
+// The 8x10 SUPER-CHIP digits FX30 points at, stored after the 4x5 font
+#define BIG_FONT_ADDRESS 0x50
+
+// Idle loop detection, see skipIdle
+#define IDLE_MAX_PERIOD   32    // Longest loop looked for, in instructions
+#define IDLE_MIN_SKIP     64    // Skipping fewer cycles than this counts as a miss
+#define IDLE_MIN_INTERVAL 256   // Cycles until the next look after a miss, doubling up to IDLE_MAX_INTERVAL
+#define IDLE_MAX_INTERVAL 65536
+
+// QUIRKS ======================================================================
+// Where the platforms CHIP-8 ran on disagree. All of them clip sprites at the right and bottom edges
+typedef enum {
+    MEMORY_I_PLUS_X_PLUS_1, // FX55/FX65 leave I just past the last register moved
+    MEMORY_I_PLUS_X,        // One short of that, CHIP-48's off-by-one
+    MEMORY_I_UNCHANGED
+} memoryQuirk;
+
+typedef struct {
+    bool shiftVy;       // 8XY6/8XYE shift VY into VX. Otherwise VX is shifted in place
+    memoryQuirk memory;
+    bool jumpVx;        // BNNN is BXNN, a jump to XNN + VX. Otherwise NNN + V0
+    bool vfReset;       // 8XY1, 8XY2 and 8XY3 clear VF
+    bool displayWait;   // DXYN waits for the next timer tick, like the VIP waiting for the vertical blank
+} chip8Quirks;
+
+// One row per profile: enum name, name on the command line, then the chip8Quirks fields in order
+// Each profile gets its own interpreter loop with its quirks compiled in, see emulateCycles
+#define QUIRK_PROFILES(X) \
+    X(QUIRKS_VIP,    "vip",    true,  MEMORY_I_PLUS_X_PLUS_1, false, true,  true)  /* COSMAC VIP */ \
+    X(QUIRKS_CHIP48, "chip48", false, MEMORY_I_PLUS_X,        true,  false, false) /* HP-48 CHIP-48 */ \
+    X(QUIRKS_SCHIP,  "schip",  false, MEMORY_I_UNCHANGED,     true,  false, false) /* SUPER-CHIP 1.1 */ \
+    X(QUIRKS_MODERN, "modern", false, MEMORY_I_PLUS_X_PLUS_1, false, false, false) /* What most ROMs written today expect */
+
+#define QUIRK_PROFILE_ENUM(profile, name, ...) profile,
+typedef enum {
+    QUIRK_PROFILES(QUIRK_PROFILE_ENUM)
+    QUIRK_PROFILE_COUNT
+} quirkProfile;
+#undef QUIRK_PROFILE_ENUM
+
+// Indexed by quirkProfile. For the engines that pick per instruction at decode or translation time
+extern const char *quirkProfileNames[QUIRK_PROFILE_COUNT];
+extern const chip8Quirks quirkProfiles[QUIRK_PROFILE_COUNT];
+
+// Returns -1 for a name that isn't in QUIRK_PROFILES
+int findQuirkProfile(const char *name);
+
 typedef struct {
     // MEMORY THINGS ===============================================================
     uint8_t  V[16]; // Registers. V[0xF] is the carry flag
@@ -14,24 +71,106 @@ typedef struct {
     uint16_t stack[24];
 
     // DISPLAY THINGS ==============================================================
-    uint8_t screen[64 * 32];
+    // One word per row, the leftmost pixel (x = 0) is the most significant bit
+    uint64_t screen[32];
+    // SUPER-CHIP 128x64 mode. Only the plane for the current mode is drawn to, switching modes clears both
+    // Stored [half][row]: hiresScreen[0][y] is pixels 0-63 of row y and hiresScreen[1][y] pixels 64-127, so a
+    // sideways scroll works on whole columns of words at once
+    bool hiresMode;
+    uint64_t hiresScreen[2][64];
     bool awaitingRedraw;
 
     // KEYBOARD THINGS =============================================================
-    uint8_t keys[16];
-    bool    keyWait;
-    uint8_t keySpot;
+    uint8_t keys[16]; // EX9E and EXA1 look up the low nibble of VX
+    bool    keyWait; // Halted by FX0A. Cycles still pass and the timers still tick, but nothing runs until setKey
+    bool    displayWait; // Halted by DXYN under the displayWait quirk, the same way, until the next timer tick
+    uint8_t keySpot; // Register FX0A stores the key in
 
     // MISC THINGS =================================================================
     uint8_t delayTimer;
     uint8_t soundTimer;
-    bool modernCompat;
-    struct timespec previousDelayTimerTick;
-    struct timespec previousSoundTimerTick;
-    struct timespec currentTime;
+    quirkProfile quirks;      // Fixed at initialize. Picks the interpreter loop, see QUIRK_PROFILES
+    uint8_t rplFlags[16];     // SUPER-CHIP's HP-48 user flags, FX75 saves registers here and FX85 loads them back
+    uint64_t randomSeed;      // Seed given to initialize, kept so a run can be identified and replayed
+    uint64_t randomState;     // CXNN generator state, advanced once per CXNN. Never zero
+    chip8EventRing *events;   // Faults and unknown opcodes are pushed here. NULL discards them
+    audioRing *audio;         // FX18 tones are pushed here. NULL when nothing plays them
+    struct chip8Debugger *debugger; // Breakpoints and watchpoints emulateCycles stops for, NULL for none. See Debugger.h
+
+    // TIMING THINGS ===============================================================
+    // Timers are driven by the cycle counter, not the wall clock. Pacing to real time is the frontend's job
+    uint64_t cycleCount;     // Total cycles executed since initialize
+    uint32_t cyclesPerFrame; // Cycles between 60 Hz timer ticks
+    uint32_t frameCycle;     // Cycles into the current frame
+
+    // IDLE THINGS =================================================================
+    // Only decide how often to look for idle loops, so they aren't machine state and aren't saved
+    bool     idleSkip;     // Fast-forward through idle loops, on by default
+    uint64_t idleCheckAt;  // The engines call skipIdle once cycleCount reaches this
+    uint32_t idleInterval; // Wait after the next miss
+
+#ifdef CHIP8_PROFILE
+    // PROFILING THINGS ============================================================
+    struct chip8Profile *profile; // Counters emulateCycle records into, NULL to turn profiling off. See Profile.h
+#endif
+
+#ifdef CHIP8_TRACE
+    // TRACING THINGS ==============================================================
+    struct chip8Trace *trace;     // Ring emulateCycle records each instruction into, NULL to turn tracing off. See Trace.h
+#endif
 } chip8;
 
-int initialize(chip8 *c8, char *filename, bool modernCompat);
-int emulateCycle(chip8 *c8);
+// Both return -1 and leave c8 untouched when the ROM can't be read or is larger than MAX_ROM_SIZE
+// The same ROM, seed and input always give the same run
+int initialize(chip8 *c8, char *filename, quirkProfile quirks, uint64_t seed);
+int initializeFromMemory(chip8 *c8, const uint8_t *rom, size_t size, quirkProfile quirks, uint64_t seed);
+// Runs one cycle. Anything other than CHIP8_OK is a fault, see Events.h
+chip8Status emulateCycle(chip8 *c8);
+void tickTimers(chip8 *c8);
+
+// Runs up to `cycles` cycles in the interpreter loop built for c8->quirks, calling skipIdle when it's due
+// Stops early when FX0A starts a key wait or on a fault, and runs nothing while a key wait is pending, like the other
+// engines. A display wait is passed through with waitForDisplay
+// While c8->debugger has anything armed, the debug loop runs instead and also stops early for it
+chip8Status emulateCycles(chip8 *c8, uint64_t cycles);
+
+// Passes the cycles up to the next timer tick in one go while DXYN waits on it under the displayWait quirk, stopping at
+// cycle end. Does nothing when no wait is pending. The other engines call it wherever they'd otherwise run into the wait
+void waitForDisplay(chip8 *c8, uint64_t end);
+
+// Looks for an idle loop at the current position and fast-forwards through it. Returns the cycles that passed, at
+// most budget. A loop is idle when it only moves between a few states of pc, V and I without writing anything else:
+// a delay timer spin (FX07, 3XNN, 1NNN), a key poll (EXA1, 1NNN) or a jump to itself. It repeats exactly until a key
+// changes, which only happens between engine calls, or the delay timer it reads ticks. So whole laps are skipped up to
+// the next tick if it reads a running delay timer, otherwise up to the budget, with the timers ticked arithmetically
+// Up to 2 * IDLE_MAX_PERIOD cycles of it are really run through emulateCycle to find the loop. Results are identical
+// to running every cycle, except that a profile doesn't count the skipped cycles, so nothing is skipped while profiling
+// Sets idleCheckAt: straight away after a skip, further away after each miss
+uint64_t skipIdle(chip8 *c8, uint64_t budget);
+
+// Restarts the CXNN generator from seed
+void seedRandom(chip8 *c8, uint64_t seed);
+
+// Advances a generator state and returns the next random byte
+uint8_t nextRandom(uint64_t *state);
+
+// Records a key press or release. A press also resumes a CPU halted by FX0A
+void setKey(chip8 *c8, uint8_t key, bool pressed);
+
+// Expands the packed low resolution screen to one byte per pixel (0 or 1), row by row. pixels must hold 64 * 32 bytes
+void unpackScreen(const chip8 *c8, uint8_t *pixels);
+
+// FNV-1a over whichever plane is showing, rows top to bottom and most significant byte first
+// Two runs that drew the same thing hash the same whatever engine ran them
+uint64_t hashScreen(const chip8 *c8);
+
+// SUPER-CHIP display kernels. They work on bare planes so the lockstep engine runs the same code
+// Scrolls move whichever plane hiresMode selects, by pixels of that mode
+void scrollDown(uint64_t *screen, uint64_t (*hiresScreen)[64], bool hiresMode, int rows);
+void scrollRight(uint64_t *screen, uint64_t (*hiresScreen)[64], bool hiresMode);
+void scrollLeft(uint64_t *screen, uint64_t (*hiresScreen)[64], bool hiresMode);
+
+// DXYN in 128x64 mode, N = 0 draws a 16x16 sprite from 32 bytes. Returns whether any lit pixel was turned off
+bool drawHires(uint64_t (*hiresScreen)[64], const uint8_t *memory, uint16_t I, uint8_t x, uint8_t y, int n);
 
 #endif // CHIP8_H_INCLUDE
@@ -0,0 +1,129 @@
+// Headless debugger
+// Loads a ROM into the interpreter and takes commands one a line, on the terminal or from a single client on a local
+// TCP port: breakpoints, memory and I watchpoints, stepping, and register, memory and screen inspection
+// Build with: gcc -O2 Debug.c -o debug
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "Chip8.c"
+#include "Debugger.c"
+
+// Waits for one connection on 127.0.0.1:port, returns its descriptor or -1
+int acceptClient(int port) {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    if(listener < 0) {
+        printf("Could not open a socket\n");
+        return -1;
+    }
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if(bind(listener, (struct sockaddr *) &address, sizeof(address)) != 0 || listen(listener, 1) != 0) {
+        printf("Could not listen on port %d\n", port);
+        close(listener);
+        return -1;
+    }
+
+    printf("Waiting for a connection on 127.0.0.1:%d\n", port);
+    fflush(stdout);
+    int client = accept(listener, NULL, NULL);
+    close(listener);
+    if(client < 0) {
+        printf("Could not accept a connection\n");
+    }
+    return client;
+}
+
+void printUsage() {
+    printf("Usage: debug [options] <rom>\n");
+    printf("  --quirks <name>   vip, chip48, schip or modern (default modern)\n");
+    printf("  --seed <n>        Random seed (default 1)\n");
+    printf("  --cpf <n>         Cycles per 60 Hz timer frame (default %d)\n", DEFAULT_CYCLES_PER_FRAME);
+    printf("  --no-idle-skip    Run idle loops cycle by cycle when nothing is armed\n");
+    printf("  --port <n>        Take commands from one client on 127.0.0.1:n instead of the terminal\n");
+}
+
+int main(int argc, char *argv[]) {
+    quirkProfile quirks = QUIRKS_MODERN;
+    uint64_t seed = 1;
+    uint32_t cyclesPerFrame = DEFAULT_CYCLES_PER_FRAME;
+    bool idleSkip = true;
+    int port = 0;
+    char *romName = NULL;
+
+    for(int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if(strcmp(argv[i], "--quirks") == 0 && hasValue) {
+            int profile = findQuirkProfile(argv[++i]);
+            if(profile < 0) {
+                printUsage();
+                return -1;
+            }
+            quirks = profile;
+        } else if(strcmp(argv[i], "--seed") == 0 && hasValue) {
+            seed = strtoull(argv[++i], NULL, 0);
+        } else if(strcmp(argv[i], "--cpf") == 0 && hasValue) {
+            cyclesPerFrame = strtoul(argv[++i], NULL, 0);
+        } else if(strcmp(argv[i], "--no-idle-skip") == 0) {
+            idleSkip = false;
+        } else if(strcmp(argv[i], "--port") == 0 && hasValue) {
+            port = strtol(argv[++i], NULL, 0);
+        } else if(!romName && argv[i][0] != '-') {
+            romName = argv[i];
+        } else {
+            printUsage();
+            return -1;
+        }
+    }
+    if(!romName || cyclesPerFrame == 0 || port < 0 || port > 65535) {
+        printUsage();
+        return -1;
+    }
+
+    chip8 c8;
+    if(initialize(&c8, romName, quirks, seed) != 0) {
+        return -1;
+    }
+    c8.cyclesPerFrame = cyclesPerFrame;
+    c8.idleSkip = idleSkip;
+
+    chip8Debugger d;
+    initDebugger(&d);
+    c8.debugger = &d;
+
+    if(port == 0) {
+        printf("Debugging %s, %s quirks. Type help for the commands\n", romName, quirkProfileNames[quirks]);
+        runConsole(&c8, &d, stdin, stdout);
+        return 0;
+    }
+
+    int client = acceptClient(port);
+    if(client < 0) {
+        return -1;
+    }
+    FILE *in = fdopen(client, "r");
+    FILE *out = fdopen(dup(client), "w");
+    if(!in || !out) {
+        printf("Could not open the connection for reading and writing\n");
+        return -1;
+    }
+    fprintf(out, "Debugging %s, %s quirks. Type help for the commands\n", romName, quirkProfileNames[quirks]);
+    if(!runConsole(&c8, &d, in, out)) {
+        printf("Client disconnected\n");
+    }
+    fclose(in);
+    fclose(out);
+    return 0;
+}
@@ -0,0 +1,304 @@
+#ifndef DEBUGGER_C_INCLUDE
+#define DEBUGGER_C_INCLUDE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Chip8.c"
+#include "Disasm.c"
+#include "Debugger.h"
+
+void initDebugger(chip8Debugger *d) {
+    memset(d, 0, sizeof(chip8Debugger));
+    d->breakCycle = UINT64_MAX;
+}
+
+bool setBreakpoint(chip8Debugger *d, uint16_t pc, bool set) {
+    if(pc > 0xFFF || hasBreakpoint(d, pc) == set) {
+        return false;
+    }
+    d->breakpoints[pc / 64] ^= 1ULL << (pc % 64);
+    d->breakpointCount += set ? 1 : -1;
+    return true;
+}
+
+int addWatchpoint(chip8Debugger *d, uint16_t start, uint16_t end, uint8_t access) {
+    if(d->watchpointCount == DEBUG_MAX_WATCHPOINTS || start > end || end > 0xFFF || access == 0) {
+        return -1;
+    }
+    d->watchpoints[d->watchpointCount] = (watchpoint) {start, end, access};
+    return d->watchpointCount++;
+}
+
+void removeWatchpoint(chip8Debugger *d, int index) {
+    if(index < 0 || index >= d->watchpointCount) {
+        return;
+    }
+    memmove(&d->watchpoints[index], &d->watchpoints[index + 1], (d->watchpointCount - index - 1) * sizeof(watchpoint));
+    d->watchpointCount--;
+}
+
+// INSPECTION ==================================================================
+static const char *accessNames[] = {"", "read", "write", "read/write"};
+
+static uint16_t opcodeAtAddress(const chip8 *c8, uint16_t address) {
+    return (c8->memory[address & 0xFFF] << 8) | c8->memory[(address + 1) & 0xFFF];
+}
+
+static void printLocation(const chip8 *c8, FILE *out) {
+    char text[32];
+    uint16_t opcode = opcodeAtAddress(c8, c8->programCounter);
+    disassemble(opcode, text, sizeof(text));
+    fprintf(out, "%03X  %04X  %s\n", c8->programCounter, opcode, text);
+}
+
+static void printRegisters(const chip8 *c8, FILE *out) {
+    for(int i = 0; i < 16; i++) {
+        fprintf(out, "V%X=%02X%s", i, c8->V[i], i % 8 == 7 ? "\n" : " ");
+    }
+    fprintf(out, "I=%03X DT=%02X ST=%02X SP=%d stack:", c8->I, c8->delayTimer, c8->soundTimer, c8->stackPointer);
+    for(int i = 0; i < c8->stackPointer; i++) {
+        fprintf(out, " %03X", c8->stack[i]);
+    }
+    fprintf(out, "\ncycle %llu, frame %llu%s\n", (unsigned long long) c8->cycleCount,
+            (unsigned long long) (c8->cycleCount / c8->cyclesPerFrame), c8->keyWait ? ", waiting for a key" : "");
+    printLocation(c8, out);
+}
+
+static void printMemory(const chip8 *c8, uint16_t address, int length, FILE *out) {
+    for(int row = 0; row < length; row += 16) {
+        fprintf(out, "%03X ", (address + row) & 0xFFF);
+        for(int i = row; i < row + 16 && i < length; i++) {
+            fprintf(out, " %02X", c8->memory[(address + i) & 0xFFF]);
+        }
+        fprintf(out, "\n");
+    }
+}
+
+static void printScreen(const chip8 *c8, FILE *out) {
+    const int width = c8->hiresMode ? 128 : 64, height = c8->hiresMode ? 64 : 32;
+    char line[129];
+    for(int y = 0; y < height; y++) {
+        for(int x = 0; x < width; x++) {
+            uint64_t row = c8->hiresMode ? c8->hiresScreen[x / 64][y] : c8->screen[y];
+            line[x] = (row >> (63 - x % 64)) & 1 ? '#' : '.';
+        }
+        line[width] = '\0';
+        fprintf(out, "%s\n", line);
+    }
+}
+
+static void listStops(const chip8Debugger *d, FILE *out) {
+    fprintf(out, "Breakpoints:");
+    if(d->breakpointCount == 0) {
+        fprintf(out, " none");
+    }
+    for(int pc = 0; pc < 4096; pc++) {
+        if(hasBreakpoint(d, pc)) {
+            fprintf(out, " %03X", pc);
+        }
+    }
+    fprintf(out, "\nWatchpoints:%s\n", d->watchpointCount == 0 && !d->watchI ? " none" : "");
+    for(int i = 0; i < d->watchpointCount; i++) {
+        const watchpoint *w = &d->watchpoints[i];
+        fprintf(out, "  %d: %03X-%03X %s\n", i, w->start, w->end, accessNames[w->access]);
+    }
+    if(d->watchI) {
+        fprintf(out, "  I\n");
+    }
+}
+
+// Says why the machine stopped, then where it is
+static void reportStop(const chip8 *c8, const chip8Debugger *d, chip8Status status, FILE *out) {
+    if(status != CHIP8_OK) {
+        fprintf(out, "Faulted with %s\n", chip8StatusNames[status]);
+    } else {
+        switch(d->stop) {
+            case STOP_BREAKPOINT:
+                fprintf(out, "Breakpoint at %03X\n", d->stopAddress);
+                break;
+            case STOP_WATCHPOINT:
+                fprintf(out, "Watchpoint %d: %s at %03X\n", d->stopWatchpoint, d->stopAccess == WATCH_WRITE ? "write" : "read",
+                        d->stopAddress);
+                break;
+            case STOP_WATCH_I:
+                fprintf(out, "I changed from %03X to %03X\n", d->stopAddress, c8->I);
+                break;
+            case STOP_STEP:
+                break;
+            case STOP_NONE:
+                if(c8->keyWait) {
+                    fprintf(out, "Waiting for a key\n");
+                }
+                break;
+        }
+    }
+    printLocation(c8, out);
+}
+
+// CONSOLE =====================================================================
+static void printHelp(FILE *out) {
+    fprintf(out, "break <addr>               Stop before the instruction at addr runs\n");
+    fprintf(out, "delete [addr]              Clear the breakpoint at addr, or all of them\n");
+    fprintf(out, "watch <addr> [end] [r|w]   Stop after FX33, FX55, FX65 or DXYN reads or writes addr to end\n");
+    fprintf(out, "watch i                    Stop after any instruction that changes I\n");
+    fprintf(out, "unwatch [n|i]              Clear watchpoint n, the I watch, or all of them\n");
+    fprintf(out, "info                       List breakpoints and watchpoints\n");
+    fprintf(out, "step [n]                   Run n cycles (default 1)\n");
+    fprintf(out, "continue [frames]          Run until something stops it, at most frames frames (default %d)\n",
+            DEBUG_DEFAULT_FRAMES);
+    fprintf(out, "regs                       Registers, timers, stack and the next instruction\n");
+    fprintf(out, "mem <addr> [length]        Hex dump, 64 bytes by default\n");
+    fprintf(out, "dis [addr] [n]             Disassemble n instructions from addr (default pc and 8)\n");
+    fprintf(out, "screen                     The display, # for a lit pixel\n");
+    fprintf(out, "key <key> <0|1>            Release or press a CHIP-8 key\n");
+    fprintf(out, "quit\n");
+    fprintf(out, "Addresses and keys are hex, counts are decimal\n");
+}
+
+// Reads the next word of the line as a number in base, returns false when there is none or it isn't one
+static bool nextNumber(char **rest, int base, unsigned long *value) {
+    char *word = strtok_r(NULL, " \t", rest);
+    if(!word) {
+        return false;
+    }
+    char *end;
+    *value = strtoul(word, &end, base);
+    return *end == '\0';
+}
+
+// watch i, or an address with an optional end and access in either order after it
+static void watchCommand(chip8Debugger *d, char **rest, FILE *out) {
+    char *word = strtok_r(NULL, " \t", rest);
+    if(word && strcmp(word, "i") == 0) {
+        d->watchI = true;
+        return;
+    }
+    char *end;
+    unsigned long start = word ? strtoul(word, &end, 16) : 0;
+    if(!word || *end != '\0' || start > 0xFFF) {
+        fprintf(out, "watch expects an address or i\n");
+        return;
+    }
+    unsigned long last = start;
+    uint8_t access = WATCH_READ | WATCH_WRITE;
+    while((word = strtok_r(NULL, " \t", rest))) {
+        if(strcmp(word, "r") == 0) {
+            access = WATCH_READ;
+        } else if(strcmp(word, "w") == 0) {
+            access = WATCH_WRITE;
+        } else if(strcmp(word, "rw") == 0) {
+            access = WATCH_READ | WATCH_WRITE;
+        } else {
+            last = strtoul(word, NULL, 16);
+        }
+    }
+    int index = last <= 0xFFF ? addWatchpoint(d, start, last, access) : -1;
+    if(index < 0) {
+        fprintf(out, "Could not add the watchpoint, at most %d with end at or after start\n", DEBUG_MAX_WATCHPOINTS);
+    } else {
+        fprintf(out, "Watchpoint %d: %03lX-%03lX %s\n", index, start, last, accessNames[access]);
+    }
+}
+
+// Runs with the debugger armed for the stop, so cycles are budgeted the same way whatever stops them
+static void resume(chip8 *c8, chip8Debugger *d, uint64_t cycles, FILE *out) {
+    d->stop = STOP_NONE;
+    chip8Status status = emulateCycles(c8, cycles);
+    if(status == CHIP8_OK && d->stop == STOP_NONE && !c8->keyWait) {
+        fprintf(out, "Ran %llu cycles without stopping\n", (unsigned long long) cycles);
+    }
+    d->steps = 0;
+    reportStop(c8, d, status, out);
+}
+
+bool runConsole(chip8 *c8, chip8Debugger *d, FILE *in, FILE *out) {
+    char line[256];
+    fprintf(out, "> ");
+    fflush(out);
+    while(fgets(line, sizeof(line), in)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char *rest;
+        char *command = strtok_r(line, " \t", &rest);
+        unsigned long a, b;
+
+        if(!command) {
+            // Nothing to do
+        } else if(strcmp(command, "quit") == 0 || strcmp(command, "q") == 0) {
+            return true;
+        } else if(strcmp(command, "help") == 0 || strcmp(command, "h") == 0) {
+            printHelp(out);
+        } else if(strcmp(command, "break") == 0 || strcmp(command, "b") == 0) {
+            if(!nextNumber(&rest, 16, &a) || a > 0xFFF) {
+                fprintf(out, "break expects an address\n");
+            } else if(!setBreakpoint(d, a, true)) {
+                fprintf(out, "Already a breakpoint at %03lX\n", a);
+            }
+        } else if(strcmp(command, "delete") == 0 || strcmp(command, "d") == 0) {
+            if(nextNumber(&rest, 16, &a)) {
+                if(a > 0xFFF || !setBreakpoint(d, a, false)) {
+                    fprintf(out, "No breakpoint at %03lX\n", a);
+                }
+            } else {
+                memset(d->breakpoints, 0, sizeof(d->breakpoints));
+                d->breakpointCount = 0;
+            }
+        } else if(strcmp(command, "watch") == 0 || strcmp(command, "w") == 0) {
+            watchCommand(d, &rest, out);
+        } else if(strcmp(command, "unwatch") == 0) {
+            char *word = strtok_r(NULL, " \t", &rest);
+            if(!word) {
+                d->watchpointCount = 0;
+                d->watchI = false;
+            } else if(strcmp(word, "i") == 0) {
+                d->watchI = false;
+            } else {
+                removeWatchpoint(d, strtol(word, NULL, 10));
+            }
+        } else if(strcmp(command, "info") == 0 || strcmp(command, "i") == 0) {
+            listStops(d, out);
+        } else if(strcmp(command, "step") == 0 || strcmp(command, "s") == 0) {
+            d->steps = nextNumber(&rest, 10, &a) && a > 0 ? a : 1;
+            resume(c8, d, d->steps, out);
+        } else if(strcmp(command, "continue") == 0 || strcmp(command, "c") == 0) {
+            uint64_t frames = nextNumber(&rest, 10, &a) && a > 0 ? a : DEBUG_DEFAULT_FRAMES;
+            resume(c8, d, frames * c8->cyclesPerFrame, out);
+        } else if(strcmp(command, "regs") == 0 || strcmp(command, "r") == 0) {
+            printRegisters(c8, out);
+        } else if(strcmp(command, "mem") == 0 || strcmp(command, "x") == 0) {
+            if(!nextNumber(&rest, 16, &a)) {
+                fprintf(out, "mem expects an address\n");
+            } else {
+                printMemory(c8, a, nextNumber(&rest, 10, &b) && b > 0 && b <= 4096 ? b : 64, out);
+            }
+        } else if(strcmp(command, "dis") == 0) {
+            uint16_t address = nextNumber(&rest, 16, &a) ? a : c8->programCounter;
+            int count = nextNumber(&rest, 10, &b) && b > 0 && b <= 2048 ? b : 8;
+            for(int i = 0; i < count; i++, address += 2) {
+                char text[32];
+                uint16_t opcode = opcodeAtAddress(c8, address);
+                disassemble(opcode, text, sizeof(text));
+                fprintf(out, "%03X%c %04X  %s\n", address & 0xFFF, hasBreakpoint(d, address & 0xFFF) ? '*' : ' ',
+                        opcode, text);
+            }
+        } else if(strcmp(command, "screen") == 0) {
+            printScreen(c8, out);
+        } else if(strcmp(command, "key") == 0 || strcmp(command, "k") == 0) {
+            if(!nextNumber(&rest, 16, &a) || a > 0xF || !nextNumber(&rest, 10, &b)) {
+                fprintf(out, "key expects a key from 0 to F and 0 or 1\n");
+            } else {
+                setKey(c8, a, b != 0);
+            }
+        } else {
+            fprintf(out, "Unknown command %s, try help\n", command);
+        }
+        fprintf(out, "> ");
+        fflush(out);
+    }
+    return false;
+}
+
+#endif // DEBUGGER_C_INCLUDE
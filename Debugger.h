@@ -0,0 +1,78 @@
+#ifndef DEBUGGER_H_INCLUDE
+#define DEBUGGER_H_INCLUDE
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Chip8.h"
+
+#define DEBUG_MAX_WATCHPOINTS 16
+
+// Frames continue runs for when it isn't given a count, ten seconds of emulated time
+#define DEBUG_DEFAULT_FRAMES 600
+
+typedef enum {
+    WATCH_READ  = 1,
+    WATCH_WRITE = 2
+} watchAccess;
+
+// Addresses start to end inclusive
+typedef struct {
+    uint16_t start, end;
+    uint8_t access; // watchAccess bits
+} watchpoint;
+
+typedef enum {
+    STOP_NONE,
+    STOP_BREAKPOINT, // Before the instruction at pc runs
+    STOP_WATCHPOINT, // After an instruction read or wrote watched memory
+    STOP_WATCH_I,    // After an instruction changed I
+    STOP_STEP        // After the last of the cycles asked for
+} stopReason;
+
+// Set c8->debugger to this and emulateCycles runs its debug loop whenever anything is armed, see debuggerArmed
+// That loop runs one emulateCycle at a time without skipIdle, checks the breakpoint bitmap before each instruction and
+// the watchpoints against the memory FX33, FX55, FX65 and DXYN are about to touch, and returns early on a stop
+// With nothing armed the interpreter runs its usual loops untouched, so an idle debugger costs one test per call
+// Only the interpreter stops for it. The threaded, JIT and lockstep engines never look at the debugger
+typedef struct chip8Debugger {
+    uint64_t breakpoints[4096 / 64]; // Bit pc % 64 of word pc / 64 is set for a breakpoint at pc
+    int breakpointCount;
+    watchpoint watchpoints[DEBUG_MAX_WATCHPOINTS];
+    int watchpointCount;
+    bool watchI;
+    uint64_t steps;        // Cycles left before a STOP_STEP, 0 when not stepping
+
+    stopReason stop;       // Why the last emulateCycles returned early, STOP_NONE if it didn't
+    uint16_t stopAddress;  // pc for a breakpoint, the first watched address touched, or I before it changed
+    uint8_t stopAccess;    // watchAccess of a watchpoint stop
+    int stopWatchpoint;    // Index of the watchpoint hit
+    uint64_t breakCycle;   // Cycle the last breakpoint stopped on, so resuming runs that instruction
+} chip8Debugger;
+
+static inline bool hasBreakpoint(const chip8Debugger *d, uint16_t pc) {
+    return (d->breakpoints[pc / 64] >> (pc % 64)) & 1;
+}
+
+static inline bool debuggerArmed(const chip8Debugger *d) {
+    return d->breakpointCount > 0 || d->watchpointCount > 0 || d->watchI || d->steps > 0;
+}
+
+void initDebugger(chip8Debugger *d);
+
+// Returns false when there was already one there, or none to clear
+bool setBreakpoint(chip8Debugger *d, uint16_t pc, bool set);
+
+// Returns the index, or -1 when all DEBUG_MAX_WATCHPOINTS are in use or the range is backwards
+int addWatchpoint(chip8Debugger *d, uint16_t start, uint16_t end, uint8_t access);
+
+// Later watchpoints move down one to fill the gap
+void removeWatchpoint(chip8Debugger *d, int index);
+
+// CONSOLE =====================================================================
+// Reads one command a line from in and answers on out until quit or the end of in. Returns true on quit
+// Commands are listed by help. Addresses are hex, counts are decimal
+bool runConsole(chip8 *c8, chip8Debugger *d, FILE *in, FILE *out);
+
+#endif // DEBUGGER_H_INCLUDE
@@ -0,0 +1,433 @@
+// Differential test of the engines
+// Generates random ROMs and runs each one through the interpreter, the interpreter one emulateCycle at a time without
+// idle skipping, the predecoded engine, the JIT and lockstep in the same chunks of cycles. After every chunk the saved
+// state, the screen, the status and the events reported must all match the interpreter's. The first mismatch is
+// printed, its ROM written out, and the exit status is nonzero
+// Build with: gcc -O2 Differential.c -o differential
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Chip8.c"
+#include "Threaded.c"
+#include "Jit.c"
+#include "Lockstep.c"
+#include "State.c"
+
+typedef enum {
+    ENGINE_INTERP,
+    ENGINE_STEP,
+    ENGINE_THREADED,
+    ENGINE_JIT,
+    ENGINE_LOCKSTEP,
+    ENGINE_COUNT
+} engineType;
+
+const char *engineNames[ENGINE_COUNT] = {"interp", "step", "threaded", "jit", "lockstep"};
+
+// Lanes in a group run ROMS_PER_GROUP ROMs, each with two CXNN seeds, so lanes share opcodes until a random byte
+// sends them apart. Every other group runs its first ROM in every lane instead, so the lanes also share a program
+// counter and memory until then
+#define ROMS_PER_GROUP (LOCKSTEP_LANES / 2)
+#define MAX_CHUNKS 256
+
+typedef struct {
+    uint64_t romCount;
+    uint64_t cycles;   // Per ROM
+    uint64_t seed;     // For the generator, the same seed generates the same ROMs and chunks
+} settings;
+
+// Everything compared after a chunk. status stays at the fault once there is one
+typedef struct {
+    chip8Status status;
+    uint64_t stateHash;
+    uint64_t screenHash;
+    uint64_t eventHash;  // Every event reported so far, and how many were dropped
+} checkpoint;
+
+// One ROM with one seed and the held keys it runs with
+typedef struct {
+    const uint8_t *rom;
+    size_t size;
+    uint64_t seed;
+    uint16_t keys;     // Bit n is held key n
+    size_t index;      // For reporting
+} instance;
+
+// What the engines share for one group
+typedef struct {
+    quirkProfile quirks;
+    uint32_t cyclesPerFrame;
+    int chunkCount;
+    uint64_t chunks[MAX_CHUNKS];
+} schedule;
+
+uint64_t hashBytes(uint64_t hash, const void *data, size_t size) {
+    const uint8_t *bytes = data;
+    for(size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+// GENERATING ROMS =============================================================
+// Random bytes hardly ever run for long, so most instructions are picked from real opcodes: jumps and calls land inside
+// the program, I often points into it so FX33 and FX55 write over code, and the F and 0 groups only use real low bytes
+static const uint8_t fLow[] = {0x07, 0x0A, 0x15, 0x18, 0x1E, 0x29, 0x30, 0x33, 0x55, 0x65, 0x75, 0x85};
+static const uint8_t zeroLow[] = {0xE0, 0xEE, 0xEE, 0xFB, 0xFC, 0xFE, 0xFF, 0xC1, 0xC4, 0xCF};
+
+uint16_t randomWord(uint64_t *state) {
+    return (nextRandom(state) << 8) | nextRandom(state);
+}
+
+uint16_t randomInstruction(uint64_t *state, size_t size) {
+    uint16_t target = 0x200 + (randomWord(state) % size & ~1);
+    uint8_t x = nextRandom(state) & 0xF;
+    uint8_t low = nextRandom(state);
+    switch(nextRandom(state) % 20) {
+        case 0:
+            return randomWord(state);
+        case 1:
+            // Anywhere, to run through zeroed memory and off the end of it
+            return 0x1000 | (low & 1 ? target : randomWord(state) & 0x0FFF);
+        case 2:
+            return 0x1000 | target;
+        case 3:
+            return 0x2000 | target;
+        case 4:
+            return 0x0000 | zeroLow[low % sizeof(zeroLow)];
+        case 5:
+        case 6:
+            // Into the program half the time, so stores land on code
+            return 0xA000 | (low & 1 ? target : randomWord(state) & 0x0FFF);
+        case 7:
+            return 0xB000 | (target & 0x0F00) | (nextRandom(state) & 0x0F);
+        case 8:
+            return 0xE000 | (x << 8) | (low & 1 ? 0x9E : 0xA1);
+        case 9:
+        case 10:
+        case 11:
+            return 0xF000 | (x << 8) | fLow[low % sizeof(fLow)];
+        case 12:
+        case 13: {
+            static const uint8_t alu[] = {0x0, 0x1, 0x2, 0x3, 0x4, 0x5, 0x6, 0x7, 0xE};
+            return 0x8000 | (x << 8) | (low & 0xF0) | alu[nextRandom(state) % sizeof(alu)];
+        }
+        case 14:
+            return 0xD000 | (x << 8) | low;
+        default: {
+            // 3XNN to 7XNN, 9XY0 and CXNN
+            static const uint8_t high[] = {0x3, 0x4, 0x5, 0x6, 0x7, 0x9, 0xC};
+            return (high[nextRandom(state) % sizeof(high)] << 12) | (x << 8) | low;
+        }
+    }
+}
+
+// An instruction that never jumps or skips. Only V0 to V3, so a JIT block isn't cut short by running out of registers
+uint16_t straightInstruction(uint64_t *state) {
+    static const uint16_t straight[] = {0x6000, 0x7000, 0x8000, 0x8001, 0x8004, 0x8005, 0x800E, 0xA000, 0xF01E, 0xF033,
+                                        0xF055, 0xF065};
+    uint16_t opcode = straight[nextRandom(state) % (sizeof(straight) / sizeof(straight[0]))];
+    uint8_t x = nextRandom(state) & 0x3;
+    uint8_t low = nextRandom(state);
+    switch(opcode & 0xF000) {
+        case 0x8000:
+            return opcode | (x << 8) | (low & 0x30);
+        case 0xA000:
+            return 0xA000 | 0x200 | (randomWord(state) & 0x1FF);
+        case 0xF000:
+            return opcode | (x << 8);
+    }
+    return opcode | (x << 8) | low;
+}
+
+// Returns the size written to rom, which must hold MAX_ROM_SIZE bytes
+// A quarter of them open with a run of straight-line code longer than a JIT block. A shared ROM always does, and starts
+// it by setting V0 to V3 with CXNN, so lanes with different seeds store different bytes over the code they all run next
+// Half of them also get a delay timer spin somewhere, the one idle loop random code hardly ever makes by itself
+size_t generateRom(uint64_t *state, uint8_t *rom, bool shared) {
+    size_t size = 2 * (1 + randomWord(state) % 200);
+    size_t straight = nextRandom(state) % 4 == 0 || shared ? 2 * (nextRandom(state) % 100) : 0;
+    uint16_t opcodes[MAX_ROM_SIZE / 2];
+    for(size_t i = 0; i < size / 2; i++) {
+        opcodes[i] = 2 * i < straight ? straightInstruction(state) : randomInstruction(state, size);
+        if(shared && i < 4) {
+            opcodes[i] = 0xC0FF | i << 8;
+        }
+    }
+    if(size >= 18 && nextRandom(state) % 2) {
+        // VX = NN, delay = VX, then VX = delay until it reaches 0
+        size_t at = 4 + randomWord(state) % (size / 2 - 8);
+        uint16_t x = (nextRandom(state) & 0x3) << 8;
+        opcodes[at] = 0x6000 | x | nextRandom(state);
+        opcodes[at + 1] = 0xF015 | x;
+        opcodes[at + 2] = 0xF007 | x;
+        opcodes[at + 3] = 0x3000 | x;
+        opcodes[at + 4] = 0x1000 | (0x200 + 2 * (at + 2));
+    }
+    for(size_t i = 0; i < size / 2; i++) {
+        rom[2 * i] = opcodes[i] >> 8;
+        rom[2 * i + 1] = opcodes[i] & 0xFF;
+    }
+    return size;
+}
+
+// RUNNING =====================================================================
+// Filled with a different junk byte for each engine before initialize, so a field it forgets differs between engines
+// instead of being zero in all of them
+void startMachine(chip8 *c8, engineType engine, const instance *in, const schedule *s, chip8EventRing *events) {
+    memset(c8, 0x11 * (engine + 1), sizeof(*c8));
+    initializeFromMemory(c8, in->rom, in->size, s->quirks, in->seed);
+    c8->cyclesPerFrame = s->cyclesPerFrame;
+    for(uint8_t key = 0; key < 16; key++) {
+        setKey(c8, key, (in->keys >> key) & 1);
+    }
+    initEventRing(events);
+    c8->events = events;
+}
+
+checkpoint takeCheckpoint(const chip8 *c8, chip8Status status, chip8EventRing *events, uint64_t eventHash) {
+    checkpoint c;
+    uint8_t state[STATE_SIZE];
+    saveState(c8, state);
+    c.status = status;
+    c.stateHash = hashBytes(0xCBF29CE484222325ULL, state, sizeof(state));
+    c.screenHash = hashScreen(c8);
+
+    chip8Event event;
+    while(pollEvent(events, &event)) {
+        uint64_t fields[] = {event.status, event.pc, event.opcode, event.I, event.stackPointer, event.cycle};
+        eventHash = hashBytes(eventHash, fields, sizeof(fields));
+    }
+    unsigned int dropped = atomic_exchange(&events->dropped, 0);
+    c.eventHash = hashBytes(eventHash, &dropped, sizeof(dropped));
+    return c;
+}
+
+// Runs up to cycles one emulateCycle at a time, stopping where emulateCycles would. It never calls skipIdle, so
+// comparing it with the interpreter checks that skipping idle loops changes nothing that can be seen
+chip8Status stepCycles(chip8 *c8, uint64_t cycles) {
+    const uint64_t end = c8->cycleCount + cycles;
+    chip8Status status = CHIP8_OK;
+    while(status == CHIP8_OK && !c8->keyWait && c8->cycleCount < end) {
+        status = emulateCycle(c8);
+    }
+    return status;
+}
+
+// Runs one instance through an engine that runs a machine at a time, one checkpoint per chunk
+// Nothing more runs after a fault, which would only report it again
+void runEngine(engineType engine, const instance *in, const schedule *s, decodeCache *cache, jitCache *jit,
+               checkpoint *out) {
+    chip8 c8;
+    chip8EventRing events;
+    startMachine(&c8, engine, in, s, &events);
+    c8.idleSkip = engine != ENGINE_STEP;
+    resetDecodeCache(cache);
+    if(jit) {
+        resetJit(jit);
+    }
+
+    chip8Status status = CHIP8_OK;
+    uint64_t eventHash = 0xCBF29CE484222325ULL;
+    for(int chunk = 0; chunk < s->chunkCount; chunk++) {
+        if(status == CHIP8_OK) {
+            if(engine == ENGINE_STEP) {
+                status = stepCycles(&c8, s->chunks[chunk]);
+            } else if(engine == ENGINE_THREADED) {
+                status = emulateCyclesThreaded(&c8, cache, s->chunks[chunk]);
+            } else if(engine == ENGINE_JIT) {
+                status = emulateCyclesJit(&c8, jit, s->chunks[chunk]);
+            } else {
+                status = emulateCycles(&c8, s->chunks[chunk]);
+            }
+        }
+        out[chunk] = takeCheckpoint(&c8, status, &events, eventHash);
+        eventHash = out[chunk].eventHash;
+    }
+}
+
+// Runs a whole group in one lockstep group, one checkpoint per lane per chunk
+void runLockstep(const instance *in, const schedule *s, lockstepGroup *g, checkpoint (*out)[MAX_CHUNKS]) {
+    static chip8EventRing events[LOCKSTEP_LANES];
+    uint64_t eventHash[LOCKSTEP_LANES];
+    chip8 c8;
+    initLockstep(g);
+    for(int lane = 0; lane < LOCKSTEP_LANES; lane++) {
+        startMachine(&c8, ENGINE_LOCKSTEP, &in[lane], s, &events[lane]);
+        loadLane(g, lane, &c8);
+        eventHash[lane] = 0xCBF29CE484222325ULL;
+    }
+
+    for(int chunk = 0; chunk < s->chunkCount; chunk++) {
+        emulateCyclesLockstep(g, s->chunks[chunk]);
+        for(int lane = 0; lane < LOCKSTEP_LANES; lane++) {
+            memset(&c8, 0x11 * (ENGINE_LOCKSTEP + 1), sizeof(c8));
+            storeLane(g, lane, &c8);
+            chip8Status status = g->status[lane] == LANE_FAULT ? g->fault[lane] : CHIP8_OK;
+            out[lane][chunk] = takeCheckpoint(&c8, status, &events[lane], eventHash[lane]);
+            eventHash[lane] = out[lane][chunk].eventHash;
+        }
+    }
+}
+
+// Returns what differs between two checkpoints, NULL when they match
+const char *compareCheckpoints(const checkpoint *a, const checkpoint *b) {
+    if(a->status != b->status) {
+        return "status";
+    }
+    if(a->stateHash != b->stateHash) {
+        return "state";
+    }
+    if(a->screenHash != b->screenHash) {
+        return "screen";
+    }
+    if(a->eventHash != b->eventHash) {
+        return "events";
+    }
+    return NULL;
+}
+
+void reportMismatch(const instance *in, const schedule *s, engineType engine, int chunk, const char *what) {
+    uint64_t cycle = 0;
+    for(int i = 0; i <= chunk; i++) {
+        cycle += s->chunks[i];
+    }
+    printf("ROM %zu, %s quirks, %u cycles per frame, seed %llu, keys %04X: %s %s differs from interp after %llu cycles\n",
+           in->index, quirkProfileNames[s->quirks], s->cyclesPerFrame, (unsigned long long) in->seed, in->keys,
+           engineNames[engine], what, (unsigned long long) cycle);
+
+    char name[64];
+    snprintf(name, sizeof(name), "differential-%zu.ch8", in->index);
+    FILE *file = fopen(name, "wb");
+    if(file) {
+        fwrite(in->rom, 1, in->size, file);
+        fclose(file);
+        printf("Wrote the ROM to %s\n", name);
+    }
+}
+
+void printUsage() {
+    printf("Usage: differential [options]\n");
+    printf("  --roms <n>     ROMs to generate, rounded up to a multiple of %d (default 1024)\n", ROMS_PER_GROUP);
+    printf("  --cycles <n>   Cycles to run each one for (default 20000)\n");
+    printf("  --seed <n>     Generator seed, the same seed runs the same ROMs in the same chunks (default 1)\n");
+}
+
+int main(int argc, char *argv[]) {
+    settings s = {1024, 20000, 1};
+    for(int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if(strcmp(argv[i], "--roms") == 0 && hasValue) {
+            s.romCount = strtoull(argv[++i], NULL, 0);
+        } else if(strcmp(argv[i], "--cycles") == 0 && hasValue) {
+            s.cycles = strtoull(argv[++i], NULL, 0);
+        } else if(strcmp(argv[i], "--seed") == 0 && hasValue) {
+            s.seed = strtoull(argv[++i], NULL, 0);
+        } else {
+            printUsage();
+            return -1;
+        }
+    }
+    if(s.romCount == 0 || s.cycles == 0) {
+        printUsage();
+        return -1;
+    }
+
+    decodeCache *cache = malloc(sizeof(decodeCache));
+    jitCache *jit = malloc(sizeof(jitCache));
+    lockstepGroup *group = malloc(sizeof(lockstepGroup));
+    checkpoint (*results)[ENGINE_COUNT][MAX_CHUNKS] = malloc(LOCKSTEP_LANES * sizeof(*results));
+    if(!cache || !jit || !group || !results) {
+        printf("Out of memory\n");
+        return -1;
+    }
+    if(initJit(jit) != 0) {
+        printf("JIT not available on this host, comparing the other engines\n");
+        free(jit);
+        jit = NULL;
+    }
+
+    // The generator state is never zero, like the CXNN one
+    uint64_t state = s.seed ? s.seed : 1;
+    static uint8_t roms[ROMS_PER_GROUP][MAX_ROM_SIZE];
+    uint64_t groups = (s.romCount + ROMS_PER_GROUP - 1) / ROMS_PER_GROUP;
+    int failed = 0;
+    for(uint64_t g = 0; g < groups && !failed; g++) {
+        schedule sched;
+        sched.quirks = g % QUIRK_PROFILE_COUNT;
+        sched.cyclesPerFrame = 1 + nextRandom(&state) % 16;
+        // Chunks from 1 to 512 cycles, so engines are stopped and restarted all over the place
+        sched.chunkCount = 0;
+        for(uint64_t run = 0; run < s.cycles && sched.chunkCount < MAX_CHUNKS; sched.chunkCount++) {
+            uint64_t chunk = 1 + randomWord(&state) % 512;
+            chunk = chunk < s.cycles - run ? chunk : s.cycles - run;
+            sched.chunks[sched.chunkCount] = sched.chunkCount == MAX_CHUNKS - 1 ? s.cycles - run : chunk;
+            run += sched.chunks[sched.chunkCount];
+        }
+
+        instance in[LOCKSTEP_LANES];
+        size_t sizes[ROMS_PER_GROUP];
+        uint16_t keys[ROMS_PER_GROUP];
+        for(int r = 0; r < ROMS_PER_GROUP; r++) {
+            sizes[r] = generateRom(&state, roms[r], g % 2 && r == 0);
+            keys[r] = nextRandom(&state) & 1 ? randomWord(&state) : 0;
+        }
+        for(int lane = 0; lane < LOCKSTEP_LANES; lane++) {
+            int r = g % 2 ? 0 : lane / 2;
+            in[lane].rom = roms[r];
+            in[lane].size = sizes[r];
+            in[lane].seed = 1 + randomWord(&state);
+            in[lane].keys = keys[r];
+            in[lane].index = g * ROMS_PER_GROUP + r;
+        }
+
+        for(int lane = 0; lane < LOCKSTEP_LANES; lane++) {
+            runEngine(ENGINE_INTERP, &in[lane], &sched, cache, NULL, results[lane][ENGINE_INTERP]);
+            runEngine(ENGINE_STEP, &in[lane], &sched, cache, NULL, results[lane][ENGINE_STEP]);
+            runEngine(ENGINE_THREADED, &in[lane], &sched, cache, NULL, results[lane][ENGINE_THREADED]);
+            if(jit) {
+                runEngine(ENGINE_JIT, &in[lane], &sched, cache, jit, results[lane][ENGINE_JIT]);
+            }
+        }
+        checkpoint (*lockstep)[MAX_CHUNKS] = malloc(LOCKSTEP_LANES * sizeof(*lockstep));
+        runLockstep(in, &sched, group, lockstep);
+        for(int lane = 0; lane < LOCKSTEP_LANES; lane++) {
+            memcpy(results[lane][ENGINE_LOCKSTEP], lockstep[lane], sizeof(lockstep[lane]));
+        }
+        free(lockstep);
+
+        // The first chunk where an engine parts from the interpreter, for the first lane that does
+        for(int lane = 0; lane < LOCKSTEP_LANES && !failed; lane++) {
+            for(int chunk = 0; chunk < sched.chunkCount && !failed; chunk++) {
+                for(int engine = ENGINE_STEP; engine < ENGINE_COUNT && !failed; engine++) {
+                    if(engine == ENGINE_JIT && !jit) {
+                        continue;
+                    }
+                    const char *what = compareCheckpoints(&results[lane][ENGINE_INTERP][chunk], &results[lane][engine][chunk]);
+                    if(what) {
+                        reportMismatch(&in[lane], &sched, engine, chunk, what);
+                        failed = 1;
+                    }
+                }
+            }
+        }
+    }
+
+    if(!failed) {
+        printf("%llu groups of %d lanes, %llu cycles: no differences between %s%s\n",
+               (unsigned long long) groups, LOCKSTEP_LANES, (unsigned long long) s.cycles,
+               jit ? "interp, step, threaded, jit" : "interp, step, threaded", " and lockstep");
+    }
+    if(jit) {
+        freeJit(jit);
+        free(jit);
+    }
+    free(cache);
+    free(group);
+    free(results);
+    return failed ? -1 : 0;
+}
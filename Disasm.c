@@ -0,0 +1,144 @@
+#ifndef DISASM_C_INCLUDE
+#define DISASM_C_INCLUDE
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "Disasm.h"
+
+const char *opcodeClassNames[OPCODE_CLASSES] = {
+    "00CN", "00E0", "00EE", "00FB", "00FC", "00FD", "00FE", "00FF", "1NNN", "2NNN", "3XNN", "4XNN", "5XY0", "6XNN", "7XNN",
+    "8XY0", "8XY1", "8XY2", "8XY3", "8XY4", "8XY5", "8XY6", "8XY7", "8XYE",
+    "9XY0", "ANNN", "BNNN", "CXNN", "DXYN", "EX9E", "EXA1",
+    "FX07", "FX0A", "FX15", "FX18", "FX1E", "FX29", "FX30", "FX33", "FX55", "FX65", "FX75", "FX85",
+    "unknown"
+};
+
+opcodeClass classifyOpcode(uint16_t opcode) {
+    switch(opcode & 0xF000) {
+        case 0x0000:
+            switch(opcode & 0x00FF) {
+                case 0xE0: return CLASS_00E0;
+                case 0xEE: return CLASS_00EE;
+                case 0xFB: return CLASS_00FB;
+                case 0xFC: return CLASS_00FC;
+                case 0xFD: return CLASS_00FD;
+                case 0xFE: return CLASS_00FE;
+                case 0xFF: return CLASS_00FF;
+            }
+            if((opcode & 0x00F0) == 0x00C0) {
+                return CLASS_00CN;
+            }
+            return CLASS_UNKNOWN;
+
+        case 0x1000: return CLASS_1NNN;
+        case 0x2000: return CLASS_2NNN;
+        case 0x3000: return CLASS_3XNN;
+        case 0x4000: return CLASS_4XNN;
+        case 0x5000: return CLASS_5XY0;
+        case 0x6000: return CLASS_6XNN;
+        case 0x7000: return CLASS_7XNN;
+
+        case 0x8000:
+            switch(opcode & 0x000F) {
+                case 0x0: return CLASS_8XY0;
+                case 0x1: return CLASS_8XY1;
+                case 0x2: return CLASS_8XY2;
+                case 0x3: return CLASS_8XY3;
+                case 0x4: return CLASS_8XY4;
+                case 0x5: return CLASS_8XY5;
+                case 0x6: return CLASS_8XY6;
+                case 0x7: return CLASS_8XY7;
+                case 0xE: return CLASS_8XYE;
+            }
+            return CLASS_UNKNOWN;
+
+        case 0x9000: return CLASS_9XY0;
+        case 0xA000: return CLASS_ANNN;
+        case 0xB000: return CLASS_BNNN;
+        case 0xC000: return CLASS_CXNN;
+        case 0xD000: return CLASS_DXYN;
+
+        case 0xE000:
+            switch(opcode & 0x00FF) {
+                case 0x9E: return CLASS_EX9E;
+                case 0xA1: return CLASS_EXA1;
+            }
+            return CLASS_UNKNOWN;
+
+        case 0xF000:
+            switch(opcode & 0x00FF) {
+                case 0x07: return CLASS_FX07;
+                case 0x0A: return CLASS_FX0A;
+                case 0x15: return CLASS_FX15;
+                case 0x18: return CLASS_FX18;
+                case 0x1E: return CLASS_FX1E;
+                case 0x29: return CLASS_FX29;
+                case 0x30: return CLASS_FX30;
+                case 0x33: return CLASS_FX33;
+                case 0x55: return CLASS_FX55;
+                case 0x65: return CLASS_FX65;
+                case 0x75: return CLASS_FX75;
+                case 0x85: return CLASS_FX85;
+            }
+            return CLASS_UNKNOWN;
+    }
+    return CLASS_UNKNOWN;
+}
+
+void disassemble(uint16_t opcode, char *out, size_t size) {
+    const int x = (opcode & 0x0F00) >> 8;
+    const int y = (opcode & 0x00F0) >> 4;
+    const int n = opcode & 0x000F;
+    const int nn = opcode & 0x00FF;
+    const int nnn = opcode & 0x0FFF;
+
+    switch(classifyOpcode(opcode)) {
+        case CLASS_00CN: snprintf(out, size, "SCD %d", n); break;
+        case CLASS_00E0: snprintf(out, size, "CLS"); break;
+        case CLASS_00EE: snprintf(out, size, "RET"); break;
+        case CLASS_00FB: snprintf(out, size, "SCR"); break;
+        case CLASS_00FC: snprintf(out, size, "SCL"); break;
+        case CLASS_00FD: snprintf(out, size, "EXIT"); break;
+        case CLASS_00FE: snprintf(out, size, "LOW"); break;
+        case CLASS_00FF: snprintf(out, size, "HIGH"); break;
+        case CLASS_1NNN: snprintf(out, size, "JP 0x%03X", nnn); break;
+        case CLASS_2NNN: snprintf(out, size, "CALL 0x%03X", nnn); break;
+        case CLASS_3XNN: snprintf(out, size, "SE V%X, 0x%02X", x, nn); break;
+        case CLASS_4XNN: snprintf(out, size, "SNE V%X, 0x%02X", x, nn); break;
+        case CLASS_5XY0: snprintf(out, size, "SE V%X, V%X", x, y); break;
+        case CLASS_6XNN: snprintf(out, size, "LD V%X, 0x%02X", x, nn); break;
+        case CLASS_7XNN: snprintf(out, size, "ADD V%X, 0x%02X", x, nn); break;
+        case CLASS_8XY0: snprintf(out, size, "LD V%X, V%X", x, y); break;
+        case CLASS_8XY1: snprintf(out, size, "OR V%X, V%X", x, y); break;
+        case CLASS_8XY2: snprintf(out, size, "AND V%X, V%X", x, y); break;
+        case CLASS_8XY3: snprintf(out, size, "XOR V%X, V%X", x, y); break;
+        case CLASS_8XY4: snprintf(out, size, "ADD V%X, V%X", x, y); break;
+        case CLASS_8XY5: snprintf(out, size, "SUB V%X, V%X", x, y); break;
+        case CLASS_8XY6: snprintf(out, size, "SHR V%X, V%X", x, y); break;
+        case CLASS_8XY7: snprintf(out, size, "SUBN V%X, V%X", x, y); break;
+        case CLASS_8XYE: snprintf(out, size, "SHL V%X, V%X", x, y); break;
+        case CLASS_9XY0: snprintf(out, size, "SNE V%X, V%X", x, y); break;
+        case CLASS_ANNN: snprintf(out, size, "LD I, 0x%03X", nnn); break;
+        case CLASS_BNNN: snprintf(out, size, "JP V0, 0x%03X", nnn); break;
+        case CLASS_CXNN: snprintf(out, size, "RND V%X, 0x%02X", x, nn); break;
+        case CLASS_DXYN: snprintf(out, size, "DRW V%X, V%X, %d", x, y, n); break;
+        case CLASS_EX9E: snprintf(out, size, "SKP V%X", x); break;
+        case CLASS_EXA1: snprintf(out, size, "SKNP V%X", x); break;
+        case CLASS_FX07: snprintf(out, size, "LD V%X, DT", x); break;
+        case CLASS_FX0A: snprintf(out, size, "LD V%X, K", x); break;
+        case CLASS_FX15: snprintf(out, size, "LD DT, V%X", x); break;
+        case CLASS_FX18: snprintf(out, size, "LD ST, V%X", x); break;
+        case CLASS_FX1E: snprintf(out, size, "ADD I, V%X", x); break;
+        case CLASS_FX29: snprintf(out, size, "LD F, V%X", x); break;
+        case CLASS_FX30: snprintf(out, size, "LD HF, V%X", x); break;
+        case CLASS_FX33: snprintf(out, size, "LD B, V%X", x); break;
+        case CLASS_FX55: snprintf(out, size, "LD [I], V%X", x); break;
+        case CLASS_FX65: snprintf(out, size, "LD V%X, [I]", x); break;
+        case CLASS_FX75: snprintf(out, size, "LD R, V%X", x); break;
+        case CLASS_FX85: snprintf(out, size, "LD V%X, R", x); break;
+        default:         snprintf(out, size, "DW 0x%04X", opcode); break;
+    }
+}
+
+#endif // DISASM_C_INCLUDE
@@ -0,0 +1,26 @@
+#ifndef DISASM_H_INCLUDE
+#define DISASM_H_INCLUDE
+
+#include <stddef.h>
+#include <stdint.h>
+
+// One class per instruction emulateCycle tells apart. 5XYN and 9XYN ignore N there, so they do here too
+// 00CN, 00FB-00FF, FX30, FX75 and FX85 are SUPER-CHIP's additions
+typedef enum {
+    CLASS_00CN, CLASS_00E0, CLASS_00EE, CLASS_00FB, CLASS_00FC, CLASS_00FD, CLASS_00FE, CLASS_00FF, CLASS_1NNN, CLASS_2NNN, CLASS_3XNN, CLASS_4XNN, CLASS_5XY0, CLASS_6XNN, CLASS_7XNN,
+    CLASS_8XY0, CLASS_8XY1, CLASS_8XY2, CLASS_8XY3, CLASS_8XY4, CLASS_8XY5, CLASS_8XY6, CLASS_8XY7, CLASS_8XYE,
+    CLASS_9XY0, CLASS_ANNN, CLASS_BNNN, CLASS_CXNN, CLASS_DXYN, CLASS_EX9E, CLASS_EXA1,
+    CLASS_FX07, CLASS_FX0A, CLASS_FX15, CLASS_FX18, CLASS_FX1E, CLASS_FX29, CLASS_FX30, CLASS_FX33, CLASS_FX55, CLASS_FX65, CLASS_FX75, CLASS_FX85,
+    CLASS_UNKNOWN,
+    OPCODE_CLASSES
+} opcodeClass;
+
+// "8XY4" and so on, indexed by opcodeClass
+extern const char *opcodeClassNames[OPCODE_CLASSES];
+
+opcodeClass classifyOpcode(uint16_t opcode);
+
+// Writes a mnemonic such as "ADD V3, V4" or "LD I, 0x2A0" to out
+void disassemble(uint16_t opcode, char *out, size_t size);
+
+#endif // DISASM_H_INCLUDE
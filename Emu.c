@@ -1,30 +1,221 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
 #include <SDL2/SDL.h>
 
 #include "Chip8.c"
+#include "State.c"
+#include "Rewind.c"
+#include "TripleBuffer.c"
+#include "InputLog.c"
+#ifdef CHIP8_PROFILE
+#include "Profile.c"
+#endif
+#ifdef CHIP8_TRACE
+#include "Trace.c"
+#endif
+
+// Frontend controls picked out of the event stream
+// The main thread writes them as events arrive, the core thread reads them once per frame
+typedef struct {
+    atomic_uint keys;          // Bit n is set while CHIP-8 key n is held
+    atomic_ullong pressedAt;   // Performance counter at the oldest press the core hasn't picked up yet, 0 if none
+    atomic_bool quit;
+    atomic_bool rewinding;     // Backspace is held
+    atomic_bool turbo;         // Tab is held
+    atomic_bool saveRequested; // F5
+    atomic_bool loadRequested; // F9
+    atomic_bool traceRequested; // F8
+} frontendInput;
+
+// Everything the core thread runs with. Once it has started, only the core thread touches emulator and rewind
+typedef struct {
+    chip8 *emulator;
+    rewindBuffer *rewind;
+    frontendInput *input;
+    tripleBuffer *frames;
+    audioRing *audio;
+    inputRecorder *recorder; // NULL unless recording. Stopped for good by a rewind or a load, which change history
+    const char *stateFilename;
+    const char *traceFilename; // NULL unless tracing
+    unsigned long cyclesPerSecond;
+    int turboFrames;      // Frames run per shown frame while turbo is held
+    int runAhead;         // Frames the shown screen is ahead of the real machine
+    atomic_bool finished; // Set when the core stops by itself
+    chip8Status status;   // Why it stopped, valid once finished is set
+    Uint32 wakeEvent;     // Pushed when a frame is published or the core stops, the presenter sleeps until one arrives
+} coreThread;
 
 int8_t decodeKey(SDL_Keycode);
+void handleEvent(SDL_Event *event, frontendInput *input);
+int runCore(void *arg);
+chip8Status runFrame(chip8 *c8);
+void stopCoreRecording(coreThread *core, chip8Status status, const char *reason);
+void wakePresenter(coreThread *core);
+void printEvents(chip8EventRing *ring);
+void audioCallback(void *userdata, Uint8 *stream, int len);
 
 int main(int argc, char *argv[]) {
     const unsigned int SCALE = 5;
-    const unsigned int CYCLES_PER_SECOND = 500;
-    const bool MODERN_COMPAT = true;
 
-    srand(time(NULL));
+    // 0 means unlimited, run as fast as the host allows
+    unsigned long cyclesPerSecond = 500;
+    char *filename = NULL;
+    const char *profileBase = NULL;
+    bool profileCsv = false;
+    const char *recordFilename = NULL;
+    const char *traceFilename = NULL;
+    // Holding Tab runs this many frames for every one shown
+    int turboFrames = 8;
+    // Frames to run ahead of the real machine before presenting, 0 is off
+    int runAhead = 0;
+    // Samples per audio callback. Smaller is lower latency but the callback runs more often
+    unsigned long audioBuffer = AUDIO_DEFAULT_BUFFER;
+    // CXNN is seeded from the clock unless a seed is given, which replays a run exactly
+    uint64_t seed = time(NULL);
+    // What most ROMs written today expect. Older ones may need the platform they were written for
+    quirkProfile quirks = QUIRKS_MODERN;
 
-    if(argc != 2) {
-        printf("Incorrect usage. Expected a filename for the rom\n");
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--cps") == 0 && i + 1 < argc) {
+            i++;
+            if(strcmp(argv[i], "unlimited") == 0) {
+                cyclesPerSecond = 0;
+            } else {
+                cyclesPerSecond = strtoul(argv[i], NULL, 0);
+                if(cyclesPerSecond == 0) {
+                    printf("--cps expects a positive number or \"unlimited\"\n");
+                    return -1;
+                }
+            }
+        } else if(strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 0);
+        } else if(strcmp(argv[i], "--audio-buffer") == 0 && i + 1 < argc) {
+            audioBuffer = strtoul(argv[++i], NULL, 0);
+            if(audioBuffer == 0 || audioBuffer > 65535) {
+                printf("--audio-buffer expects a sample count from 1 to 65535\n");
+                return -1;
+            }
+        } else if(strcmp(argv[i], "--turbo") == 0 && i + 1 < argc) {
+            turboFrames = strtol(argv[++i], NULL, 0);
+            if(turboFrames < 1 || turboFrames > 64) {
+                printf("--turbo expects a frame count from 1 to 64\n");
+                return -1;
+            }
+        } else if(strcmp(argv[i], "--run-ahead") == 0 && i + 1 < argc) {
+            runAhead = strtol(argv[++i], NULL, 0);
+            if(runAhead < 0 || runAhead > 4) {
+                printf("--run-ahead expects a frame count from 0 to 4\n");
+                return -1;
+            }
+        } else if(strcmp(argv[i], "--quirks") == 0 && i + 1 < argc) {
+            int profile = findQuirkProfile(argv[++i]);
+            if(profile < 0) {
+                printf("--quirks expects vip, chip48, schip or modern\n");
+                return -1;
+            }
+            quirks = profile;
+        } else if(strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordFilename = argv[++i];
+        } else if(strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            traceFilename = argv[++i];
+        } else if(strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            profileBase = argv[++i];
+        } else if(strcmp(argv[i], "--profile-format") == 0 && i + 1 < argc) {
+            i++;
+            if(strcmp(argv[i], "csv") == 0) {
+                profileCsv = true;
+            } else if(strcmp(argv[i], "json") != 0) {
+                printf("--profile-format expects json or csv\n");
+                return -1;
+            }
+        } else if(!filename && argv[i][0] != '-') {
+            filename = argv[i];
+        } else {
+            filename = NULL;
+            break;
+        }
+    }
+    if(!filename) {
+        printf("Incorrect usage. Expected: emu [--cps <n>|unlimited] [--seed <n>] [--audio-buffer <samples>] [--turbo <frames>] [--run-ahead <frames>] [--quirks <profile>] [--record <log>] [--trace <dump>] [--profile <base> [--profile-format json|csv]] <rom>\n");
+        return -1;
+    }
+#ifndef CHIP8_PROFILE
+    if(profileBase) {
+        printf("--profile needs a build with -DCHIP8_PROFILE\n");
         return -1;
     }
+    (void) profileCsv;
+#endif
+#ifndef CHIP8_TRACE
+    if(traceFilename) {
+        printf("--trace needs a build with -DCHIP8_TRACE\n");
+        return -1;
+    }
+#endif
 
     chip8 emulator;
-    char *filename = argv[1];
-    if(initialize(&emulator, filename, MODERN_COMPAT) != 0) {
+    if(initialize(&emulator, filename, quirks, seed) != 0) {
+        return -1;
+    }
+    printf("Random seed %llu\n", (unsigned long long) seed);
+
+    // The core only queues what went wrong, it's printed here once per frame
+    chip8EventRing events;
+    initEventRing(&events);
+    emulator.events = &events;
+
+#ifdef CHIP8_PROFILE
+    // Written out when the emulator exits, including when the program faults
+    chip8Profile *profile = NULL;
+    if(profileBase) {
+        profile = calloc(1, sizeof(chip8Profile));
+        emulator.profile = profile;
+    }
+#endif
+#ifdef CHIP8_TRACE
+    // Dumped when the program faults, or whenever F8 is pressed
+    chip8Trace *trace = NULL;
+    if(traceFilename) {
+        trace = malloc(sizeof(chip8Trace));
+        resetTrace(trace);
+        emulator.trace = trace;
+    }
+#endif
+
+    // Quick save slot, next to the ROM
+    char stateFilename[4096];
+    snprintf(stateFilename, sizeof(stateFilename), "%s.state", filename);
+
+    // A minute of history. Frames usually cost a few dozen bytes, so the frame cap is what normally limits it
+    rewindBuffer rewind;
+    if(initRewind(&rewind, 1024 * 1024, 60 * 60) != 0) {
         return -1;
     }
 
+    // Emulation runs in 60 Hz frames of cyclesPerFrame instructions, so the rate is rounded to a multiple of 60
+    // Unlimited keeps the default frame length so the timers still count down at the usual rate per instruction
+    if(cyclesPerSecond > 0) {
+        emulator.cyclesPerFrame = (cyclesPerSecond + 30) / 60;
+        if(emulator.cyclesPerFrame == 0) {
+            emulator.cyclesPerFrame = 1;
+        }
+    }
+
+    // Every key change from here on, so `replay` can run the session again headless
+    inputRecorder recorder;
+    if(recordFilename) {
+        if(startRecording(&recorder, recordFilename, &emulator) != 0) {
+            freeRewind(&rewind);
+            return -1;
+        }
+        printf("Recording input to %s\n", recordFilename);
+    }
+
     // SET UP SDL ==============================================================
     if(SDL_Init(SDL_INIT_VIDEO) != 0) {
         printf("Could not start SDL\n");
@@ -50,8 +241,9 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    // Waiting for vsync only holds up the main thread, the core runs on its own
     SDL_Renderer *renderer;
-    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
     if (renderer == NULL) {
         printf("SDL Error: %s\n", SDL_GetError());
         printf("Could not initialize emulator :(\n");
@@ -61,95 +253,474 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    // The screen lives in a 64x32 streaming texture and the renderer scales it up to the window
+    // SUPER-CHIP's 128x64 mode has its own texture, scaled up to the same window
+    SDL_Texture *texture, *hiresTexture;
+    texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, 64, 32);
+    hiresTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, 128, 64);
+    if (texture == NULL || hiresTexture == NULL) {
+        printf("SDL Error: %s\n", SDL_GetError());
+        printf("Could not initialize emulator :(\n");
+        if (texture) {
+            SDL_DestroyTexture(texture);
+        }
+        if (hiresTexture) {
+            SDL_DestroyTexture(hiresTexture);
+        }
+        SDL_DestroyRenderer(renderer);
+        SDL_DestroyWindow(window);
+        SDL_Quit();
+        return 1;
+    }
+
+    // Never present faster than the display can show frames. Fall back to 60 Hz if the rate is unknown
+    SDL_DisplayMode mode;
+    int refreshRate = 60;
+    if (SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(window), &mode) == 0 && mode.refresh_rate > 0) {
+        refreshRate = mode.refresh_rate;
+    }
+    const uint64_t presentInterval = SDL_GetPerformanceFrequency() / refreshRate;
+    uint64_t lastPresent = 0;
+
+    // The beeper. Sound is optional, the emulator runs silently if there's no audio device
+    // SDL_AUDIODRIVER=disk writes what would have played to a file, which is how to check it without speakers
+    audioRing audio;
+    initAudioRing(&audio);
+    audioPlayer player;
+    SDL_AudioSpec want, have;
+    SDL_AudioDeviceID audioDevice = 0;
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) == 0) {
+        SDL_zero(want);
+        want.freq     = AUDIO_DEFAULT_SAMPLE_RATE;
+        want.format   = AUDIO_S16SYS;
+        want.channels = 1;
+        want.samples  = audioBuffer;
+        want.callback = audioCallback;
+        want.userdata = &player;
+        audioDevice = SDL_OpenAudioDevice(NULL, 0, &want, &have, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+    }
+    if (audioDevice == 0) {
+        printf("No audio: %s\n", SDL_GetError());
+    } else {
+        // The clock is published once per frame, so allow a couple of frames of slack on top of the device buffer
+        initAudioPlayer(&player, &audio, have.freq, emulator.cyclesPerFrame * 60, have.samples * 2 + have.freq / 30);
+        emulator.audio = &audio;
+        SDL_PauseAudioDevice(audioDevice, 0);
+    }
+
     printf("Successfully initialized\n");
 
     SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
     SDL_RenderClear(renderer);
 
-    // For limiting FPS
-    uint32_t frameStartTick;
-    uint32_t frameEndTick;
-    uint32_t frameChange;
+    // START THE CORE ==========================================================
+    frontendInput input;
+    atomic_init(&input.keys, 0);
+    atomic_init(&input.pressedAt, 0);
+    atomic_init(&input.quit, false);
+    atomic_init(&input.rewinding, false);
+    atomic_init(&input.turbo, false);
+    atomic_init(&input.saveRequested, false);
+    atomic_init(&input.loadRequested, false);
+    atomic_init(&input.traceRequested, false);
 
-    // Rectangle for drawing pixels? Yes, because it makes my code for scaling up the display O(1)
-    SDL_Rect pixel;
-    int renderColour;
+    tripleBuffer frames;
+    initTripleBuffer(&frames);
 
-    // The type of key event that happened, and the key that was pressed
-    SDL_Event event;
-    int8_t changedKey;
+    coreThread core;
+    core.emulator        = &emulator;
+    core.rewind          = &rewind;
+    core.input           = &input;
+    core.frames          = &frames;
+    core.audio           = &audio;
+    core.recorder        = recordFilename ? &recorder : NULL;
+    core.stateFilename   = stateFilename;
+    core.traceFilename   = traceFilename;
+    core.cyclesPerSecond = cyclesPerSecond;
+    core.turboFrames     = turboFrames;
+    core.runAhead        = runAhead;
+    core.status          = CHIP8_OK;
+    atomic_init(&core.finished, false);
+    core.wakeEvent       = SDL_RegisterEvents(1);
+
+    SDL_Thread *thread = core.wakeEvent == (Uint32) -1 ? NULL : SDL_CreateThread(runCore, "core", &core);
+    if (thread == NULL) {
+        printf("SDL Error: %s\n", SDL_GetError());
+        printf("Could not initialize emulator :(\n");
+        if (audioDevice) {
+            SDL_CloseAudioDevice(audioDevice);
+        }
+        freeRewind(&rewind);
+        SDL_DestroyTexture(texture);
+        SDL_DestroyTexture(hiresTexture);
+        SDL_DestroyRenderer(renderer);
+        SDL_DestroyWindow(window);
+        SDL_Quit();
+        return 1;
+    }
 
-    bool quit = false;
+    // CPU side copy of the texture, and the screen it shows. Only rows that changed are converted and uploaded
+    // shown[1] is only used in 128x64 mode, where it holds the right half of each row
+    uint32_t pixels[128 * 64];
+    uint64_t shown[2][64];
+    bool shownValid = false;
+    bool shownHires = false;
 
-    while(!quit) {
-        // This is for later calculating how long this frame took
-        frameStartTick = SDL_GetTicks();
+    // Key to present latency: from the press arriving here to the present of the first frame published after the core
+    // applied it. A frame the presenter skips takes its press with it, so that one just goes uncounted
+    const double ticksPerMillisecond = SDL_GetPerformanceFrequency() / 1000.0;
+    unsigned long latencyCount = 0;
+    double latencyTotal = 0, latencyMax = 0;
 
+    SDL_Event event;
+
+    // This thread only handles input and presents frames, so a slow present or a vsync wait never holds up the core
+    while (!atomic_load(&input.quit) && !atomic_load(&core.finished)) {
         // INPUT HANDLING
-        if (emulator.keyWait) {
-            while (!SDL_PollEvent(&event) || decodeKey(event.key.keysym.sym) == -1 || event.type != SDL_KEYDOWN) {}
-            changedKey = decodeKey(event.key.keysym.sym);
-            emulator.V[emulator.keySpot] = changedKey;
-            emulator.keyWait = false;
+        while (SDL_PollEvent(&event)) {
+            handleEvent(&event, &input);
         }
+        printEvents(&events);
 
-        while (SDL_PollEvent(&event)) {
-            if (event.type == SDL_QUIT) {
-                quit = true;
-            } else if(event.type == SDL_KEYDOWN || event.type == SDL_KEYUP){
-                changedKey = decodeKey(event.key.keysym.sym);
-                if (changedKey != -1) {
-                    // If the event is a keydown, set the key to true in the array, otherwise, false
-                    emulator.keys[changedKey] = (event.type == SDL_KEYDOWN);
-                }
+        // PRESENTING
+        // The newest complete frame, frames that came and went since the last present are skipped
+        const chip8Frame *frame = NULL;
+        uint64_t sincePresent = SDL_GetPerformanceCounter() - lastPresent;
+        bool early = sincePresent < presentInterval;
+        if (!early) {
+            frame = takeFrame(&frames);
+        }
+        if (frame == NULL) {
+            // Nothing to show yet. Sleep in the event queue so input still gets handled straight away, until the core
+            // publishes a frame or stops, or until the next present is due when a frame may have come in too early
+            int timeout = early ? (int) ((presentInterval - sincePresent) / ticksPerMillisecond) + 1 : 0;
+            if (early ? SDL_WaitEventTimeout(&event, timeout) : SDL_WaitEvent(&event)) {
+                handleEvent(&event, &input);
             }
+            continue;
         }
 
-        if (emulateCycle(&emulator) == -1) {
-            printf("Error: Program out of bounds\n");
-            SDL_DestroyRenderer(renderer);
-            SDL_DestroyWindow(window);
-            SDL_Quit();
-            return -1;
+        // Convert the changed rows and upload them as one span. Switching modes redraws everything
+        bool hires = frame->hiresMode;
+        int width = hires ? 128 : 64;
+        int height = hires ? 64 : 32;
+        SDL_Texture *target = hires ? hiresTexture : texture;
+        if (hires != shownHires) {
+            shownValid = false;
+        }
+        SDL_Rect rows = {0, height, width, 0};
+        for (int y = 0; y < height; y++) {
+            uint64_t left = hires ? frame->hiresScreen[0][y] : frame->screen[y];
+            uint64_t right = hires ? frame->hiresScreen[1][y] : 0;
+            if (shownValid && left == shown[0][y] && right == shown[1][y]) {
+                continue;
+            }
+            for (int x = 0; x < width; x++) {
+                // Lit pixels are white, unlit ones are a dark grey so they're never 100% black
+                uint64_t word = x < 64 ? left : right;
+                uint32_t renderColour = ((word >> (63 - x % 64)) & 1) ? 255 : 35;
+                pixels[y * width + x] = 0xFF000000 | (renderColour << 16) | (renderColour << 8) | renderColour;
+            }
+            shown[0][y] = left;
+            shown[1][y] = right;
+            if (y < rows.y) {
+                rows.y = y;
+            }
+            rows.h = y - rows.y + 1;
+        }
+        shownValid = true;
+        shownHires = hires;
+        if (rows.h > 0) {
+            SDL_UpdateTexture(target, &rows, &pixels[rows.y * width], width * sizeof(uint32_t));
+        }
+
+        SDL_RenderCopy(renderer, target, NULL, NULL);
+        SDL_RenderPresent(renderer);
+        lastPresent = SDL_GetPerformanceCounter();
+        if (frame->pressedAt != 0) {
+            double latency = (lastPresent - frame->pressedAt) / ticksPerMillisecond;
+            latencyTotal += latency;
+            latencyMax = latency > latencyMax ? latency : latencyMax;
+            latencyCount++;
+        }
+    }
+
+    // Stop the core before anything it uses goes away
+    atomic_store(&input.quit, true);
+    SDL_WaitThread(thread, NULL);
+    printEvents(&events);
+    if (latencyCount > 0) {
+        printf("Key to present latency over %lu presses with %d frame%s of run-ahead: mean %.1f ms, max %.1f ms\n",
+               latencyCount, runAhead, runAhead == 1 ? "" : "s", latencyTotal / latencyCount, latencyMax);
+    }
+
+#ifdef CHIP8_PROFILE
+    // Written out including when the program faults
+    if (profile) {
+        writeProfileFiles(profile, &emulator, profileBase, profileCsv);
+        free(profile);
+    }
+#endif
+#ifdef CHIP8_TRACE
+    if (trace) {
+        if (core.status != CHIP8_OK && writeTraceFile(trace, &emulator, core.status, traceFilename) == 0) {
+            printf("Wrote the trace up to the fault to %s\n", traceFilename);
+        }
+        free(trace);
+    }
+#endif
+    if (audioDevice) {
+        SDL_CloseAudioDevice(audioDevice);
+    }
+    freeRewind(&rewind);
+    SDL_DestroyTexture(texture);
+    SDL_DestroyTexture(hiresTexture);
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+    return core.status == CHIP8_OK ? 0 : -1;
+}
+
+// The emulator thread. Runs and paces frames, and publishes a frame whenever the screen changed
+int runCore(void *arg) {
+    coreThread *core = arg;
+    chip8 *emulator = core->emulator;
+    frontendInput *input = core->input;
+
+    // For pacing. Frames are scheduled against an absolute deadline on the high resolution clock,
+    // so time lost to a late wakeup is made up on the next frame instead of accumulating
+    const uint64_t frameTicks = SDL_GetPerformanceFrequency() / 60;
+    const uint64_t millisecond = SDL_GetPerformanceFrequency() / 1000;
+    uint64_t nextFrame = SDL_GetPerformanceCounter();
+
+    unsigned int heldKeys = 0;
+    uint64_t pressedAt = 0; // Oldest press applied since the last published frame
+    chip8Status status = CHIP8_OK;
+
+    // Run-ahead works on this copy. Copying the machine is the snapshot and simply not copying back is the restore
+    chip8 ahead;
+
+    while (!atomic_load(&input->quit)) {
+        // INPUT HANDLING
+        // Once per frame. Keys only change what the program sees between frames
+        // A press also wakes the CPU up if it's waiting on FX0A
+        // The press time is stored before the key, so a new press here always has its time there too. A time with no new
+        // press (a tap shorter than a frame, or a key that isn't here yet) is dropped rather than pinned on a later press
+        unsigned int keys = atomic_load(&input->keys);
+        uint64_t pressTime = atomic_exchange(&input->pressedAt, 0);
+        if ((keys & ~heldKeys) && pressedAt == 0) {
+            pressedAt = pressTime;
         }
+        for (uint8_t key = 0; key < 16; key++) {
+            if ((keys ^ heldKeys) & (1u << key)) {
+                if (core->recorder) {
+                    recordKey(core->recorder, emulator, key, (keys >> key) & 1);
+                }
+                setKey(emulator, key, (keys >> key) & 1);
+            }
+        }
+        heldKeys = keys;
 
-        /* printf("Delay Timer: %d\n", emulator.delayTimer); */
+        if (atomic_exchange(&input->saveRequested, false)) {
+            if (saveStateFile(emulator, core->stateFilename) == 0) {
+                printf("Saved state to %s\n", core->stateFilename);
+            }
+        }
+        if (atomic_exchange(&input->loadRequested, false)) {
+            stopCoreRecording(core, CHIP8_OK, "loading a state");
+            // The rewind history stays, rewinding past this point goes back to before the load
+            if (loadStateFile(emulator, core->stateFilename) == 0) {
+                rewindAudioRing(core->audio);
+                printf("Loaded state from %s\n", core->stateFilename);
+            }
+        }
+#ifdef CHIP8_TRACE
+        if (atomic_exchange(&input->traceRequested, false) && emulator->trace) {
+            if (writeTraceFile(emulator->trace, emulator, CHIP8_OK, core->traceFilename) == 0) {
+                printf("Wrote trace to %s\n", core->traceFilename);
+            }
+        }
+#endif
 
-        if (emulator.awaitingRedraw) {
-            for (int i = 0; i < 64 * 32; i++) {
-                // Render colour is either 255 if screen[i] == 1 or 0 if screen[i] == 0
-                // The I_MAX ensures that pixels are never 100% black
-                renderColour = I_MAX(255 * emulator.screen[i], 35);
-                SDL_SetRenderDrawColor(renderer, renderColour, renderColour, renderColour, renderColour);
+        // EMULATION
+        // Run a frame's worth of cycles. The core ticks the timers itself when the frame's last cycle finishes
+        // While halted on FX0A the cycles still pass, so the timers keep counting down
+        // Unlimited mode keeps running frames for a 60th of a second before it looks at input again
+        // Turbo runs turboFrames frames in the time of one, so only every turboFrames-th frame is shown
+        // While Backspace is held, step back one frame instead. Stepping stops at the oldest frame kept
+        bool rewinding = atomic_load(&input->rewinding);
+        bool turbo = atomic_load(&input->turbo);
+        if (rewinding) {
+            stopCoreRecording(core, CHIP8_OK, "rewinding");
+            popRewind(core->rewind, emulator);
+            rewindAudioRing(core->audio);
+        } else {
+            uint64_t batchStart = SDL_GetPerformanceCounter();
+            int frames = 0;
+            do {
+                status = runFrame(emulator);
+                frames++;
+            } while (status == CHIP8_OK && !emulator->keyWait &&
+                     (core->cyclesPerSecond == 0 ? SDL_GetPerformanceCounter() - batchStart < frameTicks
+                                                 : turbo && frames < core->turboFrames));
+            pushRewind(core->rewind, emulator);
+            if (core->recorder) {
+                recordCheckpoint(core->recorder, emulator);
+            }
+        }
+        publishAudioClock(core->audio, emulator->cycleCount);
 
-                pixel.x = (i % 64) * SCALE;
-                pixel.y = (i / 64) * SCALE;
-                pixel.w = SCALE;
-                pixel.h = SCALE;
+        // RUN-AHEAD
+        // The screen shown is runAhead frames past the real machine, run with the keys held now, so a press shows up that
+        // many frames sooner. The copy reports nothing and plays nothing, and is thrown away once its screen is out
+        const chip8 *shown = emulator;
+        if (core->runAhead > 0 && !rewinding && status == CHIP8_OK) {
+            ahead = *emulator;
+            ahead.events = NULL;
+            ahead.audio = NULL;
+#ifdef CHIP8_PROFILE
+            ahead.profile = NULL;
+#endif
+#ifdef CHIP8_TRACE
+            ahead.trace = NULL;
+#endif
+            for (int step = 0; step < core->runAhead && runFrame(&ahead) == CHIP8_OK; step++) {}
+            shown = &ahead;
+        }
 
-                SDL_RenderFillRect(renderer, &pixel);
+        // PUBLISHING
+        // Copying the screen out is all the renderer needs, the core never waits for it
+        // A run-ahead screen is published every frame, since a guess that turned out wrong has to be replaced
+        if (emulator->awaitingRedraw || shown != emulator) {
+            chip8Frame *frame = backFrame(core->frames);
+            frame->hiresMode = shown->hiresMode;
+            if (shown->hiresMode) {
+                memcpy(frame->hiresScreen, shown->hiresScreen, sizeof(frame->hiresScreen));
+            } else {
+                memcpy(frame->screen, shown->screen, sizeof(frame->screen));
             }
+            frame->cycle = shown->cycleCount;
+            frame->pressedAt = pressedAt;
+            publishFrame(core->frames);
+            wakePresenter(core);
+            pressedAt = 0;
+            emulator->awaitingRedraw = false;
+        }
 
-            SDL_RenderPresent(renderer);
-            emulator.awaitingRedraw = false;
+        if (status != CHIP8_OK) {
+            break;
         }
 
-        // Limit the FPS
-        // Every frame should take (1000 ms) / CYCLES_PER_SECOND ticks to complete
-        // If they take less, sleep for the number of ticks left over
-        frameEndTick = SDL_GetTicks();
-        frameChange = frameEndTick - frameStartTick;
-        if(frameChange < 1000 / CYCLES_PER_SECOND) {
-            SDL_Delay((1000 / CYCLES_PER_SECOND) - frameChange);
+        // PACING
+        // This is the only place wall-clock time is used, the core only counts cycles
+        // A halted or rewinding CPU is paced at 60 Hz even in unlimited mode, so a key wait doesn't spin and rewinding runs at normal speed
+        if (core->cyclesPerSecond != 0 || emulator->keyWait || rewinding) {
+            nextFrame += frameTicks;
+            uint64_t now = SDL_GetPerformanceCounter();
+            if (now < nextFrame) {
+                // Sleep, never spin. SDL_Delay only has millisecond resolution, so a frame may start up to a millisecond
+                // early, which the absolute deadline takes back on the next one. Nothing runs during a key wait, so
+                // there it rounds up and sleeps the whole way
+                uint32_t sleep = (nextFrame - now) / millisecond;
+                if (emulator->keyWait) {
+                    sleep++;
+                }
+                if (sleep > 0) {
+                    SDL_Delay(sleep);
+                }
+            } else if (now - nextFrame > 4 * frameTicks) {
+                // Too far behind to catch up (stalled window, debugger), start counting again from now
+                nextFrame = now;
+            }
+        } else {
+            nextFrame = SDL_GetPerformanceCounter();
         }
     }
 
-    SDL_DestroyRenderer(renderer);
-    SDL_DestroyWindow(window);
-    SDL_Quit();
+    stopCoreRecording(core, status, NULL);
+    core->status = status;
+    atomic_store(&core->finished, true);
+    wakePresenter(core);
     return 0;
 }
 
+// One 60 Hz frame. emulateCycles fast-forwards idle loops and stops early on FX0A, the rest of the frame is the halt
+chip8Status runFrame(chip8 *c8) {
+    uint64_t frameEnd = c8->cycleCount + c8->cyclesPerFrame;
+    chip8Status status = emulateCycles(c8, c8->cyclesPerFrame);
+    while (status == CHIP8_OK && c8->cycleCount < frameEnd) {
+        status = emulateCycle(c8);
+    }
+    return status;
+}
+
+// Ends the log at the current cycle. A reason means the session went somewhere a replay can't follow
+void stopCoreRecording(coreThread *core, chip8Status status, const char *reason) {
+    if (!core->recorder) {
+        return;
+    }
+    if (reason) {
+        printf("Recording stopped by %s\n", reason);
+    }
+    stopRecording(core->recorder, core->emulator, status);
+    core->recorder = NULL;
+}
+
+// SDL_PushEvent is safe from any thread. The presenter takes it out of the queue like any other event and ignores it
+void wakePresenter(coreThread *core) {
+    SDL_Event event;
+    SDL_zero(event);
+    event.type = core->wakeEvent;
+    SDL_PushEvent(&event);
+}
+
+void handleEvent(SDL_Event *event, frontendInput *input) {
+    if (event->type == SDL_QUIT) {
+        atomic_store(&input->quit, true);
+    } else if (event->type == SDL_KEYDOWN || event->type == SDL_KEYUP) {
+        bool pressed = event->type == SDL_KEYDOWN;
+        switch (event->key.keysym.sym) {
+        case SDLK_BACKSPACE:
+            atomic_store(&input->rewinding, pressed);
+            return;
+        case SDLK_TAB:
+            atomic_store(&input->turbo, pressed);
+            return;
+        case SDLK_F5:
+            if (pressed && !event->key.repeat) {
+                atomic_store(&input->saveRequested, true);
+            }
+            return;
+        case SDLK_F9:
+            if (pressed && !event->key.repeat) {
+                atomic_store(&input->loadRequested, true);
+            }
+            return;
+        case SDLK_F8:
+            if (pressed && !event->key.repeat) {
+                atomic_store(&input->traceRequested, true);
+            }
+            return;
+        }
+
+        int8_t changedKey = decodeKey(event->key.keysym.sym);
+        if (changedKey != -1) {
+            // If the event is a keydown, the key is pressed, otherwise it was released
+            // The core picks the change up at the start of its next frame
+            if (pressed) {
+                // Only the oldest press waiting for the core is timed
+                uint64_t none = 0;
+                if (!event->key.repeat) {
+                    atomic_compare_exchange_strong(&input->pressedAt, &none, SDL_GetPerformanceCounter());
+                }
+                atomic_fetch_or(&input->keys, 1u << changedKey);
+            } else {
+                atomic_fetch_and(&input->keys, ~(1u << changedKey));
+            }
+        }
+    }
+}
+
 // This is disgusting, but probably the simplest (and best) way to do it
 int8_t decodeKey(SDL_Keycode k) {
     switch (k) {
@@ -189,3 +760,32 @@ int8_t decodeKey(SDL_Keycode k) {
         return -1;
     }
 }
+
+// Runs on SDL's audio thread. Only reads the ring, never touches the machine
+void audioCallback(void *userdata, Uint8 *stream, int len) {
+    renderAudio(userdata, (int16_t *) stream, len / sizeof(int16_t));
+}
+
+// Prints everything the core has queued since the last call
+void printEvents(chip8EventRing *ring) {
+    chip8Event event;
+    while (pollEvent(ring, &event)) {
+        switch (event.status) {
+        case CHIP8_UNKNOWN_OPCODE:
+            printf("Unknown opcode 0x%04X at 0x%03X\n", event.opcode, event.pc);
+            break;
+        case CHIP8_PC_OUT_OF_BOUNDS:
+            printf("Error: Program out of bounds at 0x%03X\n", event.pc);
+            break;
+        default:
+            printf("Error: %s at 0x%03X (opcode 0x%04X, I 0x%03X, stack pointer %d)\n", chip8StatusNames[event.status],
+                   event.pc, event.opcode, event.I, event.stackPointer);
+            break;
+        }
+    }
+
+    unsigned int dropped = atomic_exchange(&ring->dropped, 0);
+    if (dropped > 0) {
+        printf("%u more events were dropped\n", dropped);
+    }
+}
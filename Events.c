@@ -0,0 +1,49 @@
+#ifndef EVENTS_C_INCLUDE
+#define EVENTS_C_INCLUDE
+
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "Events.h"
+
+const char *chip8StatusNames[CHIP8_STATUS_COUNT] = {
+    "ok", "unknown_opcode", "pc_out_of_bounds", "stack_overflow", "stack_underflow", "i_out_of_bounds"
+};
+
+void initEventRing(chip8EventRing *ring) {
+    memset(ring->events, 0, sizeof(ring->events));
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->dropped, 0);
+}
+
+void pushEvent(chip8EventRing *ring, const chip8Event *event) {
+    if(!ring) {
+        return;
+    }
+    unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if(head - tail >= CHIP8_EVENT_RING_SIZE) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return;
+    }
+    ring->events[head & (CHIP8_EVENT_RING_SIZE - 1)] = *event;
+    // Publishes the slot before the consumer can see the new head
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+bool pollEvent(chip8EventRing *ring, chip8Event *event) {
+    unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned int head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if(tail == head) {
+        return false;
+    }
+    *event = ring->events[tail & (CHIP8_EVENT_RING_SIZE - 1)];
+    // Hands the slot back to the producer only once it has been copied out
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+#endif // EVENTS_C_INCLUDE
@@ -0,0 +1,50 @@
+#ifndef EVENTS_H_INCLUDE
+#define EVENTS_H_INCLUDE
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+// What emulateCycle and the engines return, and what an event reports
+// A fault stops the machine before the instruction does anything: no state changes and the cycle isn't counted,
+// so running again faults again. An unknown opcode is only ever an event, the opcode is skipped and execution carries on
+typedef enum {
+    CHIP8_OK,
+    CHIP8_UNKNOWN_OPCODE,   // Event only
+    CHIP8_PC_OUT_OF_BOUNDS, // The program counter is past the last whole opcode in memory
+    CHIP8_STACK_OVERFLOW,   // 2NNN with all 24 stack entries in use
+    CHIP8_STACK_UNDERFLOW,  // 00EE with an empty stack
+    CHIP8_I_OUT_OF_BOUNDS,  // FX33, FX55 or FX65 would run past the end of memory from I
+    CHIP8_STATUS_COUNT
+} chip8Status;
+
+// "ok", "unknown_opcode", "pc_out_of_bounds" and so on, indexed by chip8Status
+extern const char *chip8StatusNames[CHIP8_STATUS_COUNT];
+
+typedef struct {
+    chip8Status status;
+    uint16_t pc, opcode, I, stackPointer;
+    uint64_t cycle; // cycleCount when it happened
+} chip8Event;
+
+// Must be a power of two
+#define CHIP8_EVENT_RING_SIZE 64
+
+// Single producer, single consumer. The machine pushes from whichever thread runs it and the frontend polls from
+// any one thread, neither ever blocks. When the ring is full new events are counted in dropped and thrown away
+typedef struct {
+    chip8Event events[CHIP8_EVENT_RING_SIZE];
+    atomic_uint head;    // Next slot to write, only the producer stores it
+    atomic_uint tail;    // Next slot to read, only the consumer stores it
+    atomic_uint dropped;
+} chip8EventRing;
+
+void initEventRing(chip8EventRing *ring);
+
+// Does nothing when ring is NULL, which is how a machine with nobody listening runs
+void pushEvent(chip8EventRing *ring, const chip8Event *event);
+
+// Copies out the oldest event. Returns false when there is none
+bool pollEvent(chip8EventRing *ring, chip8Event *event);
+
+#endif // EVENTS_H_INCLUDE
@@ -0,0 +1,163 @@
+#ifndef INPUTLOG_C_INCLUDE
+#define INPUTLOG_C_INCLUDE
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Chip8.c"
+#include "Bytes.c"
+#include "InputLog.h"
+
+static const uint8_t inputLogMagic[4] = {'C', '8', 'I', 'N'};
+
+uint64_t hashProgram(const chip8 *c8) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for(int i = 0x200; i < 4096; i++) {
+        hash ^= c8->memory[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+// WRITING =====================================================================
+// The type byte, then the cycles since the last record as a varint
+static void writeRecordStart(inputRecorder *r, uint8_t type, uint64_t cycle) {
+    fputc(type, r->file);
+    writeVarint(r->file, cycle - r->lastCycle);
+    r->lastCycle = cycle;
+    r->records++;
+}
+
+int startRecording(inputRecorder *r, const char *filename, const chip8 *c8) {
+    r->file = fopen(filename, "wb");
+    if(!r->file) {
+        printf("Could not open %s for writing\n", filename);
+        return -1;
+    }
+    r->lastCycle = c8->cycleCount;
+    r->nextCheckpoint = c8->cycleCount + (uint64_t) INPUT_LOG_CHECKPOINT_FRAMES * c8->cyclesPerFrame;
+    r->lastCheckpoint = UINT64_MAX;
+    r->records = 0;
+
+    fwrite(inputLogMagic, 1, 4, r->file);
+    writeLittleEndian(r->file, INPUT_LOG_VERSION, 4);
+    writeLittleEndian(r->file, c8->randomSeed, 8);
+    writeLittleEndian(r->file, hashProgram(c8), 8);
+    writeLittleEndian(r->file, c8->cyclesPerFrame, 4);
+    fputc(c8->quirks, r->file);
+    return 0;
+}
+
+void recordKey(inputRecorder *r, const chip8 *c8, uint8_t key, bool pressed) {
+    writeRecordStart(r, (pressed ? 0x10 : 0x00) | (key & 0xF), c8->cycleCount);
+}
+
+static void writeCheckpoint(inputRecorder *r, const chip8 *c8) {
+    writeRecordStart(r, 0x20, c8->cycleCount);
+    writeLittleEndian(r->file, hashScreen(c8), 8);
+    r->lastCheckpoint = c8->cycleCount;
+}
+
+void recordCheckpoint(inputRecorder *r, const chip8 *c8) {
+    if(c8->cycleCount < r->nextCheckpoint) {
+        return;
+    }
+    writeCheckpoint(r, c8);
+    r->nextCheckpoint = c8->cycleCount + (uint64_t) INPUT_LOG_CHECKPOINT_FRAMES * c8->cyclesPerFrame;
+}
+
+int stopRecording(inputRecorder *r, const chip8 *c8, chip8Status status) {
+    if(r->lastCheckpoint != c8->cycleCount) {
+        writeCheckpoint(r, c8);
+    }
+    writeRecordStart(r, 0x30, c8->cycleCount);
+    fputc(status, r->file);
+
+    bool failed = ferror(r->file);
+    if(fclose(r->file) != 0 || failed) {
+        printf("Could not write the input log\n");
+        return -1;
+    }
+    r->file = NULL;
+    return 0;
+}
+
+// READING =====================================================================
+int openInputLog(inputReader *r, const char *filename) {
+    r->file = fopen(filename, "rb");
+    if(!r->file) {
+        printf("Could not open %s\n", filename);
+        return -1;
+    }
+
+    uint8_t magic[4];
+    uint64_t version, seed, programHash, cyclesPerFrame;
+    int quirks;
+    if(fread(magic, 1, 4, r->file) != 4 || memcmp(magic, inputLogMagic, 4) != 0 ||
+       !readLittleEndian(r->file, &version, 4) || version != INPUT_LOG_VERSION ||
+       !readLittleEndian(r->file, &seed, 8) || !readLittleEndian(r->file, &programHash, 8) ||
+       !readLittleEndian(r->file, &cyclesPerFrame, 4) || cyclesPerFrame == 0 ||
+       (quirks = fgetc(r->file)) == EOF || quirks >= QUIRK_PROFILE_COUNT) {
+        printf("%s is not an input log of version %d\n", filename, INPUT_LOG_VERSION);
+        fclose(r->file);
+        r->file = NULL;
+        return -1;
+    }
+
+    r->header.seed = seed;
+    r->header.programHash = programHash;
+    r->header.cyclesPerFrame = cyclesPerFrame;
+    r->header.quirks = quirks;
+    r->lastCycle = 0;
+    return 0;
+}
+
+int readInputRecord(inputReader *r, inputRecord *record) {
+    int type = fgetc(r->file);
+    if(type == EOF) {
+        return 0;
+    }
+
+    uint64_t delta;
+    if(!readVarint(r->file, &delta)) {
+        return -1;
+    }
+    r->lastCycle += delta;
+    record->cycle = r->lastCycle;
+
+    uint64_t value;
+    switch(type & 0xF0) {
+        case 0x00:
+        case 0x10:
+            record->type = type & 0x10 ? INPUT_KEY_DOWN : INPUT_KEY_UP;
+            record->key = type & 0xF;
+            return 1;
+        case 0x20:
+            if(type != 0x20 || !readLittleEndian(r->file, &value, 8)) {
+                return -1;
+            }
+            record->type = INPUT_CHECKPOINT;
+            record->screenHash = value;
+            return 1;
+        case 0x30:
+            if(type != 0x30 || !readLittleEndian(r->file, &value, 1) || value >= CHIP8_STATUS_COUNT) {
+                return -1;
+            }
+            record->type = INPUT_END;
+            record->status = value;
+            return 1;
+        default:
+            return -1;
+    }
+}
+
+void closeInputLog(inputReader *r) {
+    if(r->file) {
+        fclose(r->file);
+        r->file = NULL;
+    }
+}
+
+#endif // INPUTLOG_C_INCLUDE
@@ -0,0 +1,85 @@
+#ifndef INPUTLOG_H_INCLUDE
+#define INPUTLOG_H_INCLUDE
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Chip8.h"
+#include "Events.h"
+
+// Bump whenever the layout below changes. Older logs are rejected rather than guessed at
+#define INPUT_LOG_VERSION 2
+
+// Emulated frames between screen checkpoints, one a second
+#define INPUT_LOG_CHECKPOINT_FRAMES 60
+
+// A session is fully decided by the ROM, the seed, the frame length, the quirk profile and which keys changed on which
+// cycle, so that's all a log holds. Everything is little-endian
+// Header: magic "C8IN", version (4), seed (8), programHash (8), cyclesPerFrame (4), quirks (1)
+// Version 2 replaced the modernCompat flag with the quirk profile
+// Then records, each a type byte, the cycles since the previous record as a LEB128 varint and the type's payload:
+//   0x0K key K released, 0x1K key K pressed, no payload
+//   0x20 checkpoint, hashScreen (8)
+//   0x30 end, chip8Status (1). Always the last record
+// A key change costs two or three bytes, so a long session is a few kilobytes
+typedef enum {
+    INPUT_KEY_UP,
+    INPUT_KEY_DOWN,
+    INPUT_CHECKPOINT,
+    INPUT_END
+} inputRecordType;
+
+typedef struct {
+    inputRecordType type;
+    uint64_t cycle;      // cycleCount the record applies at, before that cycle runs
+    uint8_t key;         // Key up and key down
+    uint64_t screenHash; // Checkpoint
+    chip8Status status;  // End: what stopped the session. A fault happens at cycle without counting it
+} inputRecord;
+
+typedef struct {
+    uint64_t seed;
+    uint64_t programHash; // FNV-1a over memory from 0x200 when the session started, to catch the wrong ROM
+    uint32_t cyclesPerFrame;
+    quirkProfile quirks;
+} inputLogHeader;
+
+typedef struct {
+    FILE *file;
+    uint64_t lastCycle;
+    uint64_t nextCheckpoint;
+    uint64_t lastCheckpoint; // Cycle of the latest checkpoint, so stopping doesn't write the same one twice
+    uint64_t records;
+} inputRecorder;
+
+typedef struct {
+    FILE *file;
+    inputLogHeader header;
+    uint64_t lastCycle;
+} inputReader;
+
+// FNV-1a over the program area of memory
+uint64_t hashProgram(const chip8 *c8);
+
+// Call with a freshly initialized machine, before its first cycle. Returns -1 when the file can't be written
+int startRecording(inputRecorder *r, const char *filename, const chip8 *c8);
+
+// Call before setKey, with the machine at the cycle the change applies at
+void recordKey(inputRecorder *r, const chip8 *c8, uint8_t key, bool pressed);
+
+// Records the screen hash once every INPUT_LOG_CHECKPOINT_FRAMES frames, call as often as convenient
+void recordCheckpoint(inputRecorder *r, const chip8 *c8);
+
+// Writes a last checkpoint and the end record and closes the file. Returns -1 if any write failed
+int stopRecording(inputRecorder *r, const chip8 *c8, chip8Status status);
+
+// Returns -1 when the file can't be read or isn't a log of this version
+int openInputLog(inputReader *r, const char *filename);
+
+// Returns 1 with the next record, 0 at the end of the file, -1 when the file is cut short or malformed
+int readInputRecord(inputReader *r, inputRecord *record);
+
+void closeInputLog(inputReader *r);
+
+#endif // INPUTLOG_H_INCLUDE
@@ -0,0 +1,1026 @@
+#ifndef JIT_C_INCLUDE
+#define JIT_C_INCLUDE
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "Chip8.c"
+#include "Jit.h"
+
+enum {
+    BLOCK_UNTRANSLATED = 0,
+    BLOCK_TRANSLATED,
+    BLOCK_INTERPRET // The first instruction can't be translated, always hand it to emulateCycle
+};
+
+// Blocks are capped so a translation always fits in the space reserved for it, and so invalidation
+// only has to look this far back from a written address
+#define JIT_MAX_BLOCK_LENGTH 64
+#define JIT_MAX_BLOCK_BYTES  (JIT_MAX_BLOCK_LENGTH * 2)
+#define JIT_MAX_BLOCK_CODE   65536 // 64 FF55, each with two exits, come to about 24K
+
+// Throws away every block that was translated from any byte in [first, last]
+static void invalidateJit(jitCache *jit, int first, int last) {
+    int from = first - JIT_MAX_BLOCK_BYTES + 1;
+    from = from > 0 ? from : 0;
+    last = last < 4095 ? last : 4095;
+    for(int start = from; start <= last; start++) {
+        jitBlock *block = &jit->blocks[start];
+        if(block->state == BLOCK_TRANSLATED && start + block->bytes > first) {
+            // Blocks chaining here load run every time, so clearing it also unlinks them
+            block->run = NULL;
+            block->state = BLOCK_UNTRANSLATED;
+        }
+    }
+}
+
+#if defined(__x86_64__)
+
+// EMITTER =========================================================================
+// Register use inside a block:
+//   rbx     chip8 pointer
+//   ebp     I, zero extended
+//   r8-r15  up to 8 V registers, low byte only
+//   al/cl/dl scratch
+typedef struct {
+    uint8_t *p;
+} emitter;
+
+enum {
+    REG_AL = 0,
+    REG_CL = 1,
+    REG_DL = 2
+};
+
+// Condition codes for setcc/jcc
+enum {
+    CC_B  = 0x2, // Carry / borrow
+    CC_AE = 0x3, // No carry / no borrow
+    CC_E  = 0x4,
+    CC_NE = 0x5,
+    CC_A  = 0x7
+};
+
+// Group 1 opcodes for "op r/m8, r8"
+enum {
+    ALU_ADD = 0x00,
+    ALU_OR  = 0x08,
+    ALU_AND = 0x20,
+    ALU_SUB = 0x28,
+    ALU_XOR = 0x30,
+    ALU_CMP = 0x38
+};
+
+static void emit8(emitter *e, uint8_t b) {
+    *e->p++ = b;
+}
+
+static void emit16(emitter *e, uint16_t w) {
+    memcpy(e->p, &w, 2);
+    e->p += 2;
+}
+
+static void emit32(emitter *e, uint32_t d) {
+    memcpy(e->p, &d, 4);
+    e->p += 4;
+}
+
+// REX is always emitted for byte registers so encodings 4-7 mean spl..dil, which are never used
+static void emitRex(emitter *e, int reg, int rm) {
+    emit8(e, 0x40 | (reg >= 8 ? 4 : 0) | (rm >= 8 ? 1 : 0));
+}
+
+// modrm for [rbx + disp32]
+static void emitRbxOperand(emitter *e, int reg, uint32_t offset) {
+    emit8(e, 0x80 | ((reg & 7) << 3) | 3);
+    emit32(e, offset);
+}
+
+// movzx reg32, byte [rbx + offset]
+static void emitLoadByte(emitter *e, int reg, uint32_t offset) {
+    emitRex(e, reg, 0);
+    emit8(e, 0x0F);
+    emit8(e, 0xB6);
+    emitRbxOperand(e, reg, offset);
+}
+
+// mov byte [rbx + offset], reg8
+static void emitStoreByte(emitter *e, int reg, uint32_t offset) {
+    emitRex(e, reg, 0);
+    emit8(e, 0x88);
+    emitRbxOperand(e, reg, offset);
+}
+
+// mov word [rbx + offset], imm16
+static void emitStoreWordImmediate(emitter *e, uint32_t offset, uint16_t value) {
+    emit8(e, 0x66);
+    emit8(e, 0xC7);
+    emitRbxOperand(e, 0, offset);
+    emit16(e, value);
+}
+
+// op dst8, src8
+static void emitAlu(emitter *e, int op, int dst, int src) {
+    emitRex(e, src, dst);
+    emit8(e, op);
+    emit8(e, 0xC0 | ((src & 7) << 3) | (dst & 7));
+}
+
+static void emitMove(emitter *e, int dst, int src) {
+    emitAlu(e, 0x88, dst, src);
+}
+
+// mov dst8, imm8
+static void emitMoveImmediate(emitter *e, int dst, uint8_t value) {
+    emitRex(e, 0, dst);
+    emit8(e, 0xB0 | (dst & 7));
+    emit8(e, value);
+}
+
+// 0x80 group: 0 = add, 4 = and, 7 = cmp
+static void emitAluImmediate(emitter *e, int extension, int dst, uint8_t value) {
+    emitRex(e, 0, dst);
+    emit8(e, 0x80);
+    emit8(e, 0xC0 | (extension << 3) | (dst & 7));
+    emit8(e, value);
+}
+
+// Shift group: 4 = shl, 5 = shr
+static void emitShift(emitter *e, int extension, int dst, uint8_t count) {
+    emitRex(e, 0, dst);
+    emit8(e, count == 1 ? 0xD0 : 0xC0);
+    emit8(e, 0xC0 | (extension << 3) | (dst & 7));
+    if(count != 1) {
+        emit8(e, count);
+    }
+}
+
+static void emitSetcc(emitter *e, int cc, int dst) {
+    emitRex(e, 0, dst);
+    emit8(e, 0x0F);
+    emit8(e, 0x90 | cc);
+    emit8(e, 0xC0 | (dst & 7));
+}
+
+// mov byte [rbx + rbp + memory + offset], reg8, a store to memory[I + offset]
+static void emitStoreMemoryByte(emitter *e, int reg, uint32_t offset) {
+    emitRex(e, reg, 0);
+    emit8(e, 0x88);
+    emit8(e, 0x84 | ((reg & 7) << 3));
+    emit8(e, 0x2B);
+    emit32(e, offsetof(chip8, memory) + offset);
+}
+
+// movzx reg, byte [rbx + rbp + memory + offset], a load from memory[I + offset]
+static void emitLoadMemoryByte(emitter *e, int reg, uint32_t offset) {
+    emitRex(e, reg, 0);
+    emit8(e, 0x0F); emit8(e, 0xB6);
+    emit8(e, 0x84 | ((reg & 7) << 3));
+    emit8(e, 0x2B);
+    emit32(e, offsetof(chip8, memory) + offset);
+}
+
+// movzx eax, src8
+static void emitZeroExtendToEax(emitter *e, int src) {
+    emitRex(e, 0, src);
+    emit8(e, 0x0F);
+    emit8(e, 0xB6);
+    emit8(e, 0xC0 | (src & 7));
+}
+
+// jcc rel32, returns where to patch the target in
+static uint8_t *emitJcc(emitter *e, int cc) {
+    emit8(e, 0x0F);
+    emit8(e, 0x80 | cc);
+    uint8_t *patch = e->p;
+    emit32(e, 0);
+    return patch;
+}
+
+static void patchJump(uint8_t *patch, uint8_t *target) {
+    int32_t rel = (int32_t) (target - (patch + 4));
+    memcpy(patch, &rel, 4);
+}
+
+// TRANSLATION =====================================================================
+typedef enum {
+    KIND_NONE,     // Not translated, ends the block before this instruction
+    KIND_STRAIGHT, // Falls through to the next instruction
+    KIND_JUMP,     // 1NNN, 2NNN
+    KIND_DYNAMIC,  // 00EE, BNNN
+    KIND_SKIP      // 3XNN, 4XNN, 5XY0, 9XY0, EX9E, EXA1
+} instructionKind;
+
+// Works out whether an opcode can be translated, which V registers it touches and whether it touches a timer
+// The quirks are settled here and in emitStraight, so the code for a block has them built in
+static instructionKind classify(uint16_t opcode, uint16_t *regsUsed, bool *usesTimer, const chip8Quirks *q) {
+    uint16_t x = 1 << ((opcode & 0x0F00) >> 8);
+    uint16_t y = 1 << ((opcode & 0x00F0) >> 4);
+    uint16_t f = 1 << 0xF;
+    *regsUsed = 0;
+    *usesTimer = false;
+
+    switch(opcode & 0xF000) {
+        case 0x0000:
+            return opcode == 0x00EE ? KIND_DYNAMIC : KIND_NONE;
+        case 0x1000:
+        case 0x2000:
+            return KIND_JUMP;
+        case 0x3000:
+        case 0x4000:
+            *regsUsed = x;
+            return KIND_SKIP;
+        case 0x5000:
+        case 0x9000:
+            *regsUsed = x | y;
+            return KIND_SKIP;
+        case 0x6000:
+        case 0x7000:
+            *regsUsed = x;
+            return KIND_STRAIGHT;
+        case 0x8000:
+            switch(opcode & 0x000F) {
+                case 0x0:
+                    *regsUsed = x | y;
+                    return KIND_STRAIGHT;
+                case 0x1:
+                case 0x2:
+                case 0x3:
+                    *regsUsed = q->vfReset ? (x | y | f) : (x | y);
+                    return KIND_STRAIGHT;
+                case 0x4:
+                case 0x5:
+                case 0x7:
+                    *regsUsed = x | y | f;
+                    return KIND_STRAIGHT;
+                case 0x6:
+                case 0xE:
+                    *regsUsed = q->shiftVy ? (x | y | f) : (x | f);
+                    return KIND_STRAIGHT;
+            }
+            return KIND_NONE;
+        case 0xA000:
+            return KIND_STRAIGHT;
+        case 0xB000:
+            *regsUsed = q->jumpVx ? x : 1 << 0;
+            return KIND_DYNAMIC;
+        case 0xE000:
+            if((opcode & 0x00FF) == 0x9E || (opcode & 0x00FF) == 0xA1) {
+                *regsUsed = x;
+                return KIND_SKIP;
+            }
+            return KIND_NONE;
+        case 0xF000:
+            switch(opcode & 0x00FF) {
+                case 0x07:
+                case 0x15:
+                case 0x18:
+                    *regsUsed = x;
+                    *usesTimer = true;
+                    return KIND_STRAIGHT;
+                case 0x1E:
+                    *regsUsed = x | f;
+                    return KIND_STRAIGHT;
+                case 0x29:
+                case 0x33:
+                    *regsUsed = x;
+                    return KIND_STRAIGHT;
+                case 0x55:
+                case 0x65:
+                    // V0 to VX, but those without a host register are copied straight between V and memory
+                    *regsUsed = 0;
+                    return KIND_STRAIGHT;
+            }
+            return KIND_NONE;
+    }
+    return KIND_NONE;
+}
+
+// A check that sends the block back to the host before an instruction only emulateCycle can run,
+// one that would fault or one that has to tell the frontend something
+typedef struct {
+    uint8_t *patch;      // Jump to point at the bail code
+    int      executed;   // Instructions run before the one the host runs
+    uint16_t dirty;      // V registers written by then
+    uint16_t lastOpcode; // Last instruction run, for c8->opcode
+} hostCheck;
+
+typedef struct {
+    emitter e;
+    int8_t   host[16]; // Host register holding each V register, -1 when the block doesn't use it
+    uint16_t dirty;    // V registers written by the block
+    int      length;
+    hostCheck checks[JIT_MAX_BLOCK_LENGTH * 2]; // FX33 and FX55 take two
+    int      checkCount;
+} blockContext;
+
+// Shared code at the start of the buffer
+//   enter(c8, budget, entry): saves registers, loads I and the cycles left until the next tick, jumps to a block
+//   exit: stores I and frameCycle, returns the unused budget
+// Blocks jump straight from one to the next while esi (budget) and edi (cycles to the next tick) allow it
+static void emitTrampolines(jitCache *jit) {
+    emitter e = {jit->code};
+
+    // push rbx, rbp, r12, r13, r14, r15
+    emit8(&e, 0x53);
+    emit8(&e, 0x55);
+    emit8(&e, 0x41); emit8(&e, 0x54);
+    emit8(&e, 0x41); emit8(&e, 0x55);
+    emit8(&e, 0x41); emit8(&e, 0x56);
+    emit8(&e, 0x41); emit8(&e, 0x57);
+    emit8(&e, 0x48); emit8(&e, 0x89); emit8(&e, 0xFB); // mov rbx, rdi
+    emit8(&e, 0x0F); emit8(&e, 0xB7);                  // movzx ebp, word [rbx + I]
+    emitRbxOperand(&e, 5, offsetof(chip8, I));
+    emit8(&e, 0x8B);                                   // mov edi, [rbx + cyclesPerFrame]
+    emitRbxOperand(&e, 7, offsetof(chip8, cyclesPerFrame));
+    emit8(&e, 0x2B);                                   // sub edi, [rbx + frameCycle]
+    emitRbxOperand(&e, 7, offsetof(chip8, frameCycle));
+    emit8(&e, 0xFF); emit8(&e, 0xE2);                  // jmp rdx
+
+    jit->exit = e.p;
+    emit8(&e, 0x66); emit8(&e, 0x89);                  // mov word [rbx + I], bp
+    emitRbxOperand(&e, 5, offsetof(chip8, I));
+    emit8(&e, 0x8B);                                   // mov eax, [rbx + cyclesPerFrame]
+    emitRbxOperand(&e, 0, offsetof(chip8, cyclesPerFrame));
+    emit8(&e, 0x29); emit8(&e, 0xF8);                  // sub eax, edi
+    emit8(&e, 0x89);                                   // mov [rbx + frameCycle], eax
+    emitRbxOperand(&e, 0, offsetof(chip8, frameCycle));
+    emit8(&e, 0x89); emit8(&e, 0xF0);                  // mov eax, esi
+
+    // pop r15, r14, r13, r12, rbp, rbx; ret
+    emit8(&e, 0x41); emit8(&e, 0x5F);
+    emit8(&e, 0x41); emit8(&e, 0x5E);
+    emit8(&e, 0x41); emit8(&e, 0x5D);
+    emit8(&e, 0x41); emit8(&e, 0x5C);
+    emit8(&e, 0x5D);
+    emit8(&e, 0x5B);
+    emit8(&e, 0xC3);
+
+    jit->codeUsed = e.p - jit->code;
+}
+
+void resetJit(jitCache *jit) {
+    memset(jit->blocks, 0, sizeof(jit->blocks));
+    memset(jit->translated, 0, sizeof(jit->translated));
+    mprotect(jit->code, JIT_CODE_SIZE, PROT_READ | PROT_WRITE);
+    emitTrampolines(jit);
+    mprotect(jit->code, JIT_CODE_SIZE, PROT_READ | PROT_EXEC);
+}
+
+// jmp rel32 to the shared exit
+static void emitJumpToExit(jitCache *jit, emitter *e) {
+    emit8(e, 0xE9);
+    uint8_t *patch = e->p;
+    emit32(e, 0);
+    patchJump(patch, jit->exit);
+}
+
+// Leaves the block for pc. Stores the block's registers, accounts for its cycles, ticks the timers if a frame ended
+// (unless the sound timer is running, which the host handles) and then jumps straight into the block at pc if there is one
+// For a dynamic exit (00EE, BNNN) the block has already stored the new programCounter and pc is ignored
+static void emitExit(jitCache *jit, blockContext *b, uint16_t pc, uint16_t lastOpcode, bool dynamic) {
+    emitter *e = &b->e;
+    for(int i = 0; i < 16; i++) {
+        if(b->dirty & (1 << i)) {
+            emitStoreByte(e, b->host[i], offsetof(chip8, V) + i);
+        }
+    }
+    emitStoreWordImmediate(e, offsetof(chip8, opcode), lastOpcode);
+
+    emit8(e, 0x81); emit8(e, 0xEE); emit32(e, b->length); // sub esi, length
+    emit8(e, 0x81); emit8(e, 0xEF); emit32(e, b->length); // sub edi, length
+    uint8_t *noTick = emitJcc(e, 0xF);                     // jg
+
+    uint8_t *tick = e->p;
+    emit8(e, 0x80);                                        // cmp byte [rbx + soundTimer], 0
+    emitRbxOperand(e, 7, offsetof(chip8, soundTimer));
+    emit8(e, 0x00);
+    uint8_t *soundRunning = emitJcc(e, CC_NE);
+    emit8(e, 0x03);                                        // add edi, [rbx + cyclesPerFrame]
+    emitRbxOperand(e, 7, offsetof(chip8, cyclesPerFrame));
+    emit8(e, 0x80);                                        // cmp byte [rbx + delayTimer], 0
+    emitRbxOperand(e, 7, offsetof(chip8, delayTimer));
+    emit8(e, 0x00);
+    emit8(e, 0x74); emit8(e, 0x06);                        // je +6
+    emit8(e, 0xFE);                                        // dec byte [rbx + delayTimer]
+    emitRbxOperand(e, 1, offsetof(chip8, delayTimer));
+    emit8(e, 0x85); emit8(e, 0xFF);                        // test edi, edi
+    uint8_t *again = emitJcc(e, 0xE);                      // jle tick
+    patchJump(again, tick);
+
+    // Jumps outside memory always go back to the host so it can report them
+    patchJump(noTick, e->p);
+    uint8_t *missing = NULL;
+    uint8_t *outside = NULL;
+    if(dynamic) {
+        emit8(e, 0x0F); emit8(e, 0xB7);                    // movzx eax, word [rbx + programCounter]
+        emitRbxOperand(e, 0, offsetof(chip8, programCounter));
+        emit8(e, 0x3D); emit32(e, 4096);                   // cmp eax, 4096
+        outside = emitJcc(e, CC_AE);
+        emit8(e, 0xC1); emit8(e, 0xE0); emit8(e, 4);       // shl eax, 4 (sizeof(jitBlock))
+        emit8(e, 0x48); emit8(e, 0xB9);                    // mov rcx, &blocks[0].run
+        uint64_t table = (uint64_t) (uintptr_t) &jit->blocks[0].run;
+        memcpy(e->p, &table, 8);
+        e->p += 8;
+        emit8(e, 0x48); emit8(e, 0x8B); emit8(e, 0x04); emit8(e, 0x01); // mov rax, [rcx + rax]
+        emit8(e, 0x48); emit8(e, 0x85); emit8(e, 0xC0);    // test rax, rax
+        missing = emitJcc(e, CC_E);
+        emit8(e, 0xFF); emit8(e, 0xE0);                    // jmp rax
+    } else if(pc < 4096) {
+        emit8(e, 0x48); emit8(e, 0xB8);                    // mov rax, &blocks[pc].run
+        uint64_t slot = (uint64_t) (uintptr_t) &jit->blocks[pc].run;
+        memcpy(e->p, &slot, 8);
+        e->p += 8;
+        emit8(e, 0x48); emit8(e, 0x8B); emit8(e, 0x00);    // mov rax, [rax]
+        emit8(e, 0x48); emit8(e, 0x85); emit8(e, 0xC0);    // test rax, rax
+        missing = emitJcc(e, CC_E);
+        emit8(e, 0xFF); emit8(e, 0xE0);                    // jmp rax
+    }
+
+    uint8_t *toHost = e->p;
+    patchJump(soundRunning, toHost);
+    if(missing) {
+        patchJump(missing, toHost);
+    }
+    if(outside) {
+        patchJump(outside, toHost);
+    }
+    if(!dynamic) {
+        emitStoreWordImmediate(e, offsetof(chip8, programCounter), pc);
+    }
+    emitJumpToExit(jit, e);
+}
+
+// Sets the flags for a store to memory[I] to memory[I + span]: nonzero when it would hit translated code
+// mov rdx, translated; mov eax, ebp; shr eax, 3; mov eax, [rdx + rax]; mov ecx, ebp; and ecx, 7; shr eax, cl; test eax, mask
+static void emitTranslatedTest(jitCache *jit, emitter *e, int span) {
+    emit8(e, 0x48); emit8(e, 0xBA);
+    uint64_t table = (uint64_t) (uintptr_t) jit->translated;
+    memcpy(e->p, &table, 8);
+    e->p += 8;
+    emit8(e, 0x89); emit8(e, 0xE8);
+    emit8(e, 0xC1); emit8(e, 0xE8); emit8(e, 3);
+    emit8(e, 0x8B); emit8(e, 0x04); emit8(e, 0x02);
+    emit8(e, 0x89); emit8(e, 0xE9);
+    emit8(e, 0x83); emit8(e, 0xE1); emit8(e, 7);
+    emit8(e, 0xD3); emit8(e, 0xE8);
+    emit8(e, 0xA9); emit32(e, (2u << span) - 1);
+}
+
+// Records a jump, just emitted, that is taken when the instruction at index `executed` has to go to the host
+static void addHostCheck(blockContext *b, uint8_t *patch, int executed, uint16_t lastOpcode) {
+    hostCheck *check = &b->checks[b->checkCount++];
+    check->patch      = patch;
+    check->executed   = executed;
+    check->dirty      = b->dirty;
+    check->lastOpcode = lastOpcode;
+}
+
+// Bail code for a host check. Accounts for the instructions already run and hands the next one to the host
+// A frame that ended on the way is ticked by the host from frameCycle
+static void emitHostExit(jitCache *jit, blockContext *b, const hostCheck *check, uint16_t pc) {
+    emitter *e = &b->e;
+    patchJump(check->patch, e->p);
+    for(int i = 0; i < 16; i++) {
+        if(check->dirty & (1 << i)) {
+            emitStoreByte(e, b->host[i], offsetof(chip8, V) + i);
+        }
+    }
+    if(check->executed > 0) {
+        emitStoreWordImmediate(e, offsetof(chip8, opcode), check->lastOpcode);
+        emit8(e, 0x81); emit8(e, 0xEE); emit32(e, check->executed); // sub esi, executed
+        emit8(e, 0x81); emit8(e, 0xEF); emit32(e, check->executed); // sub edi, executed
+    }
+    emitStoreWordImmediate(e, offsetof(chip8, programCounter), pc);
+    emitJumpToExit(jit, e);
+}
+
+// Emits one straight-line instruction. The statements follow emulateCycle in order so X or Y == F gives the same result
+static void emitStraight(blockContext *b, uint16_t opcode, const chip8Quirks *q) {
+    emitter *e = &b->e;
+    int x  = b->host[(opcode & 0x0F00) >> 8];
+    int y  = b->host[(opcode & 0x00F0) >> 4];
+    int vf = b->host[0xF];
+    uint8_t nn = opcode & 0x00FF;
+
+    switch(opcode & 0xF000) {
+        case 0x6000:
+            emitMoveImmediate(e, x, nn);
+            return;
+        case 0x7000:
+            emitAluImmediate(e, 0, x, nn);
+            return;
+        case 0xA000:
+            // mov ebp, imm32
+            emit8(e, 0xBD);
+            emit32(e, opcode & 0x0FFF);
+            return;
+        case 0xF000:
+            switch(nn) {
+                case 0x07:
+                    emitLoadByte(e, x, offsetof(chip8, delayTimer));
+                    return;
+                case 0x15:
+                    emitStoreByte(e, x, offsetof(chip8, delayTimer));
+                    return;
+                case 0x18:
+                    emitStoreByte(e, x, offsetof(chip8, soundTimer));
+                    return;
+                case 0x1E:
+                    // VF = (I + VX) > 0xFFF, then I += VX (re-read in case X is F)
+                    emitZeroExtendToEax(e, x);
+                    emit8(e, 0x01); emit8(e, 0xE8);                 // add eax, ebp
+                    emit8(e, 0x3D); emit32(e, 0xFFF);               // cmp eax, 0xFFF
+                    emitSetcc(e, CC_A, REG_DL);
+                    emitMove(e, vf, REG_DL);
+                    emitZeroExtendToEax(e, x);
+                    emit8(e, 0x01); emit8(e, 0xC5);                 // add ebp, eax
+                    emit8(e, 0x0F); emit8(e, 0xB7); emit8(e, 0xED); // movzx ebp, bp
+                    return;
+                case 0x29:
+                    // I = VX * 5
+                    emitZeroExtendToEax(e, x);
+                    emit8(e, 0x8D); emit8(e, 0x2C); emit8(e, 0x80); // lea ebp, [rax + rax * 4]
+                    return;
+                case 0x33:
+                    // memory[I...] = the hundreds, tens and ones of VX, through div: al = ax / dl, ah = ax % dl
+                    emitZeroExtendToEax(e, x);
+                    emitMoveImmediate(e, REG_DL, 100);
+                    emit8(e, 0xF6); emit8(e, 0xF2);                 // div dl
+                    emitStoreMemoryByte(e, REG_AL, 0);
+                    emit8(e, 0x0F); emit8(e, 0xB6); emit8(e, 0xC4); // movzx eax, ah
+                    emitMoveImmediate(e, REG_DL, 10);
+                    emit8(e, 0xF6); emit8(e, 0xF2);                 // div dl
+                    emitStoreMemoryByte(e, REG_AL, 1);
+                    emit8(e, 0x88); emit8(e, 0xE0);                 // mov al, ah
+                    emitStoreMemoryByte(e, REG_AL, 2);
+                    return;
+                case 0x55:
+                case 0x65: {
+                    // FX55 stores V0 to VX at memory[I...], FX65 loads them from there
+                    // I then moves on by X + 1, or as the memory quirk says
+                    int last = (opcode & 0x0F00) >> 8;
+                    int advance = q->memory == MEMORY_I_PLUS_X_PLUS_1 ? last + 1 : q->memory == MEMORY_I_PLUS_X ? last : 0;
+                    for(int i = 0; i <= last; i++) {
+                        if(b->host[i] < 0) {
+                            // Not in the block's registers, copy through al
+                            if(nn == 0x55) {
+                                emitLoadByte(e, REG_AL, offsetof(chip8, V) + i);
+                                emitStoreMemoryByte(e, REG_AL, i);
+                            } else {
+                                emitLoadMemoryByte(e, REG_AL, i);
+                                emitStoreByte(e, REG_AL, offsetof(chip8, V) + i);
+                            }
+                        } else if(nn == 0x55) {
+                            emitStoreMemoryByte(e, b->host[i], i);
+                        } else {
+                            emitLoadMemoryByte(e, b->host[i], i);
+                        }
+                    }
+                    if(advance > 0) {
+                        emit8(e, 0x81); emit8(e, 0xC5); emit32(e, advance); // add ebp, advance
+                        emit8(e, 0x0F); emit8(e, 0xB7); emit8(e, 0xED);     // movzx ebp, bp
+                    }
+                    return;
+                }
+            }
+            return;
+    }
+
+    // 8XYN
+    switch(opcode & 0x000F) {
+        case 0x0:
+            emitMove(e, x, y);
+            return;
+        case 0x1:
+            emitAlu(e, ALU_OR, x, y);
+            if(q->vfReset) {
+                emitMoveImmediate(e, vf, 0);
+            }
+            return;
+        case 0x2:
+            emitAlu(e, ALU_AND, x, y);
+            if(q->vfReset) {
+                emitMoveImmediate(e, vf, 0);
+            }
+            return;
+        case 0x3:
+            emitAlu(e, ALU_XOR, x, y);
+            if(q->vfReset) {
+                emitMoveImmediate(e, vf, 0);
+            }
+            return;
+        case 0x4:
+            // VF = carry out of VX + VY, then VX += VY
+            emitMove(e, REG_AL, x);
+            emitAlu(e, ALU_ADD, REG_AL, y);
+            emitSetcc(e, CC_B, REG_CL);
+            emitMove(e, vf, REG_CL);
+            emitAlu(e, ALU_ADD, x, y);
+            return;
+        case 0x5:
+            // VF = no borrow from VX - VY, then VX -= VY
+            emitAlu(e, ALU_CMP, x, y);
+            emitSetcc(e, CC_AE, REG_CL);
+            emitMove(e, vf, REG_CL);
+            emitAlu(e, ALU_SUB, x, y);
+            return;
+        case 0x7:
+            // VF = no borrow from VY - VX, then VX = VY - VX
+            emitAlu(e, ALU_CMP, y, x);
+            emitSetcc(e, CC_AE, REG_CL);
+            emitMove(e, vf, REG_CL);
+            emitMove(e, REG_AL, y);
+            emitAlu(e, ALU_SUB, REG_AL, x);
+            emitMove(e, x, REG_AL);
+            return;
+        case 0x6:
+        case 0xE: {
+            int source = q->shiftVy ? y : x;
+            bool right = (opcode & 0x000F) == 0x6;
+            emitMove(e, REG_AL, source);
+            if(right) {
+                emitAluImmediate(e, 4, REG_AL, 1);
+            } else {
+                emitShift(e, 5, REG_AL, 7);
+            }
+            emitMove(e, vf, REG_AL);
+            emitShift(e, right ? 5 : 4, source, 1);
+            if(q->shiftVy) {
+                emitMove(e, x, y);
+            }
+            return;
+        }
+    }
+}
+
+// V registers an instruction writes
+static uint16_t writtenRegisters(uint16_t opcode, const chip8Quirks *q) {
+    uint16_t x = 1 << ((opcode & 0x0F00) >> 8);
+    uint16_t y = 1 << ((opcode & 0x00F0) >> 4);
+    uint16_t f = 1 << 0xF;
+
+    switch(opcode & 0xF000) {
+        case 0x6000:
+        case 0x7000:
+            return x;
+        case 0x8000:
+            switch(opcode & 0x000F) {
+                case 0x6:
+                case 0xE:
+                    return q->shiftVy ? (x | y | f) : (x | f);
+                case 0x1:
+                case 0x2:
+                case 0x3:
+                    return q->vfReset ? (x | f) : x;
+                case 0x4:
+                case 0x5:
+                case 0x7:
+                    return x | f;
+            }
+            return x;
+        case 0xF000:
+            switch(opcode & 0x00FF) {
+                case 0x07:
+                    return x;
+                case 0x1E:
+                    return f;
+                case 0x65:
+                    return (x << 1) - 1;
+            }
+            return 0;
+    }
+    return 0;
+}
+
+// Emits the compare for a skip. The returned jump is taken when the next instruction should be skipped
+static uint8_t *emitSkipTest(blockContext *b, uint16_t opcode) {
+    emitter *e = &b->e;
+    int x = b->host[(opcode & 0x0F00) >> 8];
+    int y = b->host[(opcode & 0x00F0) >> 4];
+
+    switch(opcode & 0xF000) {
+        case 0x3000:
+            emitAluImmediate(e, 7, x, opcode & 0x00FF);
+            return emitJcc(e, CC_E);
+        case 0x4000:
+            emitAluImmediate(e, 7, x, opcode & 0x00FF);
+            return emitJcc(e, CC_NE);
+        case 0x5000:
+            emitAlu(e, ALU_CMP, x, y);
+            return emitJcc(e, CC_E);
+        case 0x9000:
+            emitAlu(e, ALU_CMP, x, y);
+            return emitJcc(e, CC_NE);
+    }
+
+    // EX9E / EXA1: and eax, 0xF then cmp byte [rbx + rax + keys], 0. Only the low nibble of VX picks the key
+    emitZeroExtendToEax(e, x);
+    emit8(e, 0x83);
+    emit8(e, 0xE0);
+    emit8(e, 0x0F);
+    emit8(e, 0x80);
+    emit8(e, 0xBC);
+    emit8(e, 0x03);
+    emit32(e, offsetof(chip8, keys));
+    emit8(e, 0x00);
+    return emitJcc(e, (opcode & 0x00FF) == 0x9E ? CC_NE : CC_E);
+}
+
+static void translateBlock(jitCache *jit, const chip8 *c8, uint16_t start) {
+    jitBlock *block = &jit->blocks[start];
+    const chip8Quirks *q = &quirkProfiles[c8->quirks];
+
+    // Scan ahead to find where the block ends, which registers it needs, and the last instruction touching a timer
+    blockContext b;
+    memset(&b, 0, sizeof(b));
+    memset(b.host, -1, sizeof(b.host));
+
+    uint16_t regs = 0;
+    uint16_t address = start;
+    uint16_t terminator = 0;
+    instructionKind kind = KIND_NONE;
+    int timerPosition = 0;
+    while(b.length < JIT_MAX_BLOCK_LENGTH && address < 4095) {
+        uint16_t opcode = (c8->memory[address] << 8) | c8->memory[address + 1];
+        uint16_t used;
+        bool usesTimer;
+        kind = classify(opcode, &used, &usesTimer, q);
+        if(kind == KIND_NONE || __builtin_popcount(regs | used) > 8) {
+            kind = KIND_NONE;
+            break;
+        }
+        regs |= used;
+        b.length++;
+        if(usesTimer) {
+            timerPosition = b.length;
+        }
+        address += 2;
+        if(kind != KIND_STRAIGHT) {
+            terminator = opcode;
+            break;
+        }
+    }
+    if(kind == KIND_STRAIGHT) {
+        // Cut off by the length cap or the end of memory, the last instruction is an ordinary one and the block just falls through
+        kind = KIND_NONE;
+    }
+
+    if(b.length == 0) {
+        block->state = BLOCK_INTERPRET;
+        return;
+    }
+
+    if(jit->codeUsed + JIT_MAX_BLOCK_CODE > JIT_CODE_SIZE) {
+        resetJit(jit);
+    }
+    mprotect(jit->code, JIT_CODE_SIZE, PROT_READ | PROT_WRITE);
+
+    uint8_t *entry = jit->code + jit->codeUsed;
+    b.e.p = entry;
+    emitter *e = &b.e;
+
+    // Enough budget left for the whole block? cmp esi, length; jl bail
+    emit8(e, 0x81); emit8(e, 0xFE); emit32(e, b.length);
+    uint8_t *noBudget = emitJcc(e, 0xC);
+    // A timer access must come before the next tick: cmp edi, timerPosition; jl bail
+    uint8_t *tickFirst = NULL;
+    if(timerPosition > 0) {
+        emit8(e, 0x81); emit8(e, 0xFF); emit32(e, timerPosition);
+        tickFirst = emitJcc(e, 0xC);
+    }
+
+    int nextHost = 8;
+    for(int i = 0; i < 16; i++) {
+        if(regs & (1 << i)) {
+            b.host[i] = nextHost++;
+            emitLoadByte(e, b.host[i], offsetof(chip8, V) + i);
+        }
+    }
+
+    // Body. Every instruction except a jump or skip at the end is straight-line
+    uint16_t lastOpcode = 0;
+    int straight = (kind == KIND_NONE) ? b.length : b.length - 1;
+    for(int i = 0; i < straight; i++) {
+        uint16_t at = start + i * 2;
+        uint16_t opcode = (c8->memory[at] << 8) | c8->memory[at + 1];
+        if((opcode & 0xF0FF) == 0xF065 || (opcode & 0xF0FF) == 0xF055 || (opcode & 0xF0FF) == 0xF033) {
+            // I + X past the end of memory: lea eax, [rbp + X]; cmp eax, 0xFFF; ja bail
+            int span = (opcode & 0x00FF) == 0x33 ? 2 : (opcode & 0x0F00) >> 8;
+            emit8(e, 0x8D); emit8(e, 0x45); emit8(e, span);
+            emit8(e, 0x3D); emit32(e, 0xFFF);
+            addHostCheck(&b, emitJcc(e, CC_A), i, lastOpcode);
+            if((opcode & 0x00FF) != 0x65) {
+                emitTranslatedTest(jit, e, span);
+                addHostCheck(&b, emitJcc(e, CC_NE), i, lastOpcode);
+            }
+        } else if((opcode & 0xF0FF) == 0xF018) {
+            // Only emulateCycle queues tones: cmp qword [rbx + audio], 0; jne bail
+            emit8(e, 0x48); emit8(e, 0x83);
+            emitRbxOperand(e, 7, offsetof(chip8, audio));
+            emit8(e, 0x00);
+            addHostCheck(&b, emitJcc(e, CC_NE), i, lastOpcode);
+        }
+        emitStraight(&b, opcode, q);
+        b.dirty |= writtenRegisters(opcode, q) & regs; // FX65 writes the others straight to V
+        lastOpcode = opcode;
+    }
+
+    uint16_t end = start + straight * 2;
+    if(kind == KIND_NONE) {
+        // Ran into something untranslatable, carry on from just before it
+        emitExit(jit, &b, end, lastOpcode, false);
+    } else if(kind == KIND_JUMP) {
+        if((terminator & 0xF000) == 0x2000) {
+            // stack[stackPointer++] = pc, unless the stack is full
+            emit8(e, 0x0F); emit8(e, 0xB7);                         // movzx eax, word [rbx + stackPointer]
+            emitRbxOperand(e, 0, offsetof(chip8, stackPointer));
+            emit8(e, 0x83); emit8(e, 0xF8); emit8(e, 24);           // cmp eax, 24
+            addHostCheck(&b, emitJcc(e, CC_AE), straight, lastOpcode);
+            emit8(e, 0x66); emit8(e, 0xC7); emit8(e, 0x84); emit8(e, 0x43); // mov word [rbx + rax * 2 + stack], end
+            emit32(e, offsetof(chip8, stack));
+            emit16(e, end);
+            emit8(e, 0x66); emit8(e, 0xFF);                         // inc word [rbx + stackPointer]
+            emitRbxOperand(e, 0, offsetof(chip8, stackPointer));
+        }
+        emitExit(jit, &b, terminator & 0x0FFF, terminator, false);
+    } else if(kind == KIND_DYNAMIC) {
+        if(terminator == 0x00EE) {
+            // programCounter = stack[--stackPointer] + 2, unless the stack is empty or overrun
+            emit8(e, 0x0F); emit8(e, 0xB7);                         // movzx eax, word [rbx + stackPointer]
+            emitRbxOperand(e, 0, offsetof(chip8, stackPointer));
+            emit8(e, 0x83); emit8(e, 0xE8); emit8(e, 0x01);         // sub eax, 1
+            emit8(e, 0x83); emit8(e, 0xF8); emit8(e, 24);           // cmp eax, 24
+            addHostCheck(&b, emitJcc(e, CC_AE), straight, lastOpcode);
+            emit8(e, 0x66); emit8(e, 0xFF);                         // dec word [rbx + stackPointer]
+            emitRbxOperand(e, 1, offsetof(chip8, stackPointer));
+            emit8(e, 0x0F); emit8(e, 0xB7);                         // movzx eax, word [rbx + stackPointer]
+            emitRbxOperand(e, 0, offsetof(chip8, stackPointer));
+            emit8(e, 0x0F); emit8(e, 0xB7); emit8(e, 0x84); emit8(e, 0x43); // movzx eax, word [rbx + rax * 2 + stack]
+            emit32(e, offsetof(chip8, stack));
+            emit8(e, 0x83); emit8(e, 0xC0); emit8(e, 0x02);         // add eax, 2
+        } else {
+            // programCounter = V0 + NNN, or VX + XNN
+            emitZeroExtendToEax(e, b.host[q->jumpVx ? (terminator & 0x0F00) >> 8 : 0]);
+            emit8(e, 0x05); emit32(e, terminator & 0x0FFF);         // add eax, NNN
+        }
+        emit8(e, 0x66); emit8(e, 0x89);                             // mov word [rbx + programCounter], ax
+        emitRbxOperand(e, 0, offsetof(chip8, programCounter));
+        emitExit(jit, &b, 0, terminator, true);
+    } else {
+        uint8_t *skip = emitSkipTest(&b, terminator);
+        emitExit(jit, &b, end + 2, terminator, false);
+        patchJump(skip, e->p);
+        emitExit(jit, &b, end + 4, terminator, false);
+    }
+
+    for(int i = 0; i < b.checkCount; i++) {
+        emitHostExit(jit, &b, &b.checks[i], start + b.checks[i].executed * 2);
+    }
+
+    // Not enough budget or a tick is due: nothing has run yet, hand this block's address to the host
+    patchJump(noBudget, e->p);
+    if(tickFirst) {
+        patchJump(tickFirst, e->p);
+    }
+    emitStoreWordImmediate(e, offsetof(chip8, programCounter), start);
+    emitJumpToExit(jit, e);
+
+    jit->codeUsed += e->p - entry;
+    mprotect(jit->code, JIT_CODE_SIZE, PROT_READ | PROT_EXEC);
+
+    for(int a = start; a < start + b.length * 2; a++) {
+        jit->translated[a / 8] |= 1 << (a % 8);
+    }
+    block->run    = entry;
+    block->bytes  = b.length * 2;
+    block->length = b.length;
+    block->state  = BLOCK_TRANSLATED;
+}
+
+int initJit(jitCache *jit) {
+    jit->code = mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(jit->code == MAP_FAILED) {
+        jit->code = NULL;
+        return -1;
+    }
+    resetJit(jit);
+    return 0;
+}
+
+void freeJit(jitCache *jit) {
+    if(jit->code) {
+        munmap(jit->code, JIT_CODE_SIZE);
+        jit->code = NULL;
+    }
+}
+
+static int enterJit(jitCache *jit, chip8 *c8, int budget, void *entry) {
+    int (*enter)(chip8 *, int, void *) = (int (*)(chip8 *, int, void *)) jit->code;
+    return enter(c8, budget, entry);
+}
+
+#else // No translator for this host, everything goes through emulateCycle
+
+void resetJit(jitCache *jit) {
+    memset(jit->blocks, 0, sizeof(jit->blocks));
+    memset(jit->translated, 0, sizeof(jit->translated));
+    jit->codeUsed = 0;
+}
+
+static int enterJit(jitCache *jit, chip8 *c8, int budget, void *entry) {
+    (void) jit;
+    (void) c8;
+    (void) entry;
+    return budget;
+}
+
+static void translateBlock(jitCache *jit, const chip8 *c8, uint16_t start) {
+    (void) c8;
+    jit->blocks[start].state = BLOCK_INTERPRET;
+}
+
+int initJit(jitCache *jit) {
+    jit->code = NULL;
+    resetJit(jit);
+    return -1;
+}
+
+void freeJit(jitCache *jit) {
+    (void) jit;
+}
+
+#endif // __x86_64__
+
+chip8Status emulateCyclesJit(chip8 *c8, jitCache *jit, uint64_t cycles) {
+    const uint64_t end = c8->cycleCount + cycles;
+
+    // Halted on FX0A, the caller has to resolve the wait with setKey first
+    if(c8->keyWait) {
+        return CHIP8_OK;
+    }
+
+    while(c8->cycleCount < end) {
+        // DXYN went through emulateCycle and is waiting on the next tick
+        if(c8->displayWait) {
+            waitForDisplay(c8, end);
+            continue;
+        }
+        // skipIdle only runs instructions that don't write memory, so every block stays valid
+        if(c8->cycleCount >= c8->idleCheckAt) {
+            skipIdle(c8, end - c8->cycleCount);
+            continue;
+        }
+        uint16_t pc = c8->programCounter;
+
+        // Run translated code for as long as the budget allows, or until it's time to look for an idle loop. Blocks chain into each other and tick the delay timer
+        // themselves, and come back here for untranslated code, a running sound timer, an instruction only emulateCycle
+        // can run, or when the budget runs out. A program counter outside memory has no block and goes to emulateCycle to fault
+        jitBlock *block = pc < 4096 ? &jit->blocks[pc] : NULL;
+        if(block && block->state == BLOCK_UNTRANSLATED) {
+            translateBlock(jit, c8, pc);
+        }
+        if(block && block->state == BLOCK_TRANSLATED && c8->frameCycle < c8->cyclesPerFrame) {
+            uint64_t left = (end < c8->idleCheckAt ? end : c8->idleCheckAt) - c8->cycleCount;
+            int budget = left < INT32_MAX ? (int) left : INT32_MAX;
+            int executed = budget - enterJit(jit, c8, budget, block->run);
+            if(executed > 0) {
+                c8->cycleCount += executed;
+                while(c8->frameCycle >= c8->cyclesPerFrame) {
+                    c8->frameCycle -= c8->cyclesPerFrame;
+                    tickTimers(c8);
+                }
+                continue;
+            }
+        }
+
+        // Everything else goes through the interpreter, including FX33 and FX55 that would write over translated code
+        int first = -1, last = -1;
+        if(pc < 4095 && c8->memory[pc] >> 4 == 0xF) {
+            if(c8->memory[pc + 1] == 0x33) {
+                first = c8->I;
+                last  = c8->I + 2;
+            } else if(c8->memory[pc + 1] == 0x55) {
+                first = c8->I;
+                last  = c8->I + (c8->memory[pc] & 0x0F);
+            }
+        }
+
+        chip8Status status = emulateCycle(c8);
+        if(status != CHIP8_OK) {
+            return status;
+        }
+        if(first != -1) {
+            invalidateJit(jit, first, last);
+        }
+        if(c8->keyWait) {
+            break;
+        }
+    }
+    return CHIP8_OK;
+}
+
+#endif // JIT_C_INCLUDE
@@ -0,0 +1,46 @@
+#ifndef JIT_H_INCLUDE
+#define JIT_H_INCLUDE
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Chip8.h"
+
+// Size of the executable buffer. When it fills up every block is thrown away and translation starts over
+#define JIT_CODE_SIZE (1024 * 1024)
+
+typedef struct {
+    void    *run;           // Native code for the block, NULL when there is none
+    uint16_t bytes;         // Bytes of CHIP-8 code the block was translated from, starting at its address
+    uint8_t  length;        // Instructions executed by one run of the block, including the skip or jump that ends it
+    uint8_t  state;         // BLOCK_UNTRANSLATED, BLOCK_TRANSLATED or BLOCK_INTERPRET
+} jitBlock;
+
+// Generated code indexes the block table by shifting the address
+_Static_assert(sizeof(jitBlock) == 16, "jitBlock must be 16 bytes");
+
+typedef struct {
+    uint8_t *code;     // mmap'd buffer, writable while translating and executable otherwise
+    uint8_t *exit;     // Shared exit stub, blocks jump here to return to C
+    size_t   codeUsed;
+    jitBlock blocks[4096]; // Indexed by start address
+    // Bit a % 8 of byte a / 8 is set once a block is translated from address a. Translated FX33 and FX55 test it and
+    // leave for the host, which invalidates, only when they store over code. Padded so a 32-bit load at any byte fits
+    uint8_t  translated[4096 / 8 + 4];
+} jitCache;
+
+// Returns -1 when there is no JIT for this host or executable memory can't be mapped, callers should fall back to emulateCycle
+int initJit(jitCache *jit);
+void freeJit(jitCache *jit);
+
+// Must be called whenever memory or the quirk profile is changed from outside the engine
+void resetJit(jitCache *jit);
+
+// Runs up to `cycles` cycles, translating straight-line code to x86-64 and interpreting everything else
+// Stops early when FX0A starts a key wait or on a fault, and runs nothing while a wait is pending
+// Idle loops are fast-forwarded through skipIdle
+// Results, faults and events included, are identical to calling emulateCycle the same number of times
+chip8Status emulateCyclesJit(chip8 *c8, jitCache *jit, uint64_t cycles);
+
+#endif // JIT_H_INCLUDE
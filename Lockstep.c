@@ -0,0 +1,962 @@
+#ifndef LOCKSTEP_C_INCLUDE
+#define LOCKSTEP_C_INCLUDE
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Chip8.c"
+#include "Disasm.c"
+#include "Threaded.c"
+#include "Lockstep.h"
+
+// Comparisons on vectors produce 0 or -1 per element in a signed vector of the same shape
+typedef int8_t  laneFlags     __attribute__((vector_size(LOCKSTEP_LANES)));
+typedef int16_t laneWordFlags __attribute__((vector_size(LOCKSTEP_LANES * 2), aligned(16)));
+
+_Static_assert(LOCKSTEP_LANES == 16, "laneBits below has one element per lane");
+
+// The lanes as two 8-byte halves, for moving between vectors and lane sets with plain integer arithmetic
+typedef uint64_t laneHalves __attribute__((vector_size(LOCKSTEP_LANES)));
+
+// Bit n % 8 of a lane set, in lane n
+static const laneBytes laneBits = {
+    1 << 0, 1 << 1, 1 << 2, 1 << 3, 1 << 4, 1 << 5, 1 << 6, 1 << 7,
+    1 << 0, 1 << 1, 1 << 2, 1 << 3, 1 << 4, 1 << 5, 1 << 6, 1 << 7
+};
+
+// Turns a comparison back into a lane set. Each half holds distinct bits, so multiplying adds them all into its top
+// byte without carries
+// Comparisons stay on 16 byte vectors: GCC lowers 32 byte ones element by element unless AVX2 is on
+static inline uint32_t laneSet(laneFlags flags) {
+    laneHalves bits = (laneHalves) ((laneBytes) flags & laneBits);
+    return (bits[0] * 0x0101010101010101ULL) >> 56 | ((bits[1] * 0x0101010101010101ULL) >> 56) << 8;
+}
+
+// The other way, all ones in the lanes set in lanes
+static inline laneFlags laneMask(uint32_t lanes) {
+    laneHalves spread = {(lanes & 0xFF) * 0x0101010101010101ULL, ((lanes >> 8) & 0xFF) * 0x0101010101010101ULL};
+    return (laneFlags) (((laneBytes) spread & laneBits) != 0);
+}
+
+// Lane runs between checks on how well the lanes are keeping together
+#define LOCKSTEP_SPLIT_WINDOW 4096
+
+// Fewest lanes a group has to average for lockstep to beat running the lanes apart, measured on the bundled ROMs
+#define LOCKSTEP_MIN_GROUP 8
+
+// Takes value in the lanes set in mask and keeps old everywhere else
+#define BLEND(old, value, mask) (((old) & ~(mask)) | ((value) & (mask)))
+
+// Visits the index of every set bit in lanes, lowest first
+#define FOR_EACH_LANE(lane, lanes) \
+    for(uint32_t bits_ = (lanes), lane = 0; bits_ && (lane = __builtin_ctz(bits_), 1); bits_ &= bits_ - 1)
+
+// Advances next by 4 instead of 2 in lanes where cond is set
+#define SKIP_IF(cond) \
+    next = pc + 2 + ((laneWords) __builtin_convertvector((laneFlags) (cond), laneWordFlags) & 2)
+
+void initLockstep(lockstepGroup *g) {
+    // loadLane fills in a lane whole, so only what's read before then is cleared, not the memories and screens
+    g->cycleCount     = 0;
+    g->cyclesPerFrame = DEFAULT_CYCLES_PER_FRAME;
+    g->frameCycle     = 0;
+    g->sameMemory     = 0;
+    for(int lane = 0; lane < LOCKSTEP_LANES; lane++) {
+        g->status[lane] = LANE_EMPTY;
+    }
+}
+
+// LANE COPIES =================================================================
+// Machine state only. Timing is shared by the group and handled by the callers
+static void putLane(lockstepGroup *g, int lane, const chip8 *c8) {
+    for(int i = 0; i < 16; i++) {
+        g->V[i][lane] = c8->V[i];
+    }
+    memcpy(g->memory[lane], c8->memory, 4096);
+    g->opcode[lane]         = c8->opcode;
+    g->I[lane]              = c8->I;
+    g->programCounter[lane] = c8->programCounter;
+    g->stackPointer[lane]   = c8->stackPointer;
+    memcpy(g->stack[lane], c8->stack, sizeof(c8->stack));
+
+    memcpy(g->screen[lane], c8->screen, sizeof(c8->screen));
+    g->hiresMode[lane] = c8->hiresMode;
+    memcpy(g->hiresScreen[lane], c8->hiresScreen, sizeof(c8->hiresScreen));
+    g->awaitingRedraw[lane] = c8->awaitingRedraw;
+
+    memcpy(g->keys[lane], c8->keys, 16);
+    g->keyWait[lane] = c8->keyWait;
+    g->displayWait[lane] = c8->displayWait;
+    g->keySpot[lane] = c8->keySpot;
+
+    g->delayTimer[lane] = c8->delayTimer;
+    g->soundTimer[lane] = c8->soundTimer;
+    g->randomSeed[lane] = c8->randomSeed;
+    g->randomState[lane] = c8->randomState;
+    memcpy(g->rplFlags[lane], c8->rplFlags, 16);
+}
+
+int loadLane(lockstepGroup *g, int lane, const chip8 *c8) {
+    bool first = true;
+    for(int i = 0; i < LOCKSTEP_LANES; i++) {
+        first &= g->status[i] == LANE_EMPTY || i == lane;
+    }
+    if(first) {
+        g->cycleCount     = c8->cycleCount;
+        g->cyclesPerFrame = c8->cyclesPerFrame;
+        g->frameCycle     = c8->frameCycle;
+        g->quirks         = c8->quirks;
+    } else if(c8->cycleCount != g->cycleCount || c8->cyclesPerFrame != g->cyclesPerFrame ||
+              c8->frameCycle != g->frameCycle || c8->quirks != g->quirks) {
+        return -1;
+    }
+
+    putLane(g, lane, c8);
+    g->sameMemory &= ~(1u << lane);
+    if(!g->sameMemory || memcmp(g->memory[lane], g->memory[__builtin_ctz(g->sameMemory)], 4096) == 0) {
+        g->sameMemory |= 1u << lane;
+    }
+    g->events[lane] = c8->events;
+    g->fault[lane] = CHIP8_OK;
+    g->status[lane] = c8->keyWait ? LANE_KEY_WAIT : LANE_RUNNING;
+    g->stopCycle[lane] = c8->cycleCount;
+    g->stopFrameCycle[lane] = c8->frameCycle;
+    return 0;
+}
+
+void storeLane(const lockstepGroup *g, int lane, chip8 *c8) {
+    for(int i = 0; i < 16; i++) {
+        c8->V[i] = g->V[i][lane];
+    }
+    memcpy(c8->memory, g->memory[lane], 4096);
+    c8->opcode         = g->opcode[lane];
+    c8->I              = g->I[lane];
+    c8->programCounter = g->programCounter[lane];
+    c8->stackPointer   = g->stackPointer[lane];
+    memcpy(c8->stack, g->stack[lane], sizeof(c8->stack));
+
+    memcpy(c8->screen, g->screen[lane], sizeof(c8->screen));
+    c8->hiresMode = g->hiresMode[lane];
+    memcpy(c8->hiresScreen, g->hiresScreen[lane], sizeof(c8->hiresScreen));
+    c8->awaitingRedraw = g->awaitingRedraw[lane];
+
+    memcpy(c8->keys, g->keys[lane], 16);
+    c8->keyWait = g->keyWait[lane];
+    c8->displayWait = g->displayWait[lane];
+    c8->keySpot = g->keySpot[lane];
+
+    c8->delayTimer   = g->delayTimer[lane];
+    c8->soundTimer   = g->soundTimer[lane];
+    c8->quirks       = g->quirks;
+    c8->randomSeed   = g->randomSeed[lane];
+    c8->randomState  = g->randomState[lane];
+    memcpy(c8->rplFlags, g->rplFlags[lane], 16);
+
+    bool stopped = g->status[lane] == LANE_KEY_WAIT || g->status[lane] == LANE_FAULT;
+    c8->cycleCount     = stopped ? g->stopCycle[lane] : g->cycleCount;
+    c8->frameCycle     = stopped ? g->stopFrameCycle[lane] : g->frameCycle;
+    c8->cyclesPerFrame = g->cyclesPerFrame;
+    c8->idleCheckAt    = c8->cycleCount;
+    c8->idleInterval   = IDLE_MIN_INTERVAL;
+}
+
+static void stopLane(lockstepGroup *g, int lane, laneStatus status) {
+    g->status[lane] = status;
+    g->stopCycle[lane] = g->cycleCount;
+    g->stopFrameCycle[lane] = g->frameCycle;
+}
+
+// Runs one instruction for one lane through emulateCycle, for the cases where the instruction reaches outside an array
+// Those are all faults, which emulateCycle reports
+// A faulting lane is stopped here, the caller has to drop it from the lanes it counts as running
+static void interpretLane(lockstepGroup *g, int lane) {
+    // Zeroed so fields the lanes don't carry start the same every time
+    chip8 c8;
+    memset(&c8, 0, sizeof(c8));
+    storeLane(g, lane, &c8);
+    c8.events   = g->events[lane];
+    c8.audio    = NULL;
+    c8.debugger = NULL;
+#ifdef CHIP8_PROFILE
+    c8.profile = NULL;
+#endif
+#ifdef CHIP8_TRACE
+    c8.trace = NULL;
+#endif
+
+    // Cycles and timer ticks are counted once for the whole group
+    c8.cyclesPerFrame = UINT32_MAX;
+    c8.frameCycle = 0;
+    chip8Status status = emulateCycle(&c8);
+    putLane(g, lane, &c8);
+    if(status != CHIP8_OK) {
+        g->fault[lane] = status;
+        stopLane(g, lane, LANE_FAULT);
+    }
+}
+
+// Unknown opcodes are skipped like in emulateCycle, and reported the same way
+static void reportUnknown(const lockstepGroup *g, int lane, uint16_t op) {
+    if(g->events[lane]) {
+        chip8Event event = {CHIP8_UNKNOWN_OPCODE, g->programCounter[lane], op, g->I[lane], g->stackPointer[lane], g->cycleCount};
+        pushEvent(g->events[lane], &event);
+    }
+}
+
+// EXECUTION ===================================================================
+// Quick test for the instructions reachesOutside has to look at lane by lane
+static bool canReachOutside(uint16_t op) {
+    switch(op & 0xF000) {
+        case 0x0000:
+            return (op & 0x00FF) == 0xEE;
+        case 0x2000:
+            return true;
+        case 0xF000:
+            return (op & 0x00FF) == 0x33 || (op & 0x00FF) == 0x55 || (op & 0x00FF) == 0x65;
+    }
+    return false;
+}
+
+static bool reachesOutside(const lockstepGroup *g, int lane, uint16_t op) {
+    int x = (op & 0x0F00) >> 8;
+    switch(op & 0xF000) {
+        case 0x0000:
+            return (op & 0x00FF) == 0xEE && (g->stackPointer[lane] == 0 || g->stackPointer[lane] > 24);
+        case 0x2000:
+            return g->stackPointer[lane] >= 24;
+        case 0xF000:
+            switch(op & 0x00FF) {
+                case 0x33:
+                    return g->I[lane] + 2 > 0xFFF;
+                case 0x55:
+                case 0x65:
+                    return g->I[lane] + x > 0xFFF;
+            }
+            return false;
+    }
+    return false;
+}
+
+// DXYN for one lane, as in emulateCycle
+static void drawLane(lockstepGroup *g, int lane, int x, int y, int n) {
+    g->displayWait[lane] = quirkProfiles[g->quirks].displayWait;
+    if(g->hiresMode[lane]) {
+        g->V[0xF][lane] = drawHires(g->hiresScreen[lane], g->memory[lane], g->I[lane], g->V[x][lane], g->V[y][lane], n);
+        g->awaitingRedraw[lane] = true;
+        return;
+    }
+    uint8_t startX = g->V[x][lane] % 64;
+    uint8_t startY = g->V[y][lane] % 32;
+    int height = n;
+    if(startY + height > 32) {
+        height = 32 - startY;
+    }
+
+    g->V[0xF][lane] = 0;
+    for(int ypos = 0; ypos < height; ypos++) {
+        uint64_t row = ((uint64_t) g->memory[lane][(g->I[lane] + ypos) & 0xFFF] << 56) >> startX;
+        if(g->screen[lane][startY + ypos] & row) {
+            g->V[0xF][lane] = 1;
+        }
+        g->screen[lane][startY + ypos] ^= row;
+    }
+    g->awaitingRedraw[lane] = true;
+}
+
+// 00E0 and the SUPER-CHIP display instructions (00CN, 00FB, 00FC, 00FE, 00FF) for one lane, as in emulateCycle
+// Anything else in the 0NNN range is left alone
+static void displayLane(lockstepGroup *g, int lane, uint16_t op) {
+    uint64_t *screen = g->screen[lane];
+    uint64_t (*hiresScreen)[64] = g->hiresScreen[lane];
+    switch(op & 0x00FF) {
+        case 0xE0:
+            if(g->hiresMode[lane]) {
+                memset(hiresScreen, 0, sizeof(g->hiresScreen[lane]));
+            } else {
+                memset(screen, 0, sizeof(g->screen[lane]));
+            }
+            break;
+        case 0xFB:
+            scrollRight(screen, hiresScreen, g->hiresMode[lane]);
+            break;
+        case 0xFC:
+            scrollLeft(screen, hiresScreen, g->hiresMode[lane]);
+            break;
+        case 0xFE:
+        case 0xFF:
+            g->hiresMode[lane] = op == 0x00FF;
+            memset(screen, 0, sizeof(g->screen[lane]));
+            memset(hiresScreen, 0, sizeof(g->hiresScreen[lane]));
+            break;
+        default:
+            if((op & 0x00F0) != 0x00C0) {
+                return;
+            }
+            scrollDown(screen, hiresScreen, g->hiresMode[lane], op & 0x000F);
+            break;
+    }
+    g->awaitingRedraw[lane] = true;
+}
+
+// After FX33 or FX55 in lanes. Lanes that stored the same bytes in the same place still share their memory, and so do
+// the lanes that stored nothing. sameMemory keeps whichever of the two is larger
+static void noteStore(lockstepGroup *g, uint16_t op, uint32_t lanes) {
+    uint32_t stored = lanes & g->sameMemory;
+    if(!stored) {
+        return;
+    }
+    const int x = (op & 0x0F00) >> 8;
+    const int first = __builtin_ctz(stored);
+    laneFlags same = (laneFlags) (g->V[x] == g->V[x][first]);
+    if((op & 0x00FF) == 0x55) {
+        for(int i = 0; i < x; i++) {
+            same &= (laneFlags) (g->V[i] == g->V[i][first]);
+        }
+    }
+    // I has moved by the same amount in every lane, so lanes that agree on it now stored to the same place
+    uint32_t matching = stored & laneSet(same);
+    FOR_EACH_LANE(lane, matching) {
+        if(g->I[lane] != g->I[first]) {
+            matching &= ~(1u << lane);
+        }
+    }
+    uint32_t untouched = g->sameMemory & ~lanes;
+    g->sameMemory = __builtin_popcount(matching) >= __builtin_popcount(untouched) ? matching : untouched;
+}
+
+// FX33, FX55, FX65, FX75 and FX85 for one lane. reachesOutside has already checked I
+static void moveLane(lockstepGroup *g, int lane, uint16_t op) {
+    const int x = (op & 0x0F00) >> 8;
+    // Where FX55 and FX65 leave I, as in advanceI
+    const int advance[] = {[MEMORY_I_PLUS_X_PLUS_1] = x + 1, [MEMORY_I_PLUS_X] = x, [MEMORY_I_UNCHANGED] = 0};
+    uint8_t *memory = &g->memory[lane][g->I[lane]];
+    switch(op & 0x00FF) {
+        case 0x33:
+            memory[0] =  g->V[x][lane] / 100;
+            memory[1] = (g->V[x][lane] / 10) % 10;
+            memory[2] = (g->V[x][lane] % 100) % 10;
+            break;
+        case 0x55:
+            for(int i = 0; i <= x; i++) {
+                memory[i] = g->V[i][lane];
+            }
+            g->I[lane] += advance[quirkProfiles[g->quirks].memory];
+            break;
+        case 0x65:
+            for(int i = 0; i <= x; i++) {
+                g->V[i][lane] = memory[i];
+            }
+            g->I[lane] += advance[quirkProfiles[g->quirks].memory];
+            break;
+        case 0x75:
+            for(int i = 0; i <= x; i++) {
+                g->rplFlags[lane][i] = g->V[i][lane];
+            }
+            break;
+        case 0x85:
+            for(int i = 0; i <= x; i++) {
+                g->V[i][lane] = g->rplFlags[lane][i];
+            }
+            break;
+    }
+}
+
+// Runs op in a single lane. A group of one costs more through the vector path than it saves, and once seeds have sent
+// every lane its own way most groups are this size. Same statement order as executeGroup
+static void executeLane(lockstepGroup *g, int lane, uint16_t op) {
+    const int x       = (op & 0x0F00) >> 8;
+    const int y       = (op & 0x00F0) >> 4;
+    const int n       = op & 0x000F;
+    const uint8_t nn  = op & 0x00FF;
+    const uint16_t nnn = op & 0x0FFF;
+    const chip8Quirks *q = &quirkProfiles[g->quirks];
+
+    if(canReachOutside(op) && reachesOutside(g, lane, op)) {
+        interpretLane(g, lane);
+        return;
+    }
+    if(classifyOpcode(op) == CLASS_UNKNOWN) {
+        reportUnknown(g, lane, op);
+    }
+
+    laneBytes *V = g->V;
+    uint16_t pc = g->programCounter[lane];
+    uint16_t next = pc + 2;
+    g->opcode[lane] = op;
+
+    switch(op & 0xF000) {
+        case 0x0000:
+            if(nn == 0xEE) {
+                g->stackPointer[lane]--;
+                next = g->stack[lane][g->stackPointer[lane]] + 2;
+            } else if(nn == 0xFD) {
+                next = pc;
+            } else {
+                displayLane(g, lane, op);
+            }
+            break;
+
+        case 0x1000:
+            next = nnn;
+            break;
+
+        case 0x2000:
+            g->stack[lane][g->stackPointer[lane]] = pc;
+            g->stackPointer[lane]++;
+            next = nnn;
+            break;
+
+        case 0x3000:
+            next += V[x][lane] == nn ? 2 : 0;
+            break;
+
+        case 0x4000:
+            next += V[x][lane] != nn ? 2 : 0;
+            break;
+
+        case 0x5000:
+            next += V[x][lane] == V[y][lane] ? 2 : 0;
+            break;
+
+        case 0x6000:
+            V[x][lane] = nn;
+            break;
+
+        case 0x7000:
+            V[x][lane] += nn;
+            break;
+
+        case 0x8000:
+            switch(n) {
+                case 0x0:
+                    V[x][lane] = V[y][lane];
+                    break;
+                case 0x1:
+                    V[x][lane] |= V[y][lane];
+                    if(q->vfReset) {
+                        V[0xF][lane] = 0;
+                    }
+                    break;
+                case 0x2:
+                    V[x][lane] &= V[y][lane];
+                    if(q->vfReset) {
+                        V[0xF][lane] = 0;
+                    }
+                    break;
+                case 0x3:
+                    V[x][lane] ^= V[y][lane];
+                    if(q->vfReset) {
+                        V[0xF][lane] = 0;
+                    }
+                    break;
+                case 0x4:
+                    V[0xF][lane] = V[y][lane] > 0xFF - V[x][lane];
+                    V[x][lane] += V[y][lane];
+                    break;
+                case 0x5:
+                    V[0xF][lane] = V[x][lane] >= V[y][lane];
+                    V[x][lane] -= V[y][lane];
+                    break;
+                case 0x6:
+                    if(!q->shiftVy) {
+                        V[0xF][lane] = V[x][lane] & 1;
+                        V[x][lane] = V[x][lane] >> 1;
+                    } else {
+                        V[0xF][lane] = V[y][lane] & 1;
+                        V[y][lane] = V[y][lane] >> 1;
+                        V[x][lane] = V[y][lane];
+                    }
+                    break;
+                case 0x7:
+                    V[0xF][lane] = V[x][lane] <= V[y][lane];
+                    V[x][lane] = V[y][lane] - V[x][lane];
+                    break;
+                case 0xE:
+                    if(!q->shiftVy) {
+                        V[0xF][lane] = (V[x][lane] >> 7) & 1;
+                        V[x][lane] = V[x][lane] << 1;
+                    } else {
+                        V[0xF][lane] = (V[y][lane] >> 7) & 1;
+                        V[y][lane] = V[y][lane] << 1;
+                        V[x][lane] = V[y][lane];
+                    }
+                    break;
+            }
+            break;
+
+        case 0x9000:
+            next += V[x][lane] != V[y][lane] ? 2 : 0;
+            break;
+
+        case 0xA000:
+            g->I[lane] = nnn;
+            break;
+
+        case 0xB000:
+            next = V[q->jumpVx ? x : 0][lane] + nnn;
+            break;
+
+        case 0xC000:
+            V[x][lane] = nextRandom(&g->randomState[lane]) & nn;
+            break;
+
+        case 0xD000:
+            drawLane(g, lane, x, y, n);
+            break;
+
+        case 0xE000:
+            if(nn == 0x9E) {
+                next += g->keys[lane][V[x][lane] & 0xF] != 0 ? 2 : 0;
+            } else if(nn == 0xA1) {
+                next += g->keys[lane][V[x][lane] & 0xF] == 0 ? 2 : 0;
+            }
+            break;
+
+        case 0xF000:
+            switch(nn) {
+                case 0x07:
+                    V[x][lane] = g->delayTimer[lane];
+                    break;
+                case 0x0A:
+                    g->keyWait[lane] = true;
+                    g->keySpot[lane] = x;
+                    break;
+                case 0x15:
+                    g->delayTimer[lane] = V[x][lane];
+                    break;
+                case 0x18:
+                    g->soundTimer[lane] = V[x][lane];
+                    break;
+                case 0x1E:
+                    V[0xF][lane] = g->I[lane] + V[x][lane] > 0xFFF;
+                    g->I[lane] += V[x][lane];
+                    break;
+                case 0x29:
+                    g->I[lane] = V[x][lane] * 5;
+                    break;
+                case 0x30:
+                    g->I[lane] = BIG_FONT_ADDRESS + (V[x][lane] & 0xF) * 10;
+                    break;
+                case 0x33:
+                case 0x55:
+                case 0x65:
+                case 0x75:
+                case 0x85:
+                    moveLane(g, lane, op);
+                    if(nn == 0x33 || nn == 0x55) {
+                        noteStore(g, op, 1u << lane);
+                    }
+                    break;
+            }
+            break;
+    }
+
+    g->programCounter[lane] = next;
+}
+
+// Runs op in every lane set in lanes. Follows emulateCycle statement for statement, so registers that alias
+// (X or Y being F) come out the same
+static void executeGroup(lockstepGroup *g, uint16_t op, uint32_t lanes) {
+    const int x       = (op & 0x0F00) >> 8;
+    const int y       = (op & 0x00F0) >> 4;
+    const int n       = op & 0x000F;
+    const uint8_t nn  = op & 0x00FF;
+    const uint16_t nnn = op & 0x0FFF;
+    // Every lane in a group shares the profile, so each quirk is one well predicted test per instruction
+    const chip8Quirks *q = &quirkProfiles[g->quirks];
+
+    if(canReachOutside(op)) {
+        FOR_EACH_LANE(lane, lanes) {
+            if(reachesOutside(g, lane, op)) {
+                interpretLane(g, lane);
+                lanes &= ~(1u << lane);
+            }
+        }
+        if(!lanes) {
+            return;
+        }
+    }
+    if(classifyOpcode(op) == CLASS_UNKNOWN) {
+        FOR_EACH_LANE(lane, lanes) {
+            reportUnknown(g, lane, op);
+        }
+    }
+
+    // All ones in the lanes taking part
+    const laneFlags selected = laneMask(lanes);
+    const laneWords m16 = (laneWords) __builtin_convertvector(selected, laneWordFlags);
+    const laneBytes m8 = (laneBytes) selected;
+
+    laneBytes *V = g->V;
+    const laneWords pc = g->programCounter;
+    laneWords next = pc + 2;
+    g->opcode = BLEND(g->opcode, (laneWords) {0} + op, m16);
+
+    switch(op & 0xF000) {
+        case 0x0000:
+            if(nn == 0xEE) {
+                // 00EE: Return from a subroutine
+                FOR_EACH_LANE(lane, lanes) {
+                    g->stackPointer[lane]--;
+                    next[lane] = g->stack[lane][g->stackPointer[lane]] + 2;
+                }
+            } else if(nn == 0xFD) {
+                // 00FD: Exit, which stays put
+                next = pc;
+            } else {
+                // 00E0: Clear the screen, or one of the SUPER-CHIP scrolls and mode switches
+                FOR_EACH_LANE(lane, lanes) {
+                    displayLane(g, lane, op);
+                }
+            }
+            break;
+
+        case 0x1000:
+            next = (laneWords) {0} + nnn;
+            break;
+
+        case 0x2000:
+            FOR_EACH_LANE(lane, lanes) {
+                g->stack[lane][g->stackPointer[lane]] = pc[lane];
+                g->stackPointer[lane]++;
+            }
+            next = (laneWords) {0} + nnn;
+            break;
+
+        case 0x3000:
+            SKIP_IF(V[x] == nn);
+            break;
+
+        case 0x4000:
+            SKIP_IF(V[x] != nn);
+            break;
+
+        case 0x5000:
+            SKIP_IF(V[x] == V[y]);
+            break;
+
+        case 0x6000:
+            V[x] = BLEND(V[x], (laneBytes) {0} + nn, m8);
+            break;
+
+        case 0x7000:
+            V[x] = BLEND(V[x], V[x] + nn, m8);
+            break;
+
+        case 0x8000:
+            switch(n) {
+                case 0x0:
+                    V[x] = BLEND(V[x], V[y], m8);
+                    break;
+                case 0x1:
+                    V[x] = BLEND(V[x], V[x] | V[y], m8);
+                    if(q->vfReset) {
+                        V[0xF] = BLEND(V[0xF], (laneBytes) {0}, m8);
+                    }
+                    break;
+                case 0x2:
+                    V[x] = BLEND(V[x], V[x] & V[y], m8);
+                    if(q->vfReset) {
+                        V[0xF] = BLEND(V[0xF], (laneBytes) {0}, m8);
+                    }
+                    break;
+                case 0x3:
+                    V[x] = BLEND(V[x], V[x] ^ V[y], m8);
+                    if(q->vfReset) {
+                        V[0xF] = BLEND(V[0xF], (laneBytes) {0}, m8);
+                    }
+                    break;
+                case 0x4:
+                    V[0xF] = BLEND(V[0xF], (laneBytes) (V[y] > 0xFF - V[x]) & 1, m8);
+                    V[x] = BLEND(V[x], V[x] + V[y], m8);
+                    break;
+                case 0x5:
+                    V[0xF] = BLEND(V[0xF], (laneBytes) (V[x] >= V[y]) & 1, m8);
+                    V[x] = BLEND(V[x], V[x] - V[y], m8);
+                    break;
+                case 0x6:
+                    if(!q->shiftVy) {
+                        V[0xF] = BLEND(V[0xF], V[x] & 1, m8);
+                        V[x] = BLEND(V[x], V[x] >> 1, m8);
+                    } else {
+                        V[0xF] = BLEND(V[0xF], V[y] & 1, m8);
+                        V[y] = BLEND(V[y], V[y] >> 1, m8);
+                        V[x] = BLEND(V[x], V[y], m8);
+                    }
+                    break;
+                case 0x7:
+                    V[0xF] = BLEND(V[0xF], (laneBytes) (V[x] <= V[y]) & 1, m8);
+                    V[x] = BLEND(V[x], V[y] - V[x], m8);
+                    break;
+                case 0xE:
+                    if(!q->shiftVy) {
+                        V[0xF] = BLEND(V[0xF], (V[x] >> 7) & 1, m8);
+                        V[x] = BLEND(V[x], V[x] << 1, m8);
+                    } else {
+                        V[0xF] = BLEND(V[0xF], (V[y] >> 7) & 1, m8);
+                        V[y] = BLEND(V[y], V[y] << 1, m8);
+                        V[x] = BLEND(V[x], V[y], m8);
+                    }
+                    break;
+            }
+            break;
+
+        case 0x9000:
+            SKIP_IF(V[x] != V[y]);
+            break;
+
+        case 0xA000:
+            g->I = BLEND(g->I, (laneWords) {0} + nnn, m16);
+            break;
+
+        case 0xB000:
+            next = __builtin_convertvector(V[q->jumpVx ? x : 0], laneWords) + nnn;
+            break;
+
+        case 0xC000:
+            // Each lane has its own generator, so this is where seeded lanes usually part ways
+            FOR_EACH_LANE(lane, lanes) {
+                V[x][lane] = nextRandom(&g->randomState[lane]) & nn;
+            }
+            break;
+
+        case 0xD000:
+            FOR_EACH_LANE(lane, lanes) {
+                drawLane(g, lane, x, y, n);
+            }
+            break;
+
+        case 0xE000:
+            if(nn == 0x9E || nn == 0xA1) {
+                laneFlags pressed = {0};
+                FOR_EACH_LANE(lane, lanes) {
+                    pressed[lane] = g->keys[lane][V[x][lane] & 0xF] != 0 ? -1 : 0;
+                }
+                if(nn == 0x9E) {
+                    SKIP_IF(pressed);
+                } else {
+                    SKIP_IF(~pressed);
+                }
+            }
+            break;
+
+        case 0xF000:
+            switch(nn) {
+                case 0x07:
+                    V[x] = BLEND(V[x], g->delayTimer, m8);
+                    break;
+
+                case 0x0A:
+                    FOR_EACH_LANE(lane, lanes) {
+                        g->keyWait[lane] = true;
+                        g->keySpot[lane] = x;
+                    }
+                    break;
+
+                case 0x15:
+                    g->delayTimer = BLEND(g->delayTimer, V[x], m8);
+                    break;
+
+                case 0x18:
+                    g->soundTimer = BLEND(g->soundTimer, V[x], m8);
+                    break;
+
+                case 0x1E: {
+                    // Compared this way round so an I near 0xFFFF can't wrap past the test
+                    laneWordFlags carry = (laneWordFlags) (g->I > 0xFFF - __builtin_convertvector(V[x], laneWords));
+                    V[0xF] = BLEND(V[0xF], (laneBytes) __builtin_convertvector(carry, laneFlags) & 1, m8);
+                    g->I = BLEND(g->I, g->I + __builtin_convertvector(V[x], laneWords), m16);
+                    break;
+                }
+
+                case 0x29:
+                    g->I = BLEND(g->I, __builtin_convertvector(V[x], laneWords) * 5, m16);
+                    break;
+
+                case 0x30:
+                    g->I = BLEND(g->I, __builtin_convertvector(V[x] & 0xF, laneWords) * 10 + BIG_FONT_ADDRESS, m16);
+                    break;
+
+                case 0x33:
+                case 0x55:
+                case 0x65:
+                case 0x75:
+                case 0x85:
+                    FOR_EACH_LANE(lane, lanes) {
+                        moveLane(g, lane, op);
+                    }
+                    if(nn == 0x33 || nn == 0x55) {
+                        noteStore(g, op, lanes);
+                    }
+                    break;
+            }
+            break;
+    }
+
+    g->programCounter = BLEND(g->programCounter, next, m16);
+}
+
+// Runs every lane in lanes on its own through the threaded engine up to end, stopping it where the group would have
+static void runApart(lockstepGroup *g, uint32_t lanes, uint64_t end) {
+    // Every lane starts from where the group is, so the group only moves on once they've all run
+    uint32_t frameCycle = g->frameCycle;
+    FOR_EACH_LANE(lane, lanes) {
+        chip8 c8;
+        memset(&c8, 0, sizeof(c8));
+        storeLane(g, lane, &c8);
+        c8.events = g->events[lane];
+        resetDecodeCache(&g->apart);
+        chip8Status status = CHIP8_OK;
+        while(status == CHIP8_OK && !c8.keyWait && c8.cycleCount < end) {
+            status = emulateCyclesThreaded(&c8, &g->apart, end - c8.cycleCount);
+        }
+        putLane(g, lane, &c8);
+        if(status != CHIP8_OK || c8.keyWait) {
+            g->fault[lane] = status;
+            g->status[lane] = status != CHIP8_OK ? LANE_FAULT : LANE_KEY_WAIT;
+            g->stopCycle[lane] = c8.cycleCount;
+            g->stopFrameCycle[lane] = c8.frameCycle;
+        } else {
+            frameCycle = c8.frameCycle;
+        }
+    }
+    g->cycleCount = end;
+    g->frameCycle = frameCycle;
+    g->sameMemory &= ~lanes;
+}
+
+int emulateCyclesLockstep(lockstepGroup *g, uint64_t cycles) {
+    const uint64_t end = g->cycleCount + cycles;
+
+    uint32_t running = 0;
+    for(int lane = 0; lane < LOCKSTEP_LANES; lane++) {
+        if(g->status[lane] == LANE_RUNNING) {
+            running |= 1u << lane;
+        }
+    }
+    uint32_t runningCount = __builtin_popcount(running);
+
+    // Lanes run and groups run them in since the last check on how far the lanes have split
+    uint32_t laneRuns = 0, groupRuns = 0;
+
+    while(running && g->cycleCount < end) {
+        // Once groups average too few lanes to pay for the grouping, the lanes finish the call apart
+        if(laneRuns >= LOCKSTEP_SPLIT_WINDOW) {
+            if(laneRuns < groupRuns * LOCKSTEP_MIN_GROUP) {
+                runApart(g, running, end);
+                break;
+            }
+            laneRuns = groupRuns = 0;
+        }
+
+        // While every lane is at the same address in the same memory, which is how a seed sweep starts out, the whole
+        // group runs one opcode fetched once
+        uint32_t mayWait = 0;
+        const int leader = __builtin_ctz(running);
+        const uint16_t pc = g->programCounter[leader];
+        const laneFlags inGroup = laneMask(running);
+        const laneWords apart = (g->programCounter ^ pc) & (laneWords) __builtin_convertvector(inGroup, laneWordFlags);
+        laneBytes waiting;
+        memcpy(&waiting, g->displayWait, sizeof(waiting));
+        laneHalves differ[2];
+        memcpy(differ, &apart, sizeof(differ));
+        differ[0] |= differ[1] | (laneHalves) (waiting & (laneBytes) inGroup);
+        if(!(differ[0][0] | differ[0][1]) && !(running & ~g->sameMemory) && pc < 4095) {
+            const uint16_t op = (g->memory[leader][pc] << 8) | g->memory[leader][pc + 1];
+            laneRuns += runningCount;
+            groupRuns++;
+            if(running & (running - 1)) {
+                executeGroup(g, op, running);
+            } else {
+                executeLane(g, leader, op);
+            }
+            if((op & 0xF0FF) == 0xF00A || canReachOutside(op)) {
+                mayWait = running;
+            }
+        } else {
+            // Fetch every lane's instruction
+            laneBytes high = {0}, low = {0};
+            uint32_t pending = 0;
+            FOR_EACH_LANE(lane, running) {
+                // Waiting on the tick after DXYN, the cycle passes without running anything
+                if(g->displayWait[lane]) {
+                    continue;
+                }
+                uint16_t pc = g->programCounter[lane];
+                if(pc >= 4095) {
+                    // No whole opcode left in memory, the interpreter reports the fault
+                    interpretLane(g, lane);
+                    mayWait |= 1u << lane;
+                } else {
+                    high[lane] = g->memory[lane][pc];
+                    low[lane] = g->memory[lane][pc + 1];
+                    pending |= 1u << lane;
+                }
+            }
+
+            laneRuns += __builtin_popcount(pending);
+
+            // Lanes running the same opcode execute together, wherever their program counters are
+            // Lanes that share a program counter always do, so a group only splits when control flow or memory diverges
+            while(pending) {
+                const int first = __builtin_ctz(pending);
+                const uint16_t op = (high[first] << 8) | low[first];
+                uint32_t group = pending & laneSet((laneFlags) ((high == high[first]) & (low == low[first])));
+                groupRuns++;
+                if(group & (group - 1)) {
+                    executeGroup(g, op, group);
+                } else {
+                    executeLane(g, __builtin_ctz(group), op);
+                }
+                if((op & 0xF0FF) == 0xF00A || canReachOutside(op)) {
+                    mayWait |= group;
+                }
+                pending &= ~group;
+            }
+        }
+
+        // A fault stops a lane before its cycle counts, so it has to miss the timer tick below
+        FOR_EACH_LANE(lane, mayWait) {
+            if(g->status[lane] == LANE_FAULT) {
+                running &= ~(1u << lane);
+                runningCount--;
+            }
+        }
+        if(!running) {
+            break;
+        }
+
+        // Finish the cycle for every lane that ran, ticking their timers together
+        g->cycleCount++;
+        g->frameCycle++;
+        if(g->frameCycle >= g->cyclesPerFrame) {
+            g->frameCycle = 0;
+            laneBytes ticking = {0};
+            FOR_EACH_LANE(lane, running) {
+                ticking[lane] = 1;
+            }
+            g->delayTimer -= (laneBytes) (g->delayTimer != 0) & ticking;
+            g->soundTimer -= (laneBytes) (g->soundTimer != 0) & ticking;
+            memset(g->displayWait, 0, sizeof(g->displayWait));
+        }
+
+        // Like the other engines, a lane stops once FX0A has finished its cycle
+        FOR_EACH_LANE(lane, mayWait & running) {
+            if(g->keyWait[lane]) {
+                stopLane(g, lane, LANE_KEY_WAIT);
+                running &= ~(1u << lane);
+                runningCount--;
+            }
+        }
+    }
+
+    int count = 0;
+    for(int lane = 0; lane < LOCKSTEP_LANES; lane++) {
+        count += g->status[lane] == LANE_RUNNING;
+    }
+    return count;
+}
+
+#endif // LOCKSTEP_C_INCLUDE
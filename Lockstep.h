@@ -0,0 +1,92 @@
+#ifndef LOCKSTEP_H_INCLUDE
+#define LOCKSTEP_H_INCLUDE
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Chip8.h"
+#include "Threaded.h"
+
+// Machines run side by side. 16 lanes of bytes fill an SSE register, and the 16-bit state fills an AVX2 one
+#define LOCKSTEP_LANES 16
+
+// GCC vector extensions, one element per lane. These compile to SSE2 by default and AVX2 with -mavx2
+// laneWords only asks for 16 byte alignment so a lockstepGroup from plain malloc is fine either way
+typedef uint8_t  laneBytes __attribute__((vector_size(LOCKSTEP_LANES)));
+typedef uint16_t laneWords __attribute__((vector_size(LOCKSTEP_LANES * 2), aligned(16)));
+
+typedef enum {
+    LANE_EMPTY,     // Nothing loaded
+    LANE_RUNNING,
+    LANE_KEY_WAIT,  // Stopped on FX0A
+    LANE_FAULT      // Stopped on a fault, see fault
+} laneStatus;
+
+// Structure-of-arrays state for LOCKSTEP_LANES machines
+// Registers and timers are indexed [register][lane] so one instruction updates every lane at once.
+// Memory, the screen and the stack are only ever touched one lane at a time, so they stay [lane][...]
+// Lanes share the cycle counter and frame position, which is what keeps their timers ticking together
+typedef struct {
+    // MEMORY THINGS ===============================================================
+    laneBytes V[16];
+    laneWords opcode, I, programCounter, stackPointer;
+    uint16_t stack[LOCKSTEP_LANES][24];
+    uint8_t  memory[LOCKSTEP_LANES][4096];
+
+    // DISPLAY THINGS ==============================================================
+    uint64_t screen[LOCKSTEP_LANES][32];
+    bool     hiresMode[LOCKSTEP_LANES];
+    uint64_t hiresScreen[LOCKSTEP_LANES][2][64];
+    bool     awaitingRedraw[LOCKSTEP_LANES];
+
+    // KEYBOARD THINGS =============================================================
+    uint8_t keys[LOCKSTEP_LANES][16];
+    bool    keyWait[LOCKSTEP_LANES];
+    bool    displayWait[LOCKSTEP_LANES]; // Skipped at fetch until the group's next timer tick
+    uint8_t keySpot[LOCKSTEP_LANES];
+
+    // MISC THINGS =================================================================
+    laneBytes delayTimer, soundTimer;
+    uint64_t randomSeed[LOCKSTEP_LANES];
+    uint64_t randomState[LOCKSTEP_LANES];
+    uint8_t  rplFlags[LOCKSTEP_LANES][16];
+    quirkProfile quirks;
+
+    // TIMING THINGS ===============================================================
+    uint64_t cycleCount;
+    uint32_t cyclesPerFrame;
+    uint32_t frameCycle;
+
+    // LANE THINGS =================================================================
+    laneStatus status[LOCKSTEP_LANES];
+    uint32_t sameMemory;                     // Lanes whose memory is known to match, so one copy can be fetched from
+    chip8Status fault[LOCKSTEP_LANES];       // Why a LANE_FAULT lane stopped
+    chip8EventRing *events[LOCKSTEP_LANES];  // Each machine's own ring, from loadLane
+    uint64_t stopCycle[LOCKSTEP_LANES];      // cycleCount and frameCycle when the lane stopped
+    uint32_t stopFrameCycle[LOCKSTEP_LANES];
+
+    decodeCache apart; // Lanes that have parted ways run through the threaded engine one at a time
+} lockstepGroup;
+
+// Empties every lane
+void initLockstep(lockstepGroup *g);
+
+// Copies a machine into a lane. Every loaded lane must share cycleCount, frameCycle, cyclesPerFrame and quirks
+// with the first one, otherwise this returns -1. A machine already waiting on FX0A is loaded as stopped
+int loadLane(lockstepGroup *g, int lane, const chip8 *c8);
+
+// Copies a lane back out. Fields that aren't machine state (events, audio, idleSkip) are left alone
+// and the next idle-loop check is due straight away
+void storeLane(const lockstepGroup *g, int lane, chip8 *c8);
+
+// Runs every running lane for up to `cycles` cycles. A lane stops when FX0A starts a key wait or on a fault, exactly
+// where emulateCycle would have, and reports the same events to its machine's ring. Lanes have no audio, FX18 only
+// sets the timer. Returns the number of lanes still running
+// Lockstep only beats the threaded engine while lanes share a program counter and memory, when each cycle is one fetch
+// and one vector instruction for the whole group. On the bundled ROMs that means lanes that never part ways, where
+// counter.ch8 runs about 1.6 times as fast as threaded. Seeded lanes usually split within a few frames, and once groups
+// average under LOCKSTEP_MIN_GROUP lanes the rest of the call runs each lane through emulateCyclesThreaded instead, so
+// a group that has split costs about what threaded does
+int emulateCyclesLockstep(lockstepGroup *g, uint64_t cycles);
+
+#endif // LOCKSTEP_H_INCLUDE
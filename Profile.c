@@ -0,0 +1,215 @@
+#ifndef PROFILE_C_INCLUDE
+#define PROFILE_C_INCLUDE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Chip8.c"
+#include "Disasm.c"
+#include "Profile.h"
+
+void resetProfile(chip8Profile *p) {
+    memset(p, 0, sizeof(chip8Profile));
+}
+
+void mergeProfile(chip8Profile *dst, const chip8Profile *src) {
+    for(int i = 0; i < OPCODE_CLASSES; i++) {
+        dst->opcodeCounts[i] += src->opcodeCounts[i];
+    }
+    for(int pc = 0; pc < 4096; pc++) {
+        dst->pcHits[pc] += src->pcHits[pc];
+    }
+    for(int i = 0; i < PROFILE_DRAW_BUCKETS; i++) {
+        dst->drawsPerFrame[i] += src->drawsPerFrame[i];
+    }
+    dst->keyWaitCycles += src->keyWaitCycles;
+    dst->frames += src->frames;
+    dst->draws += src->draws;
+    if(src->maxFrameDraws > dst->maxFrameDraws) {
+        dst->maxFrameDraws = src->maxFrameDraws;
+    }
+}
+
+static uint64_t instructionCount(const chip8Profile *p) {
+    uint64_t total = 0;
+    for(int i = 0; i < OPCODE_CLASSES; i++) {
+        total += p->opcodeCounts[i];
+    }
+    return total;
+}
+
+static double keyWaitSeconds(const chip8Profile *p, uint32_t cyclesPerFrame) {
+    return (double) p->keyWaitCycles / cyclesPerFrame / 60.0;
+}
+
+// JSON AND CSV ================================================================
+void writeProfileJson(const chip8Profile *p, uint32_t cyclesPerFrame, FILE *out) {
+    fprintf(out, "{\n  \"instructions\": %llu,\n  \"key_wait_cycles\": %llu,\n  \"key_wait_seconds\": %.3f,\n",
+            (unsigned long long) instructionCount(p), (unsigned long long) p->keyWaitCycles,
+            keyWaitSeconds(p, cyclesPerFrame));
+    fprintf(out, "  \"frames\": %llu,\n  \"draws\": %llu,\n  \"max_draws_per_frame\": %u,\n",
+            (unsigned long long) p->frames, (unsigned long long) p->draws, p->maxFrameDraws);
+
+    fprintf(out, "  \"opcodes\": {");
+    for(int i = 0; i < OPCODE_CLASSES; i++) {
+        fprintf(out, "%s\"%s\": %llu", i ? ", " : "", opcodeClassNames[i], (unsigned long long) p->opcodeCounts[i]);
+    }
+    fprintf(out, "},\n");
+
+    // The last bucket is every frame with PROFILE_DRAW_BUCKETS - 1 or more draws
+    fprintf(out, "  \"draws_per_frame\": [");
+    for(int i = 0; i < PROFILE_DRAW_BUCKETS; i++) {
+        fprintf(out, "%s%llu", i ? ", " : "", (unsigned long long) p->drawsPerFrame[i]);
+    }
+    fprintf(out, "],\n");
+
+    // Only addresses that ran, the rest of the 4096 would be zeros
+    fprintf(out, "  \"pc_hits\": {");
+    bool first = true;
+    for(int pc = 0; pc < 4096; pc++) {
+        if(p->pcHits[pc]) {
+            fprintf(out, "%s\"0x%03X\": %llu", first ? "" : ", ", pc, (unsigned long long) p->pcHits[pc]);
+            first = false;
+        }
+    }
+    fprintf(out, "}\n}\n");
+}
+
+// One long table of (section, key, value) so every counter fits the same three columns
+void writeProfileCsv(const chip8Profile *p, uint32_t cyclesPerFrame, FILE *out) {
+    fprintf(out, "section,key,value\n");
+    fprintf(out, "summary,instructions,%llu\n", (unsigned long long) instructionCount(p));
+    fprintf(out, "summary,key_wait_cycles,%llu\n", (unsigned long long) p->keyWaitCycles);
+    fprintf(out, "summary,key_wait_seconds,%.3f\n", keyWaitSeconds(p, cyclesPerFrame));
+    fprintf(out, "summary,frames,%llu\n", (unsigned long long) p->frames);
+    fprintf(out, "summary,draws,%llu\n", (unsigned long long) p->draws);
+    fprintf(out, "summary,max_draws_per_frame,%u\n", p->maxFrameDraws);
+    for(int i = 0; i < OPCODE_CLASSES; i++) {
+        fprintf(out, "opcode,%s,%llu\n", opcodeClassNames[i], (unsigned long long) p->opcodeCounts[i]);
+    }
+    for(int i = 0; i < PROFILE_DRAW_BUCKETS; i++) {
+        fprintf(out, "draws_per_frame,%d,%llu\n", i, (unsigned long long) p->drawsPerFrame[i]);
+    }
+    for(int pc = 0; pc < 4096; pc++) {
+        if(p->pcHits[pc]) {
+            fprintf(out, "pc,0x%03X,%llu\n", pc, (unsigned long long) p->pcHits[pc]);
+        }
+    }
+}
+
+// LISTING =====================================================================
+#define PROFILE_MAX_LOOPS 10
+
+typedef struct {
+    uint16_t start, end;   // First address and the jump back to it
+    uint64_t instructions; // Hits on every address in between
+    uint64_t iterations;   // Times the jump back ran
+} profileLoop;
+
+static int compareLoops(const void *a, const void *b) {
+    const profileLoop *x = a;
+    const profileLoop *y = b;
+    return x->instructions < y->instructions ? 1 : x->instructions > y->instructions ? -1 : 0;
+}
+
+static uint16_t opcodeAt(const uint8_t *memory, int pc) {
+    return (memory[pc] << 8) | (pc + 1 < 4096 ? memory[pc + 1] : 0);
+}
+
+void writeProfileListing(const chip8Profile *p, const uint8_t *memory, FILE *out) {
+    uint64_t total = instructionCount(p);
+    if(total == 0) {
+        fprintf(out, "Nothing was executed\n");
+        return;
+    }
+
+    // Every executed 1NNN that jumps to itself or further back closes a loop
+    profileLoop *loops = NULL;
+    int loopCount = 0;
+    for(int pc = 0; pc < 4096; pc++) {
+        uint16_t opcode = opcodeAt(memory, pc);
+        if(!p->pcHits[pc] || classifyOpcode(opcode) != CLASS_1NNN || (opcode & 0x0FFF) > pc) {
+            continue;
+        }
+        profileLoop loop = {opcode & 0x0FFF, pc, 0, p->pcHits[pc]};
+        for(int a = loop.start; a <= loop.end; a++) {
+            loop.instructions += p->pcHits[a];
+        }
+        loops = realloc(loops, (loopCount + 1) * sizeof(profileLoop));
+        loops[loopCount++] = loop;
+    }
+    qsort(loops, loopCount, sizeof(profileLoop), compareLoops);
+
+    fprintf(out, "%llu instructions, %llu cycles halted on FX0A\n\n",
+            (unsigned long long) total, (unsigned long long) p->keyWaitCycles);
+    fprintf(out, "Hot loops\n");
+    if(loopCount == 0) {
+        fprintf(out, "  none\n");
+    }
+    for(int i = 0; i < loopCount && i < PROFILE_MAX_LOOPS; i++) {
+        fprintf(out, "  0x%03X-0x%03X  %6.2f%%  %llu iterations\n", loops[i].start, loops[i].end,
+                100.0 * loops[i].instructions / total, (unsigned long long) loops[i].iterations);
+    }
+
+    fprintf(out, "\naddr  opcode  instruction          hits          share\n");
+    int previous = -1;
+    for(int pc = 0; pc < 4096; pc++) {
+        if(!p->pcHits[pc]) {
+            continue;
+        }
+        if(previous >= 0 && pc != previous + 2) {
+            fprintf(out, "...\n");
+        }
+        previous = pc;
+
+        // Marks addresses that start one of the listed loops
+        bool loopStart = false;
+        for(int i = 0; i < loopCount && i < PROFILE_MAX_LOOPS; i++) {
+            loopStart |= loops[i].start == pc;
+        }
+
+        char text[32];
+        uint16_t opcode = opcodeAt(memory, pc);
+        disassemble(opcode, text, sizeof(text));
+        double share = 100.0 * p->pcHits[pc] / total;
+        char bar[21];
+        int width = (int) (share / 5.0 + 0.5);
+        memset(bar, '#', width);
+        bar[width] = '\0';
+        fprintf(out, "%03X%c  %04X    %-20s %-13llu %6.2f%% %s\n", pc, loopStart ? '>' : ' ', opcode, text,
+                (unsigned long long) p->pcHits[pc], share, bar);
+    }
+
+    free(loops);
+}
+
+int writeProfileFiles(const chip8Profile *p, const chip8 *c8, const char *base, bool csv) {
+    char filename[4096];
+    snprintf(filename, sizeof(filename), "%s.%s", base, csv ? "csv" : "json");
+    FILE *out = fopen(filename, "w");
+    if(!out) {
+        printf("Could not open %s for writing\n", filename);
+        return -1;
+    }
+    if(csv) {
+        writeProfileCsv(p, c8->cyclesPerFrame, out);
+    } else {
+        writeProfileJson(p, c8->cyclesPerFrame, out);
+    }
+    fclose(out);
+
+    snprintf(filename, sizeof(filename), "%s.lst", base);
+    out = fopen(filename, "w");
+    if(!out) {
+        printf("Could not open %s for writing\n", filename);
+        return -1;
+    }
+    writeProfileListing(p, c8->memory, out);
+    fclose(out);
+    return 0;
+}
+
+#endif // PROFILE_C_INCLUDE
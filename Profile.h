@@ -0,0 +1,78 @@
+#ifndef PROFILE_H_INCLUDE
+#define PROFILE_H_INCLUDE
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Chip8.h"
+#include "Disasm.h"
+
+// Frames are bucketed by how many DXYN they ran. The last bucket also holds every frame with more
+#define PROFILE_DRAW_BUCKETS 32
+
+// Counters filled in by emulateCycle when the build defines CHIP8_PROFILE and c8->profile is set
+// Only the interpreter records them. The threaded, JIT and lockstep engines never call into the profiler
+typedef struct chip8Profile {
+    uint64_t opcodeCounts[OPCODE_CLASSES];
+    uint64_t pcHits[4096];     // Instructions fetched from each address
+    uint64_t keyWaitCycles;    // Cycles that passed halted on FX0A
+    uint64_t frames;           // Timer frames completed
+    uint64_t draws;            // DXYN executed
+    uint64_t drawsPerFrame[PROFILE_DRAW_BUCKETS];
+    uint32_t frameDraws;       // DXYN so far in the current frame
+    uint32_t maxFrameDraws;
+} chip8Profile;
+
+// Without CHIP8_PROFILE the hooks expand to nothing and chip8 has no profile field, so a normal build pays nothing
+// With it, each hook costs a pointer test when profiling is off at runtime
+#ifdef CHIP8_PROFILE
+#define PROFILE(c8, hook) do { if((c8)->profile) { hook((c8)->profile); } } while(0)
+#define PROFILE_INSTRUCTION(c8) do { if((c8)->profile) { profileInstruction((c8)->profile, (c8)->programCounter, (c8)->opcode); } } while(0)
+#else
+#define PROFILE(c8, hook) ((void) 0)
+#define PROFILE_INSTRUCTION(c8) ((void) 0)
+#endif
+
+// HOOKS =======================================================================
+static inline void profileInstruction(chip8Profile *p, uint16_t pc, uint16_t opcode) {
+    p->pcHits[pc]++;
+    p->opcodeCounts[classifyOpcode(opcode)]++;
+}
+
+static inline void profileKeyWait(chip8Profile *p) {
+    p->keyWaitCycles++;
+}
+
+static inline void profileDraw(chip8Profile *p) {
+    p->draws++;
+    p->frameDraws++;
+}
+
+static inline void profileFrame(chip8Profile *p) {
+    p->drawsPerFrame[p->frameDraws < PROFILE_DRAW_BUCKETS ? p->frameDraws : PROFILE_DRAW_BUCKETS - 1]++;
+    if(p->frameDraws > p->maxFrameDraws) {
+        p->maxFrameDraws = p->frameDraws;
+    }
+    p->frameDraws = 0;
+    p->frames++;
+}
+
+// REPORTS =====================================================================
+void resetProfile(chip8Profile *p);
+
+// Adds every counter in src to dst, for combining per-thread profiles
+void mergeProfile(chip8Profile *dst, const chip8Profile *src);
+
+// Key-wait time is reported in cycles and in emulated seconds at cyclesPerFrame
+void writeProfileJson(const chip8Profile *p, uint32_t cyclesPerFrame, FILE *out);
+void writeProfileCsv(const chip8Profile *p, uint32_t cyclesPerFrame, FILE *out);
+
+// Disassembles every address that was executed, with its hit count and share of all instructions
+// Backward jumps that were taken are listed first as loops, ranked by the instructions spent inside them
+void writeProfileListing(const chip8Profile *p, const uint8_t *memory, FILE *out);
+
+// Writes <base>.json (or <base>.csv) and the listing to <base>.lst, using the memory and frame length in c8
+int writeProfileFiles(const chip8Profile *p, const chip8 *c8, const char *base, bool csv);
+
+#endif // PROFILE_H_INCLUDE
@@ -0,0 +1,200 @@
+// Headless input replay
+// Runs a ROM against an input log recorded with `emu --record`, as fast as the host allows, and checks the screen at
+// every checkpoint in the log against what the recorded session showed
+// Build with: gcc -O2 Replay.c -o replay
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "Chip8.c"
+#include "Threaded.c"
+#include "Jit.c"
+#include "InputLog.c"
+
+typedef enum {
+    ENGINE_INTERP,
+    ENGINE_THREADED,
+    ENGINE_JIT
+} engineType;
+
+typedef struct {
+    engineType engine;
+    decodeCache *cache;
+    jitCache *jit;
+} replayEngine;
+
+double now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1E9;
+}
+
+// Runs until cycleCount reaches target or the machine faults
+// The engines return straight away on a key wait, so those cycles are stepped through emulateCycle, which only ticks
+// the timers until the log presses a key
+chip8Status runTo(chip8 *c8, replayEngine *e, uint64_t target) {
+    while(c8->cycleCount < target) {
+        chip8Status status;
+        uint64_t cycles = target - c8->cycleCount;
+        if(c8->keyWait) {
+            status = emulateCycle(c8);
+        } else if(e->engine == ENGINE_JIT) {
+            status = emulateCyclesJit(c8, e->jit, cycles);
+        } else if(e->engine == ENGINE_THREADED) {
+            status = emulateCyclesThreaded(c8, e->cache, cycles);
+        } else {
+            status = emulateCycles(c8, cycles);
+        }
+        if(status != CHIP8_OK) {
+            return status;
+        }
+    }
+    return CHIP8_OK;
+}
+
+void printUsage() {
+    printf("Usage: replay [options] <rom> <log>\n");
+    printf("  --engine <name>   interp, threaded or jit (default threaded)\n");
+    printf("  --quiet           Only print the summary, not each mismatched checkpoint\n");
+}
+
+int main(int argc, char *argv[]) {
+    replayEngine e = {ENGINE_THREADED, NULL, NULL};
+    bool quiet = false;
+    char *romName = NULL;
+    const char *logName = NULL;
+
+    for(int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if(strcmp(argv[i], "--engine") == 0 && hasValue) {
+            i++;
+            if(strcmp(argv[i], "interp") == 0) {
+                e.engine = ENGINE_INTERP;
+            } else if(strcmp(argv[i], "threaded") == 0) {
+                e.engine = ENGINE_THREADED;
+            } else if(strcmp(argv[i], "jit") == 0) {
+                e.engine = ENGINE_JIT;
+            } else {
+                printUsage();
+                return -1;
+            }
+        } else if(strcmp(argv[i], "--quiet") == 0) {
+            quiet = true;
+        } else if(!romName && argv[i][0] != '-') {
+            romName = argv[i];
+        } else if(!logName && argv[i][0] != '-') {
+            logName = argv[i];
+        } else {
+            printUsage();
+            return -1;
+        }
+    }
+    if(!romName || !logName) {
+        printUsage();
+        return -1;
+    }
+
+    inputReader log;
+    if(openInputLog(&log, logName) != 0) {
+        return -1;
+    }
+    chip8 c8;
+    if(initialize(&c8, romName, log.header.quirks, log.header.seed) != 0) {
+        closeInputLog(&log);
+        return -1;
+    }
+    c8.cyclesPerFrame = log.header.cyclesPerFrame;
+    if(hashProgram(&c8) != log.header.programHash) {
+        printf("%s is not the ROM %s was recorded with\n", romName, logName);
+        closeInputLog(&log);
+        return -1;
+    }
+
+    if(e.engine == ENGINE_THREADED) {
+        e.cache = malloc(sizeof(decodeCache));
+        resetDecodeCache(e.cache);
+    } else if(e.engine == ENGINE_JIT) {
+        e.jit = malloc(sizeof(jitCache));
+        if(initJit(e.jit) != 0) {
+            printf("JIT not available on this host\n");
+            closeInputLog(&log);
+            return -1;
+        }
+        resetJit(e.jit);
+    }
+
+    // REPLAY ==================================================================
+    // Keys are applied at exactly the cycle they were recorded at, before it runs, which is where the frontend applied
+    // them. Anything that goes differently shows up at the next checkpoint
+    uint64_t keyChanges = 0, checkpoints = 0, mismatches = 0;
+    bool ended = false, diverged = false;
+    chip8Status status = CHIP8_OK;
+    inputRecord record;
+    double start = now();
+    while(!diverged && readInputRecord(&log, &record) == 1) {
+        status = runTo(&c8, &e, record.cycle);
+        if(status != CHIP8_OK) {
+            printf("Faulted with %s at 0x%03X on cycle %llu, the recording ran on to cycle %llu\n",
+                   chip8StatusNames[status], c8.programCounter, (unsigned long long) c8.cycleCount,
+                   (unsigned long long) record.cycle);
+            diverged = true;
+            break;
+        }
+
+        switch(record.type) {
+            case INPUT_KEY_UP:
+            case INPUT_KEY_DOWN:
+                setKey(&c8, record.key, record.type == INPUT_KEY_DOWN);
+                keyChanges++;
+                break;
+            case INPUT_CHECKPOINT:
+                checkpoints++;
+                if(hashScreen(&c8) != record.screenHash) {
+                    mismatches++;
+                    if(!quiet) {
+                        printf("Checkpoint at cycle %llu (frame %llu): screen hash %016llx, recorded %016llx\n",
+                               (unsigned long long) record.cycle, (unsigned long long) (record.cycle / c8.cyclesPerFrame),
+                               (unsigned long long) hashScreen(&c8), (unsigned long long) record.screenHash);
+                    }
+                }
+                break;
+            case INPUT_END:
+                // A recorded fault stopped the session before its cycle ran, so running one more must fault the same way
+                if(record.status != CHIP8_OK) {
+                    status = runTo(&c8, &e, c8.cycleCount + 1);
+                    if(status != record.status) {
+                        printf("The recording ended with %s on cycle %llu, the replay got %s\n",
+                               chip8StatusNames[record.status], (unsigned long long) record.cycle,
+                               chip8StatusNames[status]);
+                        diverged = true;
+                    }
+                }
+                ended = true;
+                break;
+        }
+        if(ended) {
+            break;
+        }
+    }
+    double elapsed = now() - start;
+    if(!ended && !diverged) {
+        printf("%s is cut short or malformed, the session may not have ended cleanly\n", logName);
+    }
+    closeInputLog(&log);
+
+    double emulatedSeconds = (double) c8.cycleCount / c8.cyclesPerFrame / 60;
+    printf("Replayed %llu cycles (%.1f s emulated) in %.3f s, %.0fx real time\n", (unsigned long long) c8.cycleCount,
+           emulatedSeconds, elapsed, elapsed > 0 ? emulatedSeconds / elapsed : 0);
+    printf("%llu key changes, %llu of %llu checkpoints matched\n", (unsigned long long) keyChanges,
+           (unsigned long long) (checkpoints - mismatches), (unsigned long long) checkpoints);
+
+    free(e.cache);
+    if(e.jit) {
+        freeJit(e.jit);
+        free(e.jit);
+    }
+    return ended && !diverged && mismatches == 0 ? 0 : -1;
+}
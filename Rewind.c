@@ -0,0 +1,160 @@
+#ifndef REWIND_C_INCLUDE
+#define REWIND_C_INCLUDE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Chip8.c"
+#include "State.c"
+#include "Bytes.c"
+#include "Rewind.h"
+
+int initRewind(rewindBuffer *r, size_t bytes, int maxFrames) {
+    r->data = malloc(bytes);
+    r->entries = malloc(maxFrames * sizeof(rewindEntry));
+    if(!r->data || !r->entries || maxFrames < 1) {
+        printf("Could not allocate rewind buffer\n");
+        free(r->data);
+        free(r->entries);
+        return -1;
+    }
+    r->capacity = bytes;
+    r->maxEntries = maxFrames;
+    resetRewind(r);
+    return 0;
+}
+
+void freeRewind(rewindBuffer *r) {
+    free(r->data);
+    free(r->entries);
+    r->data = NULL;
+    r->entries = NULL;
+}
+
+void resetRewind(rewindBuffer *r) {
+    r->head = 0;
+    r->first = 0;
+    r->count = 0;
+    r->hasLatest = false;
+}
+
+// DELTA ENCODING ==============================================================
+// A delta is a list of (zero run, literal length, literal bytes) with both lengths as LEB128 varints
+// Literals only end at two or more zeros in a row, so the output is never more than a few bytes longer than the input
+
+// Encodes a XOR b into out and returns the length
+static size_t encodeDelta(const uint8_t *a, const uint8_t *b, uint8_t *out) {
+    uint8_t *p = out;
+    size_t i = 0;
+    while(i < STATE_SIZE) {
+        size_t zeros = 0;
+        while(i + zeros < STATE_SIZE && a[i + zeros] == b[i + zeros]) {
+            zeros++;
+        }
+        i += zeros;
+        if(i == STATE_SIZE) {
+            break; // Trailing zeros are implied
+        }
+
+        size_t start = i;
+        while(i < STATE_SIZE) {
+            if(a[i] == b[i] && (i + 1 == STATE_SIZE || a[i + 1] == b[i + 1])) {
+                break;
+            }
+            i++;
+        }
+
+        p = putVarint(p, zeros);
+        p = putVarint(p, i - start);
+        for(size_t j = start; j < i; j++) {
+            *p++ = a[j] ^ b[j];
+        }
+    }
+    return p - out;
+}
+
+// XORs an encoded delta into state
+static void applyDelta(uint8_t *state, const uint8_t *delta, size_t length) {
+    const uint8_t *p = delta;
+    const uint8_t *end = delta + length;
+    size_t i = 0;
+    while(p < end) {
+        i += getVarint(&p);
+        size_t literal = getVarint(&p);
+        for(size_t j = 0; j < literal; j++) {
+            state[i++] ^= *p++;
+        }
+    }
+}
+
+// RING ========================================================================
+static void dropOldest(rewindBuffer *r) {
+    r->first = (r->first + 1) % r->maxEntries;
+    r->count--;
+}
+
+// Finds a spot for length bytes, dropping the oldest deltas until it doesn't overlap anything still kept
+static size_t makeRoom(rewindBuffer *r, size_t length) {
+    for(;;) {
+        if(r->count == 0) {
+            r->head = 0;
+            return 0;
+        }
+
+        rewindEntry *oldest = &r->entries[r->first];
+        size_t position = r->head + length <= r->capacity ? r->head : 0;
+        if(r->count == r->maxEntries) {
+            dropOldest(r);
+        } else if(position == 0 && r->head != 0 && oldest->offset >= r->head) {
+            // Wrapping to the start while the ring has wrapped already, everything past head is older than the start
+            dropOldest(r);
+        } else if(oldest->offset < position + length && position < oldest->offset + oldest->length) {
+            dropOldest(r);
+        } else {
+            return position;
+        }
+    }
+}
+
+void pushRewind(rewindBuffer *r, const chip8 *c8) {
+    saveState(c8, r->current);
+    if(!r->hasLatest) {
+        memcpy(r->latest, r->current, STATE_SIZE);
+        r->hasLatest = true;
+        return;
+    }
+
+    // The delta turns the new state back into the previous one
+    size_t length = encodeDelta(r->current, r->latest, r->encoded);
+    if(length > r->capacity) {
+        // Can't keep this one, history starts over from here
+        resetRewind(r);
+        memcpy(r->latest, r->current, STATE_SIZE);
+        r->hasLatest = true;
+        return;
+    }
+
+    size_t position = makeRoom(r, length);
+    memcpy(&r->data[position], r->encoded, length);
+    r->entries[(r->first + r->count) % r->maxEntries] = (rewindEntry) {position, length};
+    r->count++;
+    r->head = position + length;
+    memcpy(r->latest, r->current, STATE_SIZE);
+}
+
+int popRewind(rewindBuffer *r, chip8 *c8) {
+    if(!r->hasLatest || r->count == 0) {
+        return -1;
+    }
+
+    rewindEntry *newest = &r->entries[(r->first + r->count - 1) % r->maxEntries];
+    applyDelta(r->latest, &r->data[newest->offset], newest->length);
+    r->head = newest->offset;
+    r->count--;
+    return loadState(c8, r->latest, STATE_SIZE);
+}
+
+#endif // REWIND_C_INCLUDE
@@ -0,0 +1,44 @@
+#ifndef REWIND_H_INCLUDE
+#define REWIND_H_INCLUDE
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Chip8.h"
+#include "State.h"
+
+// Where one delta lives in the ring
+typedef struct {
+    size_t offset;
+    size_t length;
+} rewindEntry;
+
+// History of save states, newest first
+// Only the latest state is kept whole. Each older one is stored as the XOR of it and the state after it, run-length
+// encoded, so a frame where little changed costs a few dozen bytes. The oldest deltas are dropped when space runs out
+typedef struct {
+    uint8_t *data;         // Ring of encoded deltas, entries are never split across the end
+    size_t capacity;
+    size_t head;           // Where the next delta would go
+    rewindEntry *entries;  // Circular, oldest at entries[first]
+    int maxEntries, first, count;
+
+    bool hasLatest;
+    uint8_t latest[STATE_SIZE];
+    uint8_t current[STATE_SIZE];
+    uint8_t encoded[STATE_SIZE * 2]; // Worst case for the encoder, see encodeDelta
+} rewindBuffer;
+
+// bytes is the space for deltas, maxFrames caps the history length regardless of how small the deltas are
+int initRewind(rewindBuffer *r, size_t bytes, int maxFrames);
+void freeRewind(rewindBuffer *r);
+void resetRewind(rewindBuffer *r);
+
+// Records the current state. Call once per frame
+void pushRewind(rewindBuffer *r, const chip8 *c8);
+
+// Restores the state from before the latest push and forgets the latest. Returns -1 when there's no older state
+int popRewind(rewindBuffer *r, chip8 *c8);
+
+#endif // REWIND_H_INCLUDE
@@ -0,0 +1,110 @@
+#ifndef ROMCACHE_C_INCLUDE
+#define ROMCACHE_C_INCLUDE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "Chip8.c"
+#include "RomCache.h"
+
+// Process-wide. Lookups and loads both take the lock, which is only held for a hash walk unless a file is being mapped
+static romImage *romBuckets[ROM_CACHE_BUCKETS];
+static pthread_mutex_t romCacheLock = PTHREAD_MUTEX_INITIALIZER;
+
+// FNV-1a over the path
+static uint32_t hashPath(const char *path) {
+    uint32_t hash = 0x811C9DC5;
+    for(const char *c = path; *c; c++) {
+        hash ^= (uint8_t) *c;
+        hash *= 0x01000193;
+    }
+    return hash;
+}
+
+// Maps the whole file read-only. Returns -1 with nothing left open on failure
+static int mapRom(const char *path, romImage *image) {
+    int fd = open(path, O_RDONLY);
+    if(fd == -1) {
+        printf("Could not find ROM %s\n", path);
+        return -1;
+    }
+
+    struct stat info;
+    if(fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size > MAX_ROM_SIZE) {
+        printf("ROM too large or invalid file type: %s\n", path);
+        close(fd);
+        return -1;
+    }
+
+    image->size = info.st_size;
+    image->data = NULL;
+    if(image->size > 0) {
+        void *data = mmap(NULL, image->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(data == MAP_FAILED) {
+            printf("Could not map ROM %s\n", path);
+            close(fd);
+            return -1;
+        }
+        image->data = data;
+    }
+
+    // The mapping stays valid once the descriptor is closed
+    close(fd);
+    return 0;
+}
+
+const romImage *loadRom(const char *path) {
+    uint32_t bucket = hashPath(path) % ROM_CACHE_BUCKETS;
+
+    pthread_mutex_lock(&romCacheLock);
+    romImage *image = romBuckets[bucket];
+    while(image && strcmp(image->path, path) != 0) {
+        image = image->next;
+    }
+
+    if(!image) {
+        image = malloc(sizeof(romImage));
+        if(mapRom(path, image) != 0) {
+            free(image);
+            image = NULL;
+        } else {
+            image->path = strdup(path);
+            image->next = romBuckets[bucket];
+            romBuckets[bucket] = image;
+        }
+    }
+    pthread_mutex_unlock(&romCacheLock);
+    return image;
+}
+
+void freeRomCache(void) {
+    pthread_mutex_lock(&romCacheLock);
+    for(int bucket = 0; bucket < ROM_CACHE_BUCKETS; bucket++) {
+        romImage *image = romBuckets[bucket];
+        while(image) {
+            romImage *next = image->next;
+            if(image->data) {
+                munmap((void *) image->data, image->size);
+            }
+            free(image->path);
+            free(image);
+            image = next;
+        }
+        romBuckets[bucket] = NULL;
+    }
+    pthread_mutex_unlock(&romCacheLock);
+}
+
+int initializeFromRom(chip8 *c8, const romImage *rom, quirkProfile quirks, uint64_t seed) {
+    return initializeFromMemory(c8, rom->data, rom->size, quirks, seed);
+}
+
+#endif // ROMCACHE_C_INCLUDE
@@ -0,0 +1,32 @@
+#ifndef ROMCACHE_H_INCLUDE
+#define ROMCACHE_H_INCLUDE
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Chip8.h"
+
+// Buckets in the path hash table. Chains grow past this, so it only has to be roughly the number of distinct ROMs
+#define ROM_CACHE_BUCKETS 256
+
+// One ROM file, read once and shared by every instance started from it. Never written to
+typedef struct romImage {
+    char *path;
+    const uint8_t *data; // mmap'd file contents, or NULL for an empty file
+    size_t size;
+    struct romImage *next; // Next image in the same bucket
+} romImage;
+
+// Returns the image for path, mapping the file the first time the path is seen
+// Returns NULL when the file can't be opened or is larger than MAX_ROM_SIZE. Failures aren't cached
+// Safe to call from any thread. Images stay valid until freeRomCache
+const romImage *loadRom(const char *path);
+
+// Unmaps every image. Nothing may be using them
+void freeRomCache(void);
+
+// initializeFromMemory from a cached image, one memcpy instead of a file read
+int initializeFromRom(chip8 *c8, const romImage *rom, quirkProfile quirks, uint64_t seed);
+
+#endif // ROMCACHE_H_INCLUDE
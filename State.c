@@ -0,0 +1,176 @@
+#ifndef STATE_C_INCLUDE
+#define STATE_C_INCLUDE
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Chip8.c"
+#include "Bytes.c"
+#include "State.h"
+
+static const uint8_t stateMagic[4] = {'C', '8', 'S', 'T'};
+
+// WRITING =====================================================================
+void saveState(const chip8 *c8, uint8_t *buffer) {
+    uint8_t *p = buffer;
+
+    memcpy(p, stateMagic, 4);
+    p += 4;
+    p = putLittleEndian(p, STATE_VERSION, 4);
+    *p++ = c8->quirks;
+
+    memcpy(p, c8->V, 16);
+    p += 16;
+    memcpy(p, c8->memory, 4096);
+    p += 4096;
+    p = putLittleEndian(p, c8->opcode, 2);
+    p = putLittleEndian(p, c8->I, 2);
+    p = putLittleEndian(p, c8->programCounter, 2);
+    p = putLittleEndian(p, c8->stackPointer, 2);
+    for(int i = 0; i < 24; i++) {
+        p = putLittleEndian(p, c8->stack[i], 2);
+    }
+
+    // Rows are stored left to right so the bytes read like the screen
+    for(int y = 0; y < 32; y++) {
+        for(int shift = 56; shift >= 0; shift -= 8) {
+            *p++ = (c8->screen[y] >> shift) & 0xFF;
+        }
+    }
+    *p++ = c8->hiresMode;
+    for(int y = 0; y < 64; y++) {
+        for(int half = 0; half < 2; half++) {
+            for(int shift = 56; shift >= 0; shift -= 8) {
+                *p++ = (c8->hiresScreen[half][y] >> shift) & 0xFF;
+            }
+        }
+    }
+
+    *p++ = c8->keyWait;
+    *p++ = c8->displayWait;
+    *p++ = c8->keySpot;
+    *p++ = c8->delayTimer;
+    *p++ = c8->soundTimer;
+    memcpy(p, c8->rplFlags, 16);
+    p += 16;
+    p = putLittleEndian(p, c8->randomSeed, 8);
+    p = putLittleEndian(p, c8->randomState, 8);
+    p = putLittleEndian(p, c8->cycleCount, 8);
+    p = putLittleEndian(p, c8->cyclesPerFrame, 4);
+    p = putLittleEndian(p, c8->frameCycle, 4);
+}
+
+// READING =====================================================================
+int loadState(chip8 *c8, const uint8_t *buffer, size_t size) {
+    const uint8_t *p = buffer;
+    if(size != STATE_SIZE || memcmp(p, stateMagic, 4) != 0) {
+        printf("Not a save state\n");
+        return -1;
+    }
+    p += 4;
+    uint32_t version = getLittleEndian(&p, 4);
+    if(version != STATE_VERSION) {
+        printf("Save state version %u is not supported (expected %u)\n", version, STATE_VERSION);
+        return -1;
+    }
+    uint8_t quirks = *p++;
+    if(quirks >= QUIRK_PROFILE_COUNT) {
+        printf("Save state has an unknown quirk profile\n");
+        return -1;
+    }
+    c8->quirks = quirks;
+
+    memcpy(c8->V, p, 16);
+    p += 16;
+    memcpy(c8->memory, p, 4096);
+    p += 4096;
+    c8->opcode         = getLittleEndian(&p, 2);
+    c8->I              = getLittleEndian(&p, 2);
+    c8->programCounter = getLittleEndian(&p, 2);
+    c8->stackPointer   = getLittleEndian(&p, 2);
+    for(int i = 0; i < 24; i++) {
+        c8->stack[i] = getLittleEndian(&p, 2);
+    }
+
+    for(int y = 0; y < 32; y++) {
+        c8->screen[y] = 0;
+        for(int i = 0; i < 8; i++) {
+            c8->screen[y] = (c8->screen[y] << 8) | *p++;
+        }
+    }
+    c8->hiresMode = *p++ != 0;
+    for(int y = 0; y < 64; y++) {
+        for(int half = 0; half < 2; half++) {
+            c8->hiresScreen[half][y] = 0;
+            for(int i = 0; i < 8; i++) {
+                c8->hiresScreen[half][y] = (c8->hiresScreen[half][y] << 8) | *p++;
+            }
+        }
+    }
+
+    c8->keyWait        = *p++ != 0;
+    c8->displayWait    = *p++ != 0;
+    c8->keySpot        = *p++ & 0xF;
+    c8->delayTimer     = *p++;
+    c8->soundTimer     = *p++;
+    memcpy(c8->rplFlags, p, 16);
+    p += 16;
+    c8->randomSeed     = getLittleEndian(&p, 8);
+    c8->randomState    = getLittleEndian(&p, 8);
+    c8->cycleCount     = getLittleEndian(&p, 8);
+    c8->cyclesPerFrame = getLittleEndian(&p, 4);
+    c8->frameCycle     = getLittleEndian(&p, 4);
+
+    // A zero generator state would only ever produce zeros
+    if(c8->randomState == 0) {
+        seedRandom(c8, c8->randomSeed);
+    }
+
+    // A zero frame length would never tick the timers
+    if(c8->cyclesPerFrame == 0) {
+        c8->cyclesPerFrame = DEFAULT_CYCLES_PER_FRAME;
+    }
+
+    c8->awaitingRedraw = true;
+
+    // The cycle count may have gone back, so look for an idle loop again straight away
+    c8->idleCheckAt = c8->cycleCount;
+    c8->idleInterval = IDLE_MIN_INTERVAL;
+    return 0;
+}
+
+// FILES =======================================================================
+int saveStateFile(const chip8 *c8, const char *filename) {
+    uint8_t buffer[STATE_SIZE];
+    saveState(c8, buffer);
+
+    FILE *file = fopen(filename, "wb");
+    if(!file) {
+        printf("Could not open %s for writing\n", filename);
+        return -1;
+    }
+    size_t written = fwrite(buffer, 1, STATE_SIZE, file);
+    if(fclose(file) != 0 || written != STATE_SIZE) {
+        printf("Could not write save state to %s\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+int loadStateFile(chip8 *c8, const char *filename) {
+    uint8_t buffer[STATE_SIZE + 1];
+
+    FILE *file = fopen(filename, "rb");
+    if(!file) {
+        printf("Could not open %s\n", filename);
+        return -1;
+    }
+    // Read one byte more than a state so oversized files are caught by the size check
+    size_t size = fread(buffer, 1, sizeof(buffer), file);
+    fclose(file);
+    return loadState(c8, buffer, size);
+}
+
+#endif // STATE_C_INCLUDE
@@ -0,0 +1,33 @@
+#ifndef STATE_H_INCLUDE
+#define STATE_H_INCLUDE
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Chip8.h"
+
+// Bump whenever the layout below changes. Older states are rejected rather than guessed at
+#define STATE_VERSION 4
+
+// Every state is exactly this many bytes. All fields are written little-endian in a fixed order:
+// magic, version, quirks, V, memory, opcode, I, programCounter, stackPointer, stack, screen (rows, most significant
+// byte first), hiresMode, hiresScreen (rows, left to right), keyWait, displayWait, keySpot, delayTimer, soundTimer,
+// rplFlags, randomSeed, randomState, cycleCount, cyclesPerFrame, frameCycle
+// Version 2 replaced the 4 byte rand_r seed with the 8 byte seed and generator state
+// Version 3 added the SUPER-CHIP display mode, 128x64 plane and user flags
+// Version 4 replaced the modernCompat flag with the quirk profile, moved up front so it's checked first, and added displayWait
+#define STATE_SIZE (4 + 4 + 1 + 16 + 4096 + 4 * 2 + 24 * 2 + 32 * 8 + 1 + 64 * 16 + 5 + 16 + 8 + 8 + 8 + 4 + 4)
+
+// Writes the machine state to buffer, which must hold STATE_SIZE bytes
+// Held keys are frontend input, the event and audio rings belong to whoever listens and the idle settings are only
+// a speed-up, so none of them is saved
+void saveState(const chip8 *c8, uint8_t *buffer);
+
+// Returns -1 and leaves c8 untouched when the buffer isn't a state of this version
+// The screen is marked for a redraw. Engines with caches must be reset since memory changed
+int loadState(chip8 *c8, const uint8_t *buffer, size_t size);
+
+int saveStateFile(const chip8 *c8, const char *filename);
+int loadStateFile(chip8 *c8, const char *filename);
+
+#endif // STATE_H_INCLUDE
@@ -0,0 +1,469 @@
+#ifndef THREADED_C_INCLUDE
+#define THREADED_C_INCLUDE
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "Chip8.c"
+#include "Threaded.h"
+
+// Handler indices. Anything rare, or that draws, waits or reports, is left to emulateCycle (OP_INTERPRET)
+// so there is only one implementation of it
+enum {
+    OP_UNDECODED = 0,
+    OP_INTERPRET,
+    OP_00EE,
+    OP_1NNN,
+    OP_2NNN,
+    OP_3XNN,
+    OP_4XNN,
+    OP_5XY0,
+    OP_6XNN,
+    OP_7XNN,
+    OP_8XY0,
+    OP_8XY1,
+    OP_8XY2,
+    OP_8XY3,
+    OP_8XY1_VF, // VIP: the logic ops also clear VF
+    OP_8XY2_VF,
+    OP_8XY3_VF,
+    OP_8XY4,
+    OP_8XY5,
+    OP_8XY6_VX, // Modern: VX is shifted
+    OP_8XY6_VY, // Historical: VY is shifted and copied to VX
+    OP_8XY7,
+    OP_8XYE_VX,
+    OP_8XYE_VY,
+    OP_9XY0,
+    OP_ANNN,
+    OP_BNNN,
+    OP_BXNN,    // CHIP-48: jumps to XNN + VX
+    OP_EX9E,
+    OP_EXA1,
+    OP_FX07,
+    OP_FX15,
+    OP_FX18,
+    OP_FX1E,
+    OP_FX29,
+    OP_FX33, // Run by emulateCycle, then the written bytes are invalidated
+    OP_FX55, // Same as FX33
+    OP_FX65,    // Only where FX65 leaves I at I + X + 1, the interpreter handles the other memory quirks
+};
+
+void resetDecodeCache(decodeCache *cache) {
+    // OP_UNDECODED is 0, so clearing the cache marks every slot for decoding
+    memset(cache, 0, sizeof(decodeCache));
+}
+
+// The quirks are settled here, by picking the handler, so none of the handlers test for them
+static void decodeInstruction(const chip8 *c8, decodedInstruction *d, uint16_t address) {
+    // The last byte of memory has no second half, let the interpreter deal with it
+    if(address >= 4095) {
+        d->op = OP_INTERPRET;
+        return;
+    }
+
+    const chip8Quirks *q = &quirkProfiles[c8->quirks];
+    uint16_t opcode = (c8->memory[address] << 8) | c8->memory[address + 1];
+    d->x   = (opcode & 0x0F00) >> 8;
+    d->y   = (opcode & 0x00F0) >> 4;
+    d->nn  = (opcode & 0x00FF);
+    d->nnn = (opcode & 0x0FFF);
+    d->opcode = opcode;
+    d->op  = OP_INTERPRET;
+
+    switch(opcode & 0xF000) {
+        case 0x0000:
+            if(opcode == 0x00EE) {
+                d->op = OP_00EE;
+            }
+            break;
+        case 0x1000: d->op = OP_1NNN; break;
+        case 0x2000: d->op = OP_2NNN; break;
+        case 0x3000: d->op = OP_3XNN; break;
+        case 0x4000: d->op = OP_4XNN; break;
+        case 0x5000: d->op = OP_5XY0; break;
+        case 0x6000: d->op = OP_6XNN; break;
+        case 0x7000: d->op = OP_7XNN; break;
+        case 0x8000:
+            switch(opcode & 0x000F) {
+                case 0x0: d->op = OP_8XY0; break;
+                case 0x1: d->op = q->vfReset ? OP_8XY1_VF : OP_8XY1; break;
+                case 0x2: d->op = q->vfReset ? OP_8XY2_VF : OP_8XY2; break;
+                case 0x3: d->op = q->vfReset ? OP_8XY3_VF : OP_8XY3; break;
+                case 0x4: d->op = OP_8XY4; break;
+                case 0x5: d->op = OP_8XY5; break;
+                case 0x6: d->op = q->shiftVy ? OP_8XY6_VY : OP_8XY6_VX; break;
+                case 0x7: d->op = OP_8XY7; break;
+                case 0xE: d->op = q->shiftVy ? OP_8XYE_VY : OP_8XYE_VX; break;
+            }
+            break;
+        case 0x9000: d->op = OP_9XY0; break;
+        case 0xA000: d->op = OP_ANNN; break;
+        case 0xB000: d->op = q->jumpVx ? OP_BXNN : OP_BNNN; break;
+        case 0xE000:
+            if(d->nn == 0x9E) {
+                d->op = OP_EX9E;
+            } else if(d->nn == 0xA1) {
+                d->op = OP_EXA1;
+            }
+            break;
+        case 0xF000:
+            switch(d->nn) {
+                case 0x07: d->op = OP_FX07; break;
+                case 0x15: d->op = OP_FX15; break;
+                case 0x18: d->op = OP_FX18; break;
+                case 0x1E: d->op = OP_FX1E; break;
+                case 0x29: d->op = OP_FX29; break;
+                case 0x33: d->op = OP_FX33; break;
+                case 0x55: d->op = OP_FX55; break;
+                case 0x65: d->op = q->memory == MEMORY_I_PLUS_X_PLUS_1 ? OP_FX65 : OP_INTERPRET; break;
+            }
+            break;
+    }
+}
+
+// Writing a byte changes the instruction starting at it and the one starting just before it
+static void invalidateRange(decodeCache *cache, int first, int last) {
+    first = first > 0 ? first - 1 : 0;
+    last  = last < 4095 ? last : 4095;
+    for(int i = first; i <= last; i++) {
+        cache->code[i].op = OP_UNDECODED;
+    }
+}
+
+chip8Status emulateCyclesThreaded(chip8 *c8, decodeCache *cache, uint64_t cycles) {
+    static void *handlers[] = {
+        [OP_UNDECODED] = &&op_undecoded,
+        [OP_INTERPRET] = &&op_interpret,
+        [OP_00EE]      = &&op_00ee,
+        [OP_1NNN]      = &&op_1nnn,
+        [OP_2NNN]      = &&op_2nnn,
+        [OP_3XNN]      = &&op_3xnn,
+        [OP_4XNN]      = &&op_4xnn,
+        [OP_5XY0]      = &&op_5xy0,
+        [OP_6XNN]      = &&op_6xnn,
+        [OP_7XNN]      = &&op_7xnn,
+        [OP_8XY0]      = &&op_8xy0,
+        [OP_8XY1]      = &&op_8xy1,
+        [OP_8XY2]      = &&op_8xy2,
+        [OP_8XY3]      = &&op_8xy3,
+        [OP_8XY1_VF]   = &&op_8xy1_vf,
+        [OP_8XY2_VF]   = &&op_8xy2_vf,
+        [OP_8XY3_VF]   = &&op_8xy3_vf,
+        [OP_8XY4]      = &&op_8xy4,
+        [OP_8XY5]      = &&op_8xy5,
+        [OP_8XY6_VX]   = &&op_8xy6_vx,
+        [OP_8XY6_VY]   = &&op_8xy6_vy,
+        [OP_8XY7]      = &&op_8xy7,
+        [OP_8XYE_VX]   = &&op_8xye_vx,
+        [OP_8XYE_VY]   = &&op_8xye_vy,
+        [OP_9XY0]      = &&op_9xy0,
+        [OP_ANNN]      = &&op_annn,
+        [OP_BNNN]      = &&op_bnnn,
+        [OP_BXNN]      = &&op_bxnn,
+        [OP_EX9E]      = &&op_ex9e,
+        [OP_EXA1]      = &&op_exa1,
+        [OP_FX07]      = &&op_fx07,
+        [OP_FX15]      = &&op_fx15,
+        [OP_FX18]      = &&op_fx18,
+        [OP_FX1E]      = &&op_fx1e,
+        [OP_FX29]      = &&op_fx29,
+        [OP_FX33]      = &&op_fx33,
+        [OP_FX55]      = &&op_fx55,
+        [OP_FX65]      = &&op_fx65,
+    };
+
+    // Halted on FX0A, the caller has to resolve the wait with setKey first
+    if(c8->keyWait) {
+        return CHIP8_OK;
+    }
+
+    // Hot state lives in locals and is written back whenever emulateCycle runs or the engine returns
+    // Instead of counting frameCycle every instruction, the engine remembers the cycle the next timer tick lands on
+    // and only compares against whichever of that, the end of the budget or the next look for an idle loop comes first
+    uint8_t *V                = c8->V;
+    uint16_t pc               = c8->programCounter;
+    uint64_t cycleCount       = c8->cycleCount;
+    const uint32_t frameLimit = c8->cyclesPerFrame;
+    const uint64_t end        = cycleCount + cycles;
+    uint64_t tickAt, checkpoint;
+    decodedInstruction *d = NULL;
+    decodedInstruction *executed = NULL; // Last instruction run by this engine, for c8->opcode
+    int first, last;
+    chip8Status result = CHIP8_OK;
+
+#define SAVE_STATE() \
+    if(executed) { \
+        c8->opcode = executed->opcode; \
+    } \
+    c8->programCounter = pc; \
+    c8->cycleCount = cycleCount; \
+    c8->frameCycle = frameLimit - (tickAt - cycleCount)
+
+#define LOAD_STATE() \
+    pc = c8->programCounter; \
+    cycleCount = c8->cycleCount; \
+    tickAt = cycleCount + (c8->frameCycle < frameLimit ? frameLimit - c8->frameCycle : 1); \
+    SET_CHECKPOINT()
+
+#define SET_CHECKPOINT() \
+    checkpoint = tickAt < end ? tickAt : end; \
+    checkpoint = c8->idleCheckAt < checkpoint ? c8->idleCheckAt : checkpoint
+
+// A program counter past the cache is left to emulateCycle, which reports the fault
+#define DISPATCH() \
+    if(pc >= 4096) { \
+        goto op_interpret; \
+    } \
+    d = &cache->code[pc]; \
+    goto *handlers[d->op]
+
+// Same bookkeeping as the end of emulateCycle
+#define NEXT(PC) \
+    executed = d; \
+    pc = (PC); \
+    cycleCount++; \
+    if(cycleCount >= checkpoint) { \
+        goto checkpointReached; \
+    } \
+    DISPATCH()
+
+    // A DXYN from the last call may still be waiting on its tick
+    waitForDisplay(c8, end);
+    LOAD_STATE();
+    if(cycleCount >= end) {
+        goto done;
+    }
+    DISPATCH();
+
+op_undecoded:
+    decodeInstruction(c8, d, pc);
+    goto *handlers[d->op];
+
+op_interpret:
+    SAVE_STATE();
+    result = emulateCycle(c8);
+    // DXYN under the displayWait quirk holds everything until the next tick
+    waitForDisplay(c8, end);
+    LOAD_STATE();
+    executed = NULL; // emulateCycle already set c8->opcode
+    if(result != CHIP8_OK || c8->keyWait || cycleCount >= end) {
+        goto done;
+    }
+    DISPATCH();
+
+op_00ee:
+    // An empty or overrun stack faults in emulateCycle. Unsigned so 0 wraps past the test
+    if(c8->stackPointer - 1u >= 24) {
+        goto op_interpret;
+    }
+    c8->stackPointer--;
+    NEXT(c8->stack[c8->stackPointer] + 2);
+
+op_1nnn:
+    NEXT(d->nnn);
+
+op_2nnn:
+    if(c8->stackPointer >= 24) {
+        goto op_interpret;
+    }
+    c8->stack[c8->stackPointer] = pc;
+    c8->stackPointer++;
+    NEXT(d->nnn);
+
+op_3xnn:
+    NEXT(V[d->x] == d->nn ? pc + 4 : pc + 2);
+
+op_4xnn:
+    NEXT(V[d->x] != d->nn ? pc + 4 : pc + 2);
+
+op_5xy0:
+    NEXT(V[d->x] == V[d->y] ? pc + 4 : pc + 2);
+
+op_6xnn:
+    V[d->x] = d->nn;
+    NEXT(pc + 2);
+
+op_7xnn:
+    V[d->x] += d->nn;
+    NEXT(pc + 2);
+
+op_8xy0:
+    V[d->x] = V[d->y];
+    NEXT(pc + 2);
+
+op_8xy1:
+    V[d->x] |= V[d->y];
+    NEXT(pc + 2);
+
+op_8xy2:
+    V[d->x] &= V[d->y];
+    NEXT(pc + 2);
+
+op_8xy3:
+    V[d->x] ^= V[d->y];
+    NEXT(pc + 2);
+
+op_8xy1_vf:
+    V[d->x] |= V[d->y];
+    V[0xF] = 0;
+    NEXT(pc + 2);
+
+op_8xy2_vf:
+    V[d->x] &= V[d->y];
+    V[0xF] = 0;
+    NEXT(pc + 2);
+
+op_8xy3_vf:
+    V[d->x] ^= V[d->y];
+    V[0xF] = 0;
+    NEXT(pc + 2);
+
+    // The flag writes below happen in the same order as in emulateCycle so X or Y == F behaves the same
+op_8xy4:
+    V[0xF] = V[d->y] > (0xFF - V[d->x]);
+    V[d->x] += V[d->y];
+    NEXT(pc + 2);
+
+op_8xy5:
+    V[0xF] = V[d->x] >= V[d->y];
+    V[d->x] -= V[d->y];
+    NEXT(pc + 2);
+
+op_8xy6_vx:
+    V[0xF] = V[d->x] & 1;
+    V[d->x] = V[d->x] >> 1;
+    NEXT(pc + 2);
+
+op_8xy6_vy:
+    V[0xF] = V[d->y] & 1;
+    V[d->y] = V[d->y] >> 1;
+    V[d->x] = V[d->y];
+    NEXT(pc + 2);
+
+op_8xy7:
+    V[0xF] = V[d->x] <= V[d->y];
+    V[d->x] = V[d->y] - V[d->x];
+    NEXT(pc + 2);
+
+op_8xye_vx:
+    V[0xF] = (V[d->x] >> 7) & 1;
+    V[d->x] = V[d->x] << 1;
+    NEXT(pc + 2);
+
+op_8xye_vy:
+    V[0xF] = (V[d->y] >> 7) & 1;
+    V[d->y] = V[d->y] << 1;
+    V[d->x] = V[d->y];
+    NEXT(pc + 2);
+
+op_9xy0:
+    NEXT(V[d->x] != V[d->y] ? pc + 4 : pc + 2);
+
+op_annn:
+    c8->I = d->nnn;
+    NEXT(pc + 2);
+
+op_bnnn:
+    NEXT(V[0] + d->nnn);
+
+op_bxnn:
+    NEXT(V[d->x] + d->nnn);
+
+op_ex9e:
+    NEXT(c8->keys[V[d->x] & 0xF] != 0 ? pc + 4 : pc + 2);
+
+op_exa1:
+    NEXT(c8->keys[V[d->x] & 0xF] == 0 ? pc + 4 : pc + 2);
+
+op_fx07:
+    V[d->x] = c8->delayTimer;
+    NEXT(pc + 2);
+
+op_fx15:
+    c8->delayTimer = V[d->x];
+    NEXT(pc + 2);
+
+op_fx18:
+    // The tone is queued by emulateCycle, which needs the cycle and frame position stored
+    if(c8->audio) {
+        goto op_interpret;
+    }
+    c8->soundTimer = V[d->x];
+    NEXT(pc + 2);
+
+op_fx1e:
+    V[0xF] = (c8->I + V[d->x]) > 0xFFF;
+    c8->I += V[d->x];
+    NEXT(pc + 2);
+
+op_fx29:
+    c8->I = V[d->x] * 0x5;
+    NEXT(pc + 2);
+
+op_fx33:
+    first = c8->I;
+    last  = c8->I + 2;
+    goto store;
+
+op_fx55:
+    first = c8->I;
+    last  = c8->I + d->x;
+    goto store;
+
+store:
+    SAVE_STATE();
+    result = emulateCycle(c8);
+    LOAD_STATE();
+    executed = NULL; // emulateCycle already set c8->opcode
+    invalidateRange(cache, first, last);
+    if(result != CHIP8_OK || c8->keyWait || cycleCount >= end) {
+        goto done;
+    }
+    DISPATCH();
+
+op_fx65:
+    if(c8->I + d->x > 0xFFF) {
+        goto op_interpret;
+    }
+    for(int i = 0; i <= d->x; i++) {
+        V[i] = c8->memory[c8->I + i];
+    }
+    c8->I += d->x + 1;
+    NEXT(pc + 2);
+
+checkpointReached:
+    if(cycleCount == tickAt) {
+        tickTimers(c8);
+        tickAt += frameLimit;
+        SET_CHECKPOINT();
+    }
+    if(cycleCount >= end) {
+        goto done;
+    }
+    if(cycleCount >= c8->idleCheckAt) {
+        // skipIdle only runs instructions that don't write memory, so the decode cache stays valid
+        SAVE_STATE();
+        skipIdle(c8, end - cycleCount);
+        LOAD_STATE();
+        executed = NULL;
+        if(cycleCount >= end) {
+            goto done;
+        }
+    }
+    DISPATCH();
+
+done:
+    SAVE_STATE();
+    return result;
+
+#undef SAVE_STATE
+#undef LOAD_STATE
+#undef SET_CHECKPOINT
+#undef DISPATCH
+#undef NEXT
+}
+
+#endif // THREADED_C_INCLUDE
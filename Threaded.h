@@ -0,0 +1,31 @@
+#ifndef THREADED_H_INCLUDE
+#define THREADED_H_INCLUDE
+
+#include <stdint.h>
+
+#include "Chip8.h"
+
+// An instruction with its operands already pulled out of the opcode
+// op is the index of the handler that runs it, see the enum in Threaded.c
+typedef struct {
+    uint8_t  op;
+    uint8_t  x, y, nn;
+    uint16_t nnn;
+    uint16_t opcode; // Only written back to c8->opcode when the engine stops
+} decodedInstruction;
+
+// One slot per address since jumps can land on odd addresses
+// Slots are decoded the first time they run and cleared again when FX33/FX55 write over them
+typedef struct {
+    decodedInstruction code[4096];
+} decodeCache;
+
+// Must be called before first use, and again whenever memory or the quirk profile is changed from outside the engine
+void resetDecodeCache(decodeCache *cache);
+
+// Runs up to `cycles` cycles with the predecoded engine. Stops early when FX0A starts a key wait, and runs nothing while one is pending
+// Results, faults and events included, are identical to calling emulateCycle the same number of times
+// Idle loops are fast-forwarded through skipIdle
+chip8Status emulateCyclesThreaded(chip8 *c8, decodeCache *cache, uint64_t cycles);
+
+#endif // THREADED_H_INCLUDE
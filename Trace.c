@@ -0,0 +1,138 @@
+#ifndef TRACE_C_INCLUDE
+#define TRACE_C_INCLUDE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Chip8.c"
+#include "Bytes.c"
+#include "Trace.h"
+
+static const uint8_t traceMagic[4] = {'C', '8', 'T', 'R'};
+
+void resetTrace(chip8Trace *t) {
+    t->written = 0;
+}
+
+// WRITING =====================================================================
+int writeTraceFile(const chip8Trace *t, const chip8 *c8, chip8Status status, const char *filename) {
+    FILE *file = fopen(filename, "wb");
+    if(!file) {
+        printf("Could not open %s for writing\n", filename);
+        return -1;
+    }
+
+    fwrite(traceMagic, 1, 4, file);
+    writeLittleEndian(file, TRACE_VERSION, 4);
+    writeLittleEndian(file, c8->randomSeed, 8);
+    writeLittleEndian(file, c8->quirks, 1);
+    writeLittleEndian(file, c8->cyclesPerFrame, 4);
+    writeLittleEndian(file, c8->cycleCount, 8);
+    writeLittleEndian(file, status, 1);
+
+    writeLittleEndian(file, c8->programCounter, 2);
+    writeLittleEndian(file, c8->opcode, 2);
+    writeLittleEndian(file, c8->I, 2);
+    fwrite(c8->V, 1, 16, file);
+    writeLittleEndian(file, c8->stackPointer, 1);
+    for(int i = 0; i < 24; i++) {
+        writeLittleEndian(file, c8->stack[i], 2);
+    }
+
+    // Oldest first. Until the ring has wrapped, that's the start of it
+    uint32_t count = t->written < TRACE_RING_SIZE ? t->written : TRACE_RING_SIZE;
+    writeLittleEndian(file, t->written, 8);
+    writeLittleEndian(file, count, 4);
+    for(uint64_t n = t->written - count; n < t->written; n++) {
+        const traceRecord *r = &t->records[n & (TRACE_RING_SIZE - 1)];
+        writeLittleEndian(file, r->pc, 2);
+        writeLittleEndian(file, r->opcode, 2);
+        writeLittleEndian(file, r->I, 2);
+        writeLittleEndian(file, r->vx, 1);
+        writeLittleEndian(file, r->vf, 1);
+    }
+
+    bool failed = ferror(file);
+    if(fclose(file) != 0 || failed) {
+        printf("Could not write %s\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+// READING =====================================================================
+int readTraceFile(traceDump *d, const char *filename) {
+    d->records = NULL;
+    FILE *file = fopen(filename, "rb");
+    if(!file) {
+        printf("Could not open %s\n", filename);
+        return -1;
+    }
+
+    uint8_t magic[4];
+    uint64_t version, quirks, cyclesPerFrame, status, pc, opcode, I, stackPointer, count;
+    bool ok = fread(magic, 1, 4, file) == 4 && memcmp(magic, traceMagic, 4) == 0 &&
+              readLittleEndian(file, &version, 4) && version == TRACE_VERSION &&
+              readLittleEndian(file, &d->seed, 8) &&
+              readLittleEndian(file, &quirks, 1) && quirks < QUIRK_PROFILE_COUNT &&
+              readLittleEndian(file, &cyclesPerFrame, 4) && cyclesPerFrame != 0 &&
+              readLittleEndian(file, &d->cycleCount, 8) &&
+              readLittleEndian(file, &status, 1) && status < CHIP8_STATUS_COUNT &&
+              readLittleEndian(file, &pc, 2) && readLittleEndian(file, &opcode, 2) && readLittleEndian(file, &I, 2) &&
+              fread(d->V, 1, 16, file) == 16 &&
+              readLittleEndian(file, &stackPointer, 1) && stackPointer <= 24;
+    for(int i = 0; ok && i < 24; i++) {
+        uint64_t value;
+        ok = readLittleEndian(file, &value, 2);
+        d->stack[i] = value;
+    }
+    ok = ok && readLittleEndian(file, &d->written, 8) &&
+         readLittleEndian(file, &count, 4) && count <= TRACE_RING_SIZE && count <= d->written;
+    if(!ok) {
+        printf("%s is not a trace of version %d\n", filename, TRACE_VERSION);
+        fclose(file);
+        return -1;
+    }
+
+    d->quirks = quirks;
+    d->cyclesPerFrame = cyclesPerFrame;
+    d->status = status;
+    d->pc = pc;
+    d->opcode = opcode;
+    d->I = I;
+    d->stackPointer = stackPointer;
+    d->count = count;
+    d->records = malloc(count * sizeof(traceRecord));
+    if(!d->records && count > 0) {
+        printf("Could not allocate %u trace records\n", d->count);
+        fclose(file);
+        return -1;
+    }
+    for(uint32_t n = 0; n < count; n++) {
+        uint8_t bytes[8];
+        if(fread(bytes, 1, 8, file) != 8) {
+            printf("%s is cut short\n", filename);
+            freeTraceDump(d);
+            fclose(file);
+            return -1;
+        }
+        traceRecord *r = &d->records[n];
+        r->pc = bytes[0] | bytes[1] << 8;
+        r->opcode = bytes[2] | bytes[3] << 8;
+        r->I = bytes[4] | bytes[5] << 8;
+        r->vx = bytes[6];
+        r->vf = bytes[7];
+    }
+    fclose(file);
+    return 0;
+}
+
+void freeTraceDump(traceDump *d) {
+    free(d->records);
+    d->records = NULL;
+}
+
+#endif // TRACE_C_INCLUDE
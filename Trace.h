@@ -0,0 +1,111 @@
+#ifndef TRACE_H_INCLUDE
+#define TRACE_H_INCLUDE
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Chip8.h"
+
+// Bump whenever the dump layout below changes. Older dumps are rejected rather than guessed at
+#define TRACE_VERSION 1
+
+// Records kept per instance, the last 64K instructions. A power of two so the ring index is a mask
+#define TRACE_RING_SIZE (64 * 1024)
+
+// pc of a record standing for an idle loop skipIdle fast-forwarded through instead of an instruction
+#define TRACE_SKIP 0xFFFF
+
+// Eight bytes an instruction, the state it left behind. An idle skip record keeps the cycles skipped in the other
+// fields instead, see traceSkippedCycles
+typedef struct {
+    uint16_t pc;     // Address the instruction was fetched from
+    uint16_t opcode;
+    uint16_t I;
+    uint8_t  vx;     // VX, with X from the opcode
+    uint8_t  vf;
+} traceRecord;
+
+// Filled in by emulateCycle when the build defines CHIP8_TRACE and c8->trace is set
+// Only the interpreter records, like the profiler. The threaded, JIT and lockstep engines never call into it
+typedef struct chip8Trace {
+    uint64_t written; // Records since resetTrace, the ring holds the last TRACE_RING_SIZE of them
+    traceRecord records[TRACE_RING_SIZE];
+} chip8Trace;
+
+// Without CHIP8_TRACE the hooks expand to nothing and chip8 has no trace field, so a normal build pays nothing
+// With it, an instruction costs a pointer test and one eight byte record when tracing is on
+#ifdef CHIP8_TRACE
+#define TRACE_FETCH(c8) do { if((c8)->trace) { traceFetch((c8)->trace, (c8)->programCounter, (c8)->opcode); } } while(0)
+#define TRACE_RETIRE(c8) do { if((c8)->trace) { traceRetire((c8)->trace, (c8)); } } while(0)
+#define TRACE_SKIP_CYCLES(c8, cycles) do { if((c8)->trace) { traceSkip((c8)->trace, (cycles)); } } while(0)
+#else
+#define TRACE_FETCH(c8) ((void) 0)
+#define TRACE_RETIRE(c8) ((void) 0)
+#define TRACE_SKIP_CYCLES(c8, cycles) ((void) 0)
+#endif
+
+// HOOKS =======================================================================
+// The record is started at fetch and only counted once the instruction has run, so a fault leaves it uncounted and
+// the dump shows the faulting instruction from the machine instead
+static inline void traceFetch(chip8Trace *t, uint16_t pc, uint16_t opcode) {
+    traceRecord *r = &t->records[t->written & (TRACE_RING_SIZE - 1)];
+    r->pc = pc;
+    r->opcode = opcode;
+}
+
+static inline void traceRetire(chip8Trace *t, const chip8 *c8) {
+    traceRecord *r = &t->records[t->written & (TRACE_RING_SIZE - 1)];
+    r->I = c8->I;
+    r->vx = c8->V[(r->opcode & 0x0F00) >> 8];
+    r->vf = c8->V[0xF];
+    t->written++;
+}
+
+static inline void traceSkip(chip8Trace *t, uint64_t cycles) {
+    traceRecord *r = &t->records[t->written & (TRACE_RING_SIZE - 1)];
+    r->pc = TRACE_SKIP;
+    r->opcode = cycles & 0xFFFF;
+    r->I = (cycles >> 16) & 0xFFFF;
+    r->vx = (cycles >> 32) & 0xFF;
+    r->vf = (cycles >> 40) & 0xFF;
+    t->written++;
+}
+
+static inline uint64_t traceSkippedCycles(const traceRecord *r) {
+    return r->opcode | (uint64_t) r->I << 16 | (uint64_t) r->vx << 32 | (uint64_t) r->vf << 40;
+}
+
+// DUMPS =======================================================================
+// Everything is little-endian
+// Header: magic "C8TR", version (4), seed (8), quirks (1), cyclesPerFrame (4), cycleCount (8), chip8Status (1)
+// Then the machine as it stopped: pc (2), opcode (2), I (2), V (16), stackPointer (1), stack (24 * 2)
+// Then written (8), the record count (4) and the records oldest first: pc (2), opcode (2), I (2), vx (1), vf (1)
+// When the status is a fault, pc and opcode are the instruction that faulted, which has no record of its own
+typedef struct {
+    uint64_t seed;
+    quirkProfile quirks;
+    uint32_t cyclesPerFrame;
+    uint64_t cycleCount;
+    chip8Status status;
+    uint16_t pc, opcode, I;
+    uint8_t V[16];
+    uint8_t stackPointer;
+    uint16_t stack[24];
+    uint64_t written;
+    uint32_t count;
+    traceRecord *records;
+} traceDump;
+
+void resetTrace(chip8Trace *t);
+
+// Writes the ring and the state of c8 to filename. status is what stopped the machine, CHIP8_OK for a dump on demand
+// Returns -1 if any write failed
+int writeTraceFile(const chip8Trace *t, const chip8 *c8, chip8Status status, const char *filename);
+
+// Returns -1 when the file can't be read, is cut short or isn't a dump of this version
+int readTraceFile(traceDump *d, const char *filename);
+
+void freeTraceDump(traceDump *d);
+
+#endif // TRACE_H_INCLUDE
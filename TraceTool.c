@@ -0,0 +1,308 @@
+// Trace decoder
+// Turns a dump written by `batch --trace` or `emu --trace` into annotated disassembly: what each instruction left in
+// the registers it wrote, indented by call depth, with repeated loop iterations folded away
+// Build with: gcc -O2 TraceTool.c -o tracetool
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Chip8.c"
+#include "Trace.c"
+
+// Iterations further back than this many records aren't looked for when folding a loop
+#define TRACE_MAX_LOOP_BODY 256
+
+// Entries in each table of the summary
+#define TRACE_MAX_SUMMARY 10
+
+typedef struct {
+    uint16_t from, to; // For a loop, the backward jump and its target. For a call, the 2NNN and the subroutine
+    uint64_t count;
+} traceEdge;
+
+typedef struct {
+    traceEdge *edges;
+    int count;
+} edgeTable;
+
+static void countEdge(edgeTable *t, uint16_t from, uint16_t to, uint64_t times) {
+    for(int i = 0; i < t->count; i++) {
+        if(t->edges[i].from == from && t->edges[i].to == to) {
+            t->edges[i].count += times;
+            return;
+        }
+    }
+    t->edges = realloc(t->edges, (t->count + 1) * sizeof(traceEdge));
+    t->edges[t->count++] = (traceEdge) {from, to, times};
+}
+
+static int compareEdges(const void *a, const void *b) {
+    const traceEdge *x = a;
+    const traceEdge *y = b;
+    return x->count < y->count ? 1 : x->count > y->count ? -1 : 0;
+}
+
+// A jump that went back to or before itself, closing a loop
+static bool isBackwardJump(const traceRecord *r, const traceRecord *next) {
+    opcodeClass c = classifyOpcode(r->opcode);
+    return (c == CLASS_1NNN || c == CLASS_BNNN) && next->pc != TRACE_SKIP && next->pc <= r->pc;
+}
+
+// Call depth after the records from start to end, relative to before them
+static int depthChange(const traceRecord *records, uint32_t start, uint32_t end) {
+    int depth = 0;
+    for(uint32_t n = start; n < end; n++) {
+        if(records[n].pc == TRACE_SKIP) {
+            continue;
+        }
+        opcodeClass c = classifyOpcode(records[n].opcode);
+        depth += c == CLASS_2NNN ? 1 : c == CLASS_00EE ? -1 : 0;
+    }
+    return depth;
+}
+
+static bool samePath(const traceRecord *records, uint32_t a, uint32_t b, uint32_t length) {
+    for(uint32_t n = 0; n < length; n++) {
+        if(records[a + n].pc != records[b + n].pc) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// What the instruction left behind, from the fields of its record. nextPc is where it went, -1 if unknown
+static void describeEffect(const traceRecord *r, int nextPc, char *out, size_t size) {
+    const int x = (r->opcode & 0x0F00) >> 8;
+    out[0] = '\0';
+    switch(classifyOpcode(r->opcode)) {
+        case CLASS_3XNN:
+        case CLASS_4XNN:
+        case CLASS_5XY0:
+        case CLASS_9XY0:
+        case CLASS_EX9E:
+        case CLASS_EXA1:
+            if(nextPc == r->pc + 4) {
+                snprintf(out, size, "skipped");
+            }
+            break;
+        case CLASS_6XNN:
+        case CLASS_7XNN:
+        case CLASS_8XY0:
+        case CLASS_8XY1:
+        case CLASS_8XY2:
+        case CLASS_8XY3:
+        case CLASS_CXNN:
+        case CLASS_FX07:
+        case CLASS_FX0A:
+        case CLASS_FX85:
+            snprintf(out, size, "V%X=0x%02X", x, r->vx);
+            break;
+        case CLASS_8XY4:
+        case CLASS_8XY5:
+        case CLASS_8XY6:
+        case CLASS_8XY7:
+        case CLASS_8XYE:
+            // With X = F the flag is all that's left
+            if(x == 0xF) {
+                snprintf(out, size, "VF=%d", r->vf);
+            } else {
+                snprintf(out, size, "V%X=0x%02X VF=%d", x, r->vx, r->vf);
+            }
+            break;
+        case CLASS_DXYN:
+            snprintf(out, size, "VF=%d", r->vf);
+            break;
+        case CLASS_ANNN:
+        case CLASS_FX1E:
+        case CLASS_FX29:
+        case CLASS_FX30:
+        case CLASS_FX55:
+            snprintf(out, size, "I=0x%03X", r->I);
+            break;
+        case CLASS_FX65:
+            snprintf(out, size, "V%X=0x%02X I=0x%03X", x, r->vx, r->I);
+            break;
+        case CLASS_BNNN:
+            if(nextPc >= 0) {
+                snprintf(out, size, "-> 0x%03X", nextPc);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void printInstruction(uint64_t number, uint16_t pc, uint16_t opcode, int depth, const char *effect) {
+    char text[32];
+    disassemble(opcode, text, sizeof(text));
+    if(effect[0] == '\0') {
+        printf("%10llu  %03X  %04X  %*s%s\n", (unsigned long long) number, pc, opcode, depth * 2, "", text);
+    } else {
+        printf("%10llu  %03X  %04X  %*s%-20s %s\n", (unsigned long long) number, pc, opcode, depth * 2, "", text, effect);
+    }
+}
+
+static void printSummary(const char *title, edgeTable *t, bool loops) {
+    printf("\n%s\n", title);
+    if(t->count == 0) {
+        printf("  none\n");
+        return;
+    }
+    qsort(t->edges, t->count, sizeof(traceEdge), compareEdges);
+    for(int i = 0; i < t->count && i < TRACE_MAX_SUMMARY; i++) {
+        if(loops) {
+            printf("  0x%03X-0x%03X  %llu iterations\n", t->edges[i].to, t->edges[i].from,
+                   (unsigned long long) t->edges[i].count);
+        } else {
+            printf("  0x%03X  %llu calls, from 0x%03X\n", t->edges[i].to, (unsigned long long) t->edges[i].count,
+                   t->edges[i].from);
+        }
+    }
+}
+
+void printUsage() {
+    printf("Usage: tracetool [options] <dump>\n");
+    printf("  --last <n>        Only list the last n records (default all of them)\n");
+    printf("  --no-fold         List every loop iteration instead of folding repeats\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *dumpName = NULL;
+    uint64_t last = UINT64_MAX;
+    bool fold = true;
+
+    for(int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if(strcmp(argv[i], "--last") == 0 && hasValue) {
+            last = strtoull(argv[++i], NULL, 0);
+        } else if(strcmp(argv[i], "--no-fold") == 0) {
+            fold = false;
+        } else if(!dumpName && argv[i][0] != '-') {
+            dumpName = argv[i];
+        } else {
+            printUsage();
+            return -1;
+        }
+    }
+    if(!dumpName) {
+        printUsage();
+        return -1;
+    }
+
+    traceDump d;
+    if(readTraceFile(&d, dumpName) != 0) {
+        return -1;
+    }
+
+    // HEADER ==================================================================
+    char text[32];
+    disassemble(d.opcode, text, sizeof(text));
+    printf("Seed %llu, %s quirks, %u cycles per frame\n", (unsigned long long) d.seed, quirkProfileNames[d.quirks],
+           d.cyclesPerFrame);
+    if(d.status != CHIP8_OK) {
+        printf("Faulted with %s on cycle %llu (frame %llu) at 0x%03X: %04X %s\n", chip8StatusNames[d.status],
+               (unsigned long long) d.cycleCount, (unsigned long long) (d.cycleCount / d.cyclesPerFrame), d.pc,
+               d.opcode, text);
+    } else {
+        printf("Dumped on cycle %llu (frame %llu) with pc at 0x%03X\n", (unsigned long long) d.cycleCount,
+               (unsigned long long) (d.cycleCount / d.cyclesPerFrame), d.pc);
+    }
+    printf("Registers:");
+    for(int i = 0; i < 16; i++) {
+        printf(" V%X=%02X", i, d.V[i]);
+    }
+    printf(" I=%03X\nStack:", d.I);
+    if(d.stackPointer == 0) {
+        printf(" empty");
+    }
+    for(int i = 0; i < d.stackPointer; i++) {
+        printf(" %03X", d.stack[i]);
+    }
+    printf("\nLast %u of %llu records\n\n", d.count, (unsigned long long) d.written);
+
+    // LISTING =================================================================
+    // The calls and returns in the ring account for the stack as it ended, whatever is left over was already on it
+    uint32_t first = d.count - (last < d.count ? last : d.count);
+    int depth = (int) d.stackPointer - depthChange(d.records, 0, d.count) + depthChange(d.records, 0, first);
+    if(depth < 0) {
+        depth = 0;
+    }
+    const uint64_t base = d.written - d.count;
+    for(uint32_t n = first; n < d.count; n++) {
+        const traceRecord *r = &d.records[n];
+        if(r->pc == TRACE_SKIP) {
+            printf("%10s  %*s... idle loop fast-forwarded %llu cycles\n", "", 11 + depth * 2, "",
+                   (unsigned long long) traceSkippedCycles(r));
+            continue;
+        }
+
+        // The faulting instruction never got a record, but it's still where this one went
+        int nextPc = n + 1 < d.count ? d.records[n + 1].pc : d.status != CHIP8_OK ? d.pc : -1;
+        if(nextPc == TRACE_SKIP) {
+            nextPc = -1;
+        }
+        char effect[48];
+        describeEffect(r, nextPc, effect, sizeof(effect));
+        printInstruction(base + n, r->pc, r->opcode, depth, effect);
+
+        opcodeClass c = classifyOpcode(r->opcode);
+        if(c == CLASS_2NNN) {
+            depth++;
+        } else if(c == CLASS_00EE && depth > 0) {
+            depth--;
+        }
+        if(n + 1 >= d.count || !isBackwardJump(r, &d.records[n + 1])) {
+            continue;
+        }
+
+        // The iteration that just ended is the records since the jump target last ran. Matching iterations after it
+        // are folded into one line, the last of them is listed in full
+        uint32_t start = n + 1;
+        uint32_t previous = n;
+        while(previous > first && start - previous < TRACE_MAX_LOOP_BODY && d.records[previous].pc != d.records[start].pc) {
+            previous--;
+        }
+        uint32_t length = start - previous;
+        if(!fold || d.records[previous].pc != d.records[start].pc || depthChange(d.records, previous, start) != 0) {
+            continue;
+        }
+        uint32_t repeats = 0;
+        while(start + (repeats + 1) * length <= d.count && samePath(d.records, previous, start + repeats * length, length)) {
+            repeats++;
+        }
+        if(repeats >= 2) {
+            printf("%10s  %*s... %u more iteration%s of 0x%03X-0x%03X\n", "", 11 + depth * 2, "", repeats - 1,
+                   repeats == 2 ? "" : "s", d.records[start].pc, r->pc);
+            n += (repeats - 1) * length;
+        }
+    }
+    if(d.status != CHIP8_OK) {
+        char effect[48];
+        snprintf(effect, sizeof(effect), "<- %s", chip8StatusNames[d.status]);
+        printInstruction(d.written, d.pc, d.opcode, depth, effect);
+    }
+
+    // SUMMARY =================================================================
+    // Over every record kept, folded or not
+    edgeTable loops = {NULL, 0}, calls = {NULL, 0};
+    for(uint32_t n = 0; n < d.count; n++) {
+        const traceRecord *r = &d.records[n];
+        if(r->pc == TRACE_SKIP) {
+            continue;
+        }
+        if(classifyOpcode(r->opcode) == CLASS_2NNN) {
+            countEdge(&calls, r->pc, r->opcode & 0x0FFF, 1);
+        } else if(n + 1 < d.count && isBackwardJump(r, &d.records[n + 1])) {
+            countEdge(&loops, r->pc, d.records[n + 1].pc, 1);
+        }
+    }
+    printSummary("Loops", &loops, true);
+    printSummary("Subroutines", &calls, false);
+
+    free(loops.edges);
+    free(calls.edges);
+    freeTraceDump(&d);
+    return 0;
+}
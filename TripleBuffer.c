@@ -0,0 +1,37 @@
+#ifndef TRIPLEBUFFER_C_INCLUDE
+#define TRIPLEBUFFER_C_INCLUDE
+
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "TripleBuffer.h"
+
+void initTripleBuffer(tripleBuffer *t) {
+    memset(t->slots, 0, sizeof(t->slots));
+    t->back  = 0;
+    atomic_init(&t->middle, 1);
+    t->front = 2;
+}
+
+chip8Frame *backFrame(tripleBuffer *t) {
+    return &t->slots[t->back];
+}
+
+void publishFrame(tripleBuffer *t) {
+    // Release so the reader sees the whole frame, acquire so the slot coming back is done with by the reader
+    unsigned int old = atomic_exchange_explicit(&t->middle, t->back | FRAME_FRESH, memory_order_acq_rel);
+    t->back = old & ~FRAME_FRESH;
+}
+
+const chip8Frame *takeFrame(tripleBuffer *t) {
+    if(!(atomic_load_explicit(&t->middle, memory_order_relaxed) & FRAME_FRESH)) {
+        return NULL;
+    }
+    unsigned int old = atomic_exchange_explicit(&t->middle, t->front, memory_order_acq_rel);
+    t->front = old & ~FRAME_FRESH;
+    return &t->slots[t->front];
+}
+
+#endif // TRIPLEBUFFER_C_INCLUDE
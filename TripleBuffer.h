@@ -0,0 +1,41 @@
+#ifndef TRIPLEBUFFER_H_INCLUDE
+#define TRIPLEBUFFER_H_INCLUDE
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+// One finished frame as the core handed it over. Only the plane for hiresMode is filled in
+typedef struct {
+    bool hiresMode;
+    uint64_t screen[32];
+    uint64_t hiresScreen[2][64]; // Laid out as in chip8
+    uint64_t cycle;              // cycleCount when it was published
+    uint64_t pressedAt;          // Performance counter at the oldest key press this frame is the first to show, 0 if none
+} chip8Frame;
+
+// Set in middle when the writer has swapped a frame in that the reader hasn't taken yet
+#define FRAME_FRESH 4
+
+// Lock-free triple buffer for one writer thread and one reader thread
+// The writer fills its back slot and swaps it with the middle one. The reader swaps its front slot with the middle one
+// whenever something new is there. Neither side ever waits for the other: the reader always gets the newest complete
+// frame, and frames it was too slow to take are simply overwritten
+typedef struct {
+    chip8Frame slots[3];
+    atomic_uint middle; // Slot index, plus FRAME_FRESH
+    unsigned int back;  // Only the writer uses it
+    unsigned int front; // Only the reader uses it
+} tripleBuffer;
+
+void initTripleBuffer(tripleBuffer *t);
+
+// Writer side. Fill in the frame returned by backFrame, then publishFrame hands it over
+chip8Frame *backFrame(tripleBuffer *t);
+void publishFrame(tripleBuffer *t);
+
+// Reader side. Returns the newest frame, or NULL when nothing was published since the last call
+// The frame stays valid and unchanged until the next call
+const chip8Frame *takeFrame(tripleBuffer *t);
+
+#endif // TRIPLEBUFFER_H_INCLUDE